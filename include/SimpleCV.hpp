@@ -28,7 +28,9 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>
 #include <memory>
+#include <new>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
@@ -51,6 +53,16 @@ namespace SimpleCV
         BGRA       // 4 channel
     };
 
+    // 缩放滤波器（对应 stbir 的 filter）
+    enum class Interp
+    {
+        DEFAULT = 0, // 同 resize()：缩小 Mitchell、放大 Catmull-Rom
+        NEAREST,     // 最近邻（点采样）
+        LINEAR,      // 三角滤波，放大时等同双线性
+        CUBIC,       // Catmull-Rom
+        AREA         // 盒式滤波，整数倍缩小时等同区域平均
+    };
+
     enum class BorderType
     {
         CONSTANT,   // 常量填充
@@ -240,14 +252,294 @@ namespace SimpleCV
     typedef Rect_<int> Rect;
     typedef Rect_<float> Rect2f;
 
+    // 每个通道的数据类型
+    enum class Depth
+    {
+        U8 = 0, // unsigned char，0..255
+        U16,    // uint16_t，0..65535
+        F16,    // float16（IEEE half），LDR 图像约定 0..1
+        F32     // float，LDR 图像约定 0..1，HDR 不限
+    };
+
+    static inline int depthSize(Depth d)
+    {
+        switch (d)
+        {
+        case Depth::U16:
+        case Depth::F16:
+            return 2;
+        case Depth::F32:
+            return 4;
+        case Depth::U8:
+        default:
+            return 1;
+        }
+    }
+
+    // IEEE 754 半精度浮点（存储类型，运算时转 float）
+    struct float16
+    {
+        std::uint16_t bits = 0;
+
+        float16() = default;
+        float16(float f) : bits(fromFloat(f)) {}
+        operator float() const { return toFloat(bits); }
+
+        static float toFloat(std::uint16_t h)
+        {
+            std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000u) << 16;
+            std::uint32_t exp = (h >> 10) & 0x1fu;
+            std::uint32_t mant = h & 0x3ffu;
+            std::uint32_t f;
+            if (exp == 0)
+            {
+                if (mant == 0)
+                {
+                    f = sign;
+                }
+                else
+                {
+                    // 非规格化数：规格化后再拼 float
+                    int e = -1;
+                    do
+                    {
+                        ++e;
+                        mant <<= 1;
+                    } while (!(mant & 0x400u));
+                    mant &= 0x3ffu;
+                    f = sign | (static_cast<std::uint32_t>(127 - 15 - e) << 23) | (mant << 13);
+                }
+            }
+            else if (exp == 31)
+            {
+                f = sign | 0x7f800000u | (mant << 13);
+            }
+            else
+            {
+                f = sign | ((exp + 112u) << 23) | (mant << 13);
+            }
+            float out;
+            std::memcpy(&out, &f, sizeof(out));
+            return out;
+        }
+
+        // round-to-nearest-even
+        static std::uint16_t fromFloat(float value)
+        {
+            const std::uint32_t f32infty = 255u << 23;
+            const std::uint32_t f16max = (127u + 16u) << 23;
+            const std::uint32_t denorm_magic_u = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+            std::uint32_t x;
+            std::memcpy(&x, &value, sizeof(x));
+            const std::uint32_t sign = x & 0x80000000u;
+            x ^= sign;
+
+            std::uint16_t o;
+            if (x >= f16max)
+            {
+                o = (x > f32infty) ? 0x7e00 : 0x7c00; // NaN / Inf
+            }
+            else if (x < (113u << 23))
+            {
+                // 结果为非规格化数：借助浮点加法完成舍入
+                float xf, dm;
+                std::memcpy(&xf, &x, sizeof(xf));
+                std::memcpy(&dm, &denorm_magic_u, sizeof(dm));
+                xf += dm;
+                std::uint32_t r;
+                std::memcpy(&r, &xf, sizeof(r));
+                o = static_cast<std::uint16_t>(r - denorm_magic_u);
+            }
+            else
+            {
+                const std::uint32_t mant_odd = (x >> 13) & 1u;
+                x += (static_cast<std::uint32_t>(15 - 127) << 23) + 0xfffu;
+                x += mant_odd;
+                o = static_cast<std::uint16_t>(x >> 13);
+            }
+            return static_cast<std::uint16_t>(o | (sign >> 16));
+        }
+    };
+
+    // Mat 行存储方式
+    enum class StepMode
+    {
+        PACKED, // 紧密存储：step = w*c
+        ALIGNED // data 按 Mat::ALIGNMENT 对齐，step 向上取整到 Mat::ALIGNMENT（一条 cache line）
+    };
+
+    // ==========================================================
+    // Mat 缓冲区分配器
+    // ==========================================================
+    struct MatAllocatorStats
+    {
+        std::uint64_t hits = 0;          // 命中缓存（复用已释放缓冲区）
+        std::uint64_t misses = 0;        // 未命中（真正向系统申请）
+        std::uint64_t deallocations = 0; // 归还次数
+        std::size_t cached_blocks = 0;   // 当前缓存的空闲块数
+        std::size_t cached_bytes = 0;    // 当前缓存的空闲字节数
+        std::size_t live_blocks = 0;     // 当前被 Mat 持有的块数
+        std::size_t live_bytes = 0;      // 当前被 Mat 持有的字节数
+    };
+
+    // Mat::create 通过它申请/释放像素缓冲区；deallocate 会带回 allocate 时的 bytes
+    // 返回的地址必须按 Mat::ALIGNMENT（64 字节）对齐
+    // 注意：分配器必须比它分配出去的所有缓冲区活得更久
+    class SIMPLECV_API MatAllocator
+    {
+    public:
+        virtual ~MatAllocator() = default;
+        virtual void *allocate(std::size_t bytes) = 0;
+        virtual void deallocate(void *ptr, std::size_t bytes) = 0;
+        virtual MatAllocatorStats stats() const { return MatAllocatorStats(); }
+    };
+
+    // 按 size class 缓存已释放缓冲区的池化分配器：
+    // <=256B 按 64B 分档，更大的每个 2 的幂区间再分 4 档（浪费 <25%）
+    // 稳态下（同样几种尺寸反复申请/释放）不再触碰系统堆
+    class SIMPLECV_API PoolMatAllocator : public MatAllocator
+    {
+    public:
+        explicit PoolMatAllocator(std::size_t max_cached_bytes = std::size_t(256) << 20);
+        ~PoolMatAllocator() override;
+
+        PoolMatAllocator(const PoolMatAllocator &) = delete;
+        PoolMatAllocator &operator=(const PoolMatAllocator &) = delete;
+
+        void *allocate(std::size_t bytes) override;
+        void deallocate(void *ptr, std::size_t bytes) override;
+        MatAllocatorStats stats() const override;
+
+        void resetStats();
+        // 释放所有缓存的空闲块
+        void trim();
+        // 缓存上限：超过后归还的块直接还给系统；调低到当前缓存量以下时，从最大的档起释放超出的部分
+        void setMaxCachedBytes(std::size_t bytes);
+
+    private:
+        struct Impl;
+        Impl *impl_;
+    };
+
+    // 直接走系统堆的分配器（默认）
+    SIMPLECV_API MatAllocator *getStdAllocator();
+    // 进程级共享的池化分配器（线程安全）
+    SIMPLECV_API PoolMatAllocator *getPoolAllocator();
+
+    // 全局默认分配器；nullptr 恢复为 getStdAllocator()
+    SIMPLECV_API void setDefaultAllocator(MatAllocator *allocator);
+    // 仅对当前线程生效，优先于全局设置；nullptr 取消线程级设置
+    SIMPLECV_API void setThreadAllocator(MatAllocator *allocator);
+    // 当前线程实际使用的分配器
+    SIMPLECV_API MatAllocator *getDefaultAllocator();
+
+    // ==========================================================
+    // 内存统计
+    // ==========================================================
+    // 计入 Mat::create 的像素缓冲区，以及 stb 编解码/缩放内部申请的缓冲区（含 imread 返回的 Mat 所持有的）
+    // 外部缓冲区与文件映射不计入；池化分配器缓存的空闲块也不算 live（见 MatAllocatorStats）
+    struct MemorySiteStats
+    {
+        std::string site;                // 调用点，例如 "resize"、"imread"，未打标签的为 "Mat::create"
+        std::uint64_t allocations = 0;
+        std::uint64_t deallocations = 0;
+        std::uint64_t total_bytes = 0;   // 累计申请字节数
+        std::size_t live_bytes = 0;      // 尚未释放的字节数
+        std::size_t peak_bytes = 0;      // live_bytes 的峰值
+    };
+
+    struct MemorySnapshot
+    {
+        std::size_t live_bytes = 0;
+        std::size_t peak_bytes = 0;
+        std::uint64_t allocations = 0;
+        std::uint64_t deallocations = 0;
+        std::vector<MemorySiteStats> sites; // 按 live_bytes 降序
+    };
+
+    SIMPLECV_API MemorySnapshot getMemorySnapshot();
+    // 把全局与各调用点的峰值重置为当前 live 值
+    SIMPLECV_API void resetMemoryPeak();
+
+    // 作用域内本线程发生的分配记到 name 名下；可嵌套，析构时恢复外层标签
+    // 库内的 imread/resize 等会自行打标签，用户代码也可以用它标记自己的调用点
+    class SIMPLECV_API MemoryScope
+    {
+    public:
+        explicit MemoryScope(const char *name);
+        ~MemoryScope();
+
+        MemoryScope(const MemoryScope &) = delete;
+        MemoryScope &operator=(const MemoryScope &) = delete;
+
+    private:
+        int prev_;
+    };
+
+    class Mat;
+
+    namespace detail
+    {
+        // 库内部（解码器等）直接装配 Mat 的入口，定义在 SimpleCV_Common.hpp
+        struct MatAccess;
+
+        // 内存统计钩子：memoryOnAlloc 返回当前调用点，释放时原样带回
+        SIMPLECV_API int memoryOnAlloc(std::size_t bytes);
+        SIMPLECV_API void memoryOnFree(int site, std::size_t bytes);
+
+        // shared_ptr 控制块也走 MatAllocator，避免每次 create 额外一次堆分配
+        template <typename T>
+        struct MatCtrlAllocator
+        {
+            typedef T value_type;
+
+            MatAllocator *alloc;
+
+            explicit MatCtrlAllocator(MatAllocator *a) : alloc(a) {}
+            template <typename U>
+            MatCtrlAllocator(const MatCtrlAllocator<U> &o) : alloc(o.alloc) {}
+
+            T *allocate(std::size_t n)
+            {
+                void *p = alloc->allocate(n * sizeof(T));
+                if (!p)
+                    throw std::bad_alloc();
+                return static_cast<T *>(p);
+            }
+            void deallocate(T *p, std::size_t n) { alloc->deallocate(p, n * sizeof(T)); }
+
+            template <typename U>
+            bool operator==(const MatCtrlAllocator<U> &o) const { return alloc == o.alloc; }
+            template <typename U>
+            bool operator!=(const MatCtrlAllocator<U> &o) const { return alloc != o.alloc; }
+        };
+
+        struct MatBufferDeleter
+        {
+            MatAllocator *alloc;
+            std::size_t bytes;
+            int site;
+            void operator()(unsigned char *p) const
+            {
+                memoryOnFree(site, bytes);
+                alloc->deallocate(p, bytes);
+            }
+        };
+    }
+
     class SIMPLECV_API Mat
     {
     public:
+        // create 分配的缓冲区起始地址对齐；StepMode::ALIGNED 时 step 也按它取整
+        static constexpr int ALIGNMENT = 64;
+
         int height = 0;
         int width = 0;
         int channels = 0;
         unsigned char *data = nullptr;
         int step = 0; // stride in bytes
+        Depth depth = Depth::U8;
 
         // ===== 构造：外部数据（指定 step/stride）=====
         Mat(int h, int w, int c, unsigned char *d, int s, bool is_own_data = false)
@@ -276,6 +568,34 @@ namespace SimpleCV
             reset(h, w, c, d, w * c, is_own_data);
         }
 
+        // ===== 构造：外部数据，指定 depth（不拥有；s 为 0 时按紧密存储）=====
+        Mat(int h, int w, int c, Depth dp, void *d, std::size_t s = 0)
+        {
+            assign_external(h, w, c, dp, d, s, std::shared_ptr<unsigned char>(static_cast<unsigned char *>(d), [](unsigned char *) {}));
+        }
+
+        // ===== 构造：外部数据，生命周期交给 holder =====
+        // 零拷贝包装 mmap/dmabuf/AVFrame/推理框架张量等：所有共享该缓冲区的 Mat（含 ROI 视图）
+        // 都释放后，holder 的最后一个引用随之释放，由其自身的 deleter 归还内存
+        Mat(int h, int w, int c, Depth dp, void *d, std::size_t s, std::shared_ptr<void> holder)
+        {
+            assign_external(h, w, c, dp, d, s, std::shared_ptr<unsigned char>(std::move(holder), static_cast<unsigned char *>(d)));
+        }
+
+        // ===== 构造：外部数据 + C 风格 deleter =====
+        // 最后一个引用释放时调用 deleter(d, context)，例如 av_frame_free / munmap 的包装
+        typedef void (*DeleterFn)(void *data, void *context);
+        Mat(int h, int w, int c, Depth dp, void *d, std::size_t s, DeleterFn deleter, void *context)
+        {
+            std::shared_ptr<unsigned char> owner;
+            if (deleter)
+                owner = std::shared_ptr<unsigned char>(static_cast<unsigned char *>(d), [deleter, context](unsigned char *p)
+                                                       { deleter(p, context); });
+            else
+                owner = std::shared_ptr<unsigned char>(static_cast<unsigned char *>(d), [](unsigned char *) {});
+            assign_external(h, w, c, dp, d, s, std::move(owner));
+        }
+
         // ===== 构造：自己分配（step 可指定）=====
         Mat(int h, int w, int c, int s)
         {
@@ -284,11 +604,27 @@ namespace SimpleCV
 
         Mat(int h, int w, int c)
         {
-            create(h, w, c, w * c);
+            create(h, w, c);
+        }
+
+        Mat(int h, int w, int c, StepMode mode)
+        {
+            create(h, w, c, mode);
+        }
+
+        Mat(int h, int w, int c, Depth dp, StepMode mode = StepMode::PACKED)
+        {
+            create(h, w, c, dp, mode);
         }
 
         Mat() = default;
 
+        // ===== 构造：ROI 视图（共享 m 的缓冲区，不拷贝）=====
+        Mat(const Mat &m, const Rect &roi)
+        {
+            *this = m(roi);
+        }
+
         Mat(const Mat &) = default;
         Mat &operator=(const Mat &) = default;
 
@@ -300,46 +636,140 @@ namespace SimpleCV
 
         bool empty() const { return data == nullptr || height <= 0 || width <= 0 || channels <= 0; }
 
+        // 单个通道的字节数 / 单个像素的字节数
+        int elemSize1() const { return depthSize(depth); }
+        int elemSize() const { return channels * depthSize(depth); }
+
+        // 第 row 行的首地址，按 T 解释（T 需与 depth 对应：uint8_t/uint16_t/float16/float）
+        template <typename T = unsigned char>
+        T *ptr(int row = 0)
+        {
+            return reinterpret_cast<T *>(data + static_cast<std::ptrdiff_t>(row) * step);
+        }
+        template <typename T = unsigned char>
+        const T *ptr(int row = 0) const
+        {
+            return reinterpret_cast<const T *>(data + static_cast<std::ptrdiff_t>(row) * step);
+        }
+
+        // 创建时指定的行存储方式；各处理函数按它为输出分配缓冲区
+        StepMode stepMode() const { return mode_; }
+
+        // 把最小行字节数向上取整到 ALIGNMENT；结果超出 int 时返回 -1
+        static int alignStep(int min_step)
+        {
+            const long long s = (static_cast<long long>(min_step) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            return s > INT_MAX ? -1 : static_cast<int>(s);
+        }
+
+        // 行与行之间没有间隙（无 padding、不是 ROI 的子区域）
+        bool isContinuous() const { return height == 1 || step == width * elemSize(); }
+
+        // 是否为更大缓冲区的一部分（ROI 视图）
+        bool isSubmatrix() const
+        {
+            return data != datastart_ || data + static_cast<std::ptrdiff_t>(step) * (height - 1) + width * elemSize() != dataend_;
+        }
+
+        // ===== ROI：返回共享缓冲区的子矩形视图 =====
+        // data 偏移到 roi 左上角，step 保持父矩阵的 step；roi 会被裁剪到图像范围内
+        Mat operator()(const Rect &roi) const
+        {
+            Rect r = roi & Rect(0, 0, width, height);
+            if (empty() || r.width <= 0 || r.height <= 0)
+                return Mat();
+            Mat m = *this;
+            m.data = data + static_cast<std::ptrdiff_t>(r.y) * step + static_cast<std::ptrdiff_t>(r.x) * elemSize();
+            m.height = r.height;
+            m.width = r.width;
+            return m;
+        }
+
+        // 找到视图在原始缓冲区中的位置：whole_size 为原始尺寸，ofs 为左上角偏移
+        void locateROI(Size &whole_size, Point &ofs) const
+        {
+            if (empty())
+            {
+                whole_size = Size(0, 0);
+                ofs = Point(0, 0);
+                return;
+            }
+            const std::ptrdiff_t esz = elemSize();
+            const std::ptrdiff_t delta1 = data - datastart_;
+            const std::ptrdiff_t delta2 = dataend_ - datastart_;
+            if (delta1 == 0)
+            {
+                ofs = Point(0, 0);
+            }
+            else
+            {
+                ofs.y = static_cast<int>(delta1 / step);
+                ofs.x = static_cast<int>((delta1 - static_cast<std::ptrdiff_t>(step) * ofs.y) / esz);
+            }
+            const std::ptrdiff_t minstep = (ofs.x + width) * esz;
+            int wh = static_cast<int>((delta2 - minstep) / step + 1);
+            wh = std::max(wh, ofs.y + height);
+            int ww = static_cast<int>((delta2 - static_cast<std::ptrdiff_t>(step) * (wh - 1)) / esz);
+            ww = std::max(ww, ofs.x + width);
+            whole_size = Size(ww, wh);
+        }
+
+        // 在原始缓冲区范围内移动视图的四条边（正数向外扩，负数向内缩）
+        Mat &adjustROI(int dtop, int dbottom, int dleft, int dright)
+        {
+            if (empty())
+                return *this;
+            Size whole;
+            Point ofs;
+            locateROI(whole, ofs);
+            const int row1 = std::min(std::max(ofs.y - dtop, 0), whole.height);
+            const int row2 = std::max(0, std::min(ofs.y + height + dbottom, whole.height));
+            const int col1 = std::min(std::max(ofs.x - dleft, 0), whole.width);
+            const int col2 = std::max(0, std::min(ofs.x + width + dright, whole.width));
+            if (row2 <= row1 || col2 <= col1)
+            {
+                release();
+                return *this;
+            }
+            data += static_cast<std::ptrdiff_t>(row1 - ofs.y) * step + static_cast<std::ptrdiff_t>(col1 - ofs.x) * elemSize();
+            height = row2 - row1;
+            width = col2 - col1;
+            return *this;
+        }
+
+        // 深拷贝为紧密、连续的 Mat（与 cv::Mat::clone 一致），不继承源的 step 与 StepMode
         Mat clone() const
         {
             if (empty())
                 return Mat();
-            Mat out(height, width, channels, step);
+            Mat out(height, width, channels, depth);
             for (int y = 0; y < height; ++y)
             {
-                std::memcpy(out.data + y * out.step, data + y * step, static_cast<size_t>(width * channels));
+                std::memcpy(out.ptr(y), ptr(y), static_cast<size_t>(width) * elemSize());
             }
             return out;
         }
 
         void create(int h, int w, int c, int s)
         {
-            if (h <= 0 || w <= 0 || c <= 0)
-            {
-                release();
-                return;
-            }
-            const int min_step = w * c;
-            if (s < min_step)
-                s = min_step;
-
-            const size_t bytes = static_cast<size_t>(h) * static_cast<size_t>(s);
-            unsigned char *p = new unsigned char[bytes];
+            create_impl(h, w, c, Depth::U8, s, false);
+        }
 
-            std::shared_ptr<unsigned char> sp(p, [](unsigned char *ptr)
-                                              { delete[] ptr; });
+        void create(int h, int w, int c)
+        {
+            create_impl(h, w, c, Depth::U8, 0, false);
+        }
 
-            owner_ = std::move(sp);
-            height = h;
-            width = w;
-            channels = c;
-            step = s;
-            data = owner_.get();
+        void create(int h, int w, int c, StepMode mode)
+        {
+            create(h, w, c, Depth::U8, mode);
         }
 
-        void create(int h, int w, int c)
+        void create(int h, int w, int c, Depth dp, StepMode mode = StepMode::PACKED)
         {
-            create(h, w, c, w * c);
+            create_impl(h, w, c, dp, 0, mode == StepMode::ALIGNED);
+            if (!empty())
+                mode_ = mode;
         }
 
         void release()
@@ -347,60 +777,412 @@ namespace SimpleCV
             owner_.reset();
             height = width = channels = step = 0;
             data = nullptr;
+            depth = Depth::U8;
+            mode_ = StepMode::PACKED;
+            datastart_ = dataend_ = nullptr;
         }
 
     private:
         std::shared_ptr<unsigned char> owner_;
+        StepMode mode_ = StepMode::PACKED;
+        // 原始（非 ROI）缓冲区的范围，供 locateROI/adjustROI 使用
+        const unsigned char *datastart_ = nullptr;
+        const unsigned char *dataend_ = nullptr;
 
-        void reset(int h, int w, int c, unsigned char *d, int s, bool is_own_data)
+        void update_data_bounds()
+        {
+            datastart_ = data;
+            dataend_ = data + static_cast<std::ptrdiff_t>(step) * (height - 1) + width * elemSize();
+        }
+
+        // 装配外部缓冲区；owner 控制生命周期（可以是空 deleter）
+        void assign_external(int h, int w, int c, Depth dp, void *d, std::size_t s,
+                             std::shared_ptr<unsigned char> owner)
         {
             if (h <= 0 || w <= 0 || c <= 0 || d == nullptr)
             {
                 release();
                 return;
             }
-            const int min_step = w * c;
+            const std::size_t min_step = static_cast<std::size_t>(w) * c * depthSize(dp);
             if (s < min_step)
                 s = min_step;
-
-            if (is_own_data)
+            if (s > static_cast<std::size_t>(std::numeric_limits<int>::max()))
             {
-                // 认为外部用 new[] 分配
-                owner_ = std::shared_ptr<unsigned char>(d, [](unsigned char *ptr)
-                                                        { delete[] ptr; });
+                release();
+                return;
             }
-            else
+
+            owner_ = std::move(owner);
+            height = h;
+            width = w;
+            channels = c;
+            step = static_cast<int>(s);
+            depth = dp;
+            data = static_cast<unsigned char *>(d);
+            mode_ = StepMode::PACKED;
+            update_data_bounds();
+        }
+
+        // s 小于最小行字节数时取最小值，aligned 时再向上取整到 ALIGNMENT。
+        // 行字节数按 64 位计算：超出 int（step 的类型）或总字节数超出 size_t 时按分配失败抛 std::bad_alloc，不让乘积绕回
+        void create_impl(int h, int w, int c, Depth dp, int s, bool aligned)
+        {
+            if (h <= 0 || w <= 0 || c <= 0)
             {
-                // 不拥有：空 deleter
-                owner_ = std::shared_ptr<unsigned char>(d, [](unsigned char *) {});
+                release();
+                return;
             }
+            std::uint64_t row = static_cast<std::uint64_t>(w) * static_cast<std::uint64_t>(c) * depthSize(dp);
+            if (s > 0 && static_cast<std::uint64_t>(s) > row)
+                row = static_cast<std::uint64_t>(s);
+            if (aligned)
+                row = (row + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            if (row > static_cast<std::uint64_t>(INT_MAX) ||
+                static_cast<std::uint64_t>(h) * row > static_cast<std::uint64_t>(SIZE_MAX))
+                throw std::bad_alloc();
+            s = static_cast<int>(row);
 
+            const size_t bytes = static_cast<size_t>(h) * static_cast<size_t>(s);
+            MatAllocator *a = getDefaultAllocator();
+            unsigned char *p = static_cast<unsigned char *>(a->allocate(bytes));
+            if (!p)
+                throw std::bad_alloc();
+            const int site = detail::memoryOnAlloc(bytes);
+
+            // 控制块分配失败时 shared_ptr 会自行调用 deleter 归还 p
+            owner_ = std::shared_ptr<unsigned char>(p, detail::MatBufferDeleter{a, bytes, site},
+                                                    detail::MatCtrlAllocator<unsigned char>(a));
             height = h;
             width = w;
             channels = c;
             step = s;
-            data = d;
+            depth = dp;
+            data = owner_.get();
+            mode_ = StepMode::PACKED;
+            update_data_bounds();
         }
 
-        friend Mat imread(const std::string &filename, ColorSpace flag);
-        friend Mat imdecode(const std::vector<unsigned char> &buf, ColorSpace flag);
+        void reset(int h, int w, int c, unsigned char *d, int s, bool is_own_data)
+        {
+            if (h <= 0 || w <= 0 || c <= 0 || d == nullptr)
+            {
+                release();
+                return;
+            }
+
+            std::shared_ptr<unsigned char> owner;
+            if (is_own_data)
+            {
+                // 认为外部用 new[] 分配
+                owner = std::shared_ptr<unsigned char>(d, [](unsigned char *ptr)
+                                                       { delete[] ptr; });
+            }
+            else
+            {
+                // 不拥有：空 deleter
+                owner = std::shared_ptr<unsigned char>(d, [](unsigned char *) {});
+            }
+            assign_external(h, w, c, Depth::U8, d, s < 0 ? 0 : static_cast<std::size_t>(s), std::move(owner));
+        }
+
+        friend struct detail::MatAccess;
+    };
+
+    // 只读字节区间，不持有内存；可由 指针+长度 / vector / string 隐式构造
+    struct ByteSpan
+    {
+        const unsigned char *data = nullptr;
+        std::size_t size = 0;
+
+        ByteSpan() = default;
+        ByteSpan(const void *d, std::size_t n) : data(static_cast<const unsigned char *>(d)), size(n) {}
+        ByteSpan(const std::vector<unsigned char> &v) : data(v.data()), size(v.size()) {}
+        ByteSpan(const std::string &s) : data(reinterpret_cast<const unsigned char *>(s.data())), size(s.size()) {}
+
+        bool empty() const { return data == nullptr || size == 0; }
     };
 
     // imgcodec
     SIMPLECV_API Mat imread(const std::string &filename, ColorSpace flag = ColorSpace::UNCHANGED);
     SIMPLECV_API Mat imdecode(const std::vector<unsigned char> &buf, ColorSpace flag = ColorSpace::UNCHANGED);
+    // 直接解码外部内存（网络缓冲区、共享内存、映射文件等），不做额外拷贝
+    SIMPLECV_API Mat imdecode(ByteSpan buf, ColorSpace flag = ColorSpace::UNCHANGED);
+    SIMPLECV_API Mat imdecode(const void *data, std::size_t len, ColorSpace flag = ColorSpace::UNCHANGED);
+
+    // 指定输出 depth：U16 保留 16 位 PNG/PNM 的精度（8 位源按 v*257 扩展）；
+    // F32/F16 对 HDR 给出线性值，对 LDR 归一化到 0..1；PFM（Pf/PF）原样给出 float，要 U8/U16 时按 0..1 截断缩放
+    SIMPLECV_API Mat imread(const std::string &filename, ColorSpace flag, Depth depth);
+    SIMPLECV_API Mat imdecode(const std::vector<unsigned char> &buf, ColorSpace flag, Depth depth);
+    SIMPLECV_API Mat imdecode(ByteSpan buf, ColorSpace flag, Depth depth);
+    SIMPLECV_API Mat imdecode(const void *data, std::size_t len, ColorSpace flag, Depth depth);
+
+    // 解码到已有的 dst：尺寸/通道/depth 与结果一致时直接写进 dst 的缓冲区（可以是 ROI 等带 stride 的视图），
+    // BGR 交换在写入时完成；不一致时 dst 换成新缓冲区。失败返回 false（dst 可能已被部分写入）
+    SIMPLECV_API bool imread(const std::string &filename, Mat &dst, ColorSpace flag = ColorSpace::UNCHANGED,
+                             Depth depth = Depth::U8);
+    SIMPLECV_API bool imdecode(ByteSpan buf, Mat &dst, ColorSpace flag = ColorSpace::UNCHANGED,
+                               Depth depth = Depth::U8);
+
+    // 顺序读取的数据源（管道、网络流、对象缓存等），解码时不需要先把整个文件读进内存。
+    // read 返回实际读到的字节数（0 表示没有更多数据）；skip 默认用 read 丢弃
+    class SIMPLECV_API Reader
+    {
+    public:
+        virtual ~Reader() = default;
+        virtual int read(void *dst, int size) = 0;
+        virtual void skip(int n);
+        virtual bool eof() = 0;
+    };
+
+    // 包装 std::istream（不持有）
+    class SIMPLECV_API IStreamReader : public Reader
+    {
+    public:
+        explicit IStreamReader(std::istream &is);
+        int read(void *dst, int size) override;
+        void skip(int n) override;
+        bool eof() override;
+
+    private:
+        std::istream &is_;
+    };
+
+    // 从 Reader 边读边解码（stb 内部只用一个小缓冲区；PNG 的压缩数据仍会在 stb 内部拼成一块）。
+    // 读完的数据不会回退，Reader 停在图像数据之后的某个位置
+    SIMPLECV_API Mat imdecode(Reader &reader, ColorSpace flag = ColorSpace::UNCHANGED, Depth depth = Depth::U8);
+    SIMPLECV_API bool imdecode(Reader &reader, Mat &dst, ColorSpace flag = ColorSpace::UNCHANGED,
+                               Depth depth = Depth::U8);
+    SIMPLECV_API Mat imdecode(std::istream &is, ColorSpace flag = ColorSpace::UNCHANGED, Depth depth = Depth::U8);
+
+    // 批量解码：在内部线程上并发解码，结果按输入顺序放进 dsts（已有元素按上面 dst 版本的规则复用缓冲区）。
+    // 返回成功张数；失败项被 release 成空 Mat，errors 非空时给出逐项原因（成功为空串）。
+    // num_threads <= 0 时取硬件线程数。解码中抛出的异常（如分配失败、后端抛出）在调用线程重新抛出
+    SIMPLECV_API int imreadBatch(const std::vector<std::string> &filenames, std::vector<Mat> &dsts,
+                                 ColorSpace flag = ColorSpace::UNCHANGED, Depth depth = Depth::U8,
+                                 int num_threads = 0, std::vector<std::string> *errors = nullptr);
+    SIMPLECV_API int imdecodeBatch(const std::vector<ByteSpan> &bufs, std::vector<Mat> &dsts,
+                                   ColorSpace flag = ColorSpace::UNCHANGED, Depth depth = Depth::U8,
+                                   int num_threads = 0, std::vector<std::string> *errors = nullptr);
+
+    // 缩小解码：scale 取 1/2/4/8，输出 ceil(w/scale) x ceil(h/scale)，其它取值返回空 Mat。
+    // JPEG 在 IDCT 阶段按比例重建（1/8 只用 DC 系数），不产生全尺寸缓冲区；其它格式全尺寸解码后再 resize
+    SIMPLECV_API Mat imreadReduced(const std::string &filename, int scale, ColorSpace flag = ColorSpace::UNCHANGED,
+                                   Depth depth = Depth::U8);
+    SIMPLECV_API Mat imdecodeReduced(ByteSpan buf, int scale, ColorSpace flag = ColorSpace::UNCHANGED,
+                                     Depth depth = Depth::U8);
+
+    // 多帧解码（GIF 动图）：frames 依次为每一帧（已按 GIF 的 disposal 合成好的完整画面），只支持 Depth::U8。
+    // 所有帧是同一块 stb 分配上的视图，共享引用计数，任一帧还在时整块都不会释放；
+    // delays 非空时给出每帧显示时长（毫秒）。非 GIF 输入按单帧返回（delay 为 0），失败返回 false
+    SIMPLECV_API bool imdecodeMulti(ByteSpan buf, std::vector<Mat> &frames, ColorSpace flag = ColorSpace::UNCHANGED,
+                                    std::vector<int> *delays = nullptr);
+    SIMPLECV_API bool imreadAnimation(const std::string &filename, std::vector<Mat> &frames, std::vector<int> &delays,
+                                      ColorSpace flag = ColorSpace::UNCHANGED);
+
+    // 解码 + 缩放 + 通道顺序一次完成，输出 width x height，只支持 Depth::U8（flag 为 UNCHANGED 时保持文件通道数）。
+    // JPEG 先按 1/2、1/4、1/8 中不小于目标尺寸的最大比例在 IDCT 阶段缩小解码，再用 stbir 缩放到目标尺寸；
+    // BGR/BGRA 由 stbir 在写输出时重排通道，不再单独走一遍。其它格式按 imread 的路径（外部后端、原生 PNM/PFM、stb）
+    // 全尺寸解码后缩放；第一个认得 JPEG 文件头的外部后端不支持缩小解码时，JPEG 也交给它全尺寸解码
+    SIMPLECV_API Mat imreadResized(const std::string &filename, int width, int height,
+                                   ColorSpace flag = ColorSpace::UNCHANGED, Interp interp = Interp::DEFAULT);
+    SIMPLECV_API Mat imdecodeResized(ByteSpan buf, int width, int height, ColorSpace flag = ColorSpace::UNCHANGED,
+                                     Interp interp = Interp::DEFAULT);
+    // Reader 来源读不到尺寸，不走 JPEG 缩小解码，全尺寸解码后缩放
+    SIMPLECV_API Mat imdecodeResized(Reader &reader, int width, int height, ColorSpace flag = ColorSpace::UNCHANGED,
+                                     Interp interp = Interp::DEFAULT);
+
+    enum class ImageFormat
+    {
+        UNKNOWN = 0,
+        PNG,
+        JPEG,
+        BMP,
+        GIF,
+        PSD,
+        PIC,
+        PNM, // 含 PFM（bits 为 32）
+        HDR,
+        TGA
+    };
+
+    // 只解析文件头得到的信息；失败时为空（empty() 为 true）
+    struct ImageInfo
+    {
+        int width = 0;
+        int height = 0;
+        int channels = 0; // 文件本身的通道数（与 imread 的 flag 无关）
+        int bits = 0;     // 每通道位数：8 / 16，HDR 为 32（float）
+        bool hdr = false;
+        ImageFormat format = ImageFormat::UNKNOWN;
+
+        bool empty() const { return width <= 0 || height <= 0; }
+    };
+
+    // 不解码像素，开销只有读头部，适合预扫描大批文件（按尺寸分桶、拒绝过大的输入）
+    SIMPLECV_API ImageInfo imreadInfo(const std::string &filename);
+    SIMPLECV_API ImageInfo imdecodeInfo(ByteSpan buf);
+    SIMPLECV_API ImageInfo imdecodeInfo(const void *data, std::size_t len);
+
+    // PNG 编码器
+    enum class PngMode
+    {
+        STB,   // stb_image_write：逐行试 5 种滤波器 + 哈希链 deflate，文件最小、最慢
+        FAST,  // 自带编码器：固定滤波器 + 单候选哈希的贪心匹配 + 动态 Huffman
+        RLE,   // 自带编码器：只匹配与前一像素相同的重复，适合大块纯色/标注图
+        STORE, // 不压缩（stored 块），只计算 CRC/Adler
+    };
+
+    // 编码参数；每个字段只对对应格式生效
+    struct ImwriteParams
+    {
+        int jpeg_quality = 95;            // 1..100
+        PngMode png_mode = PngMode::STB;
+        int png_compression = 8;          // 0..9，stb 的 deflate 搜索强度，越大越慢、文件越小（<5 按 5 处理），仅 STB
+        int png_filter = -1;              // 0..4 固定用 None/Sub/Up/Average/Paeth；-1：STB 每行自动挑选，
+                                          // 自带编码器用 Up（STORE 用 None）
+        ColorSpace src_space = ColorSpace::AUTO; // mat 的通道顺序：BGR/BGRA 时编码器取行时交换 R/B，省掉一次 cvtColor；
+                                                 // AUTO/RGB/RGBA/GRAY 按原样写
+        int png_threads = 1;              // 自带编码器按行带并行压缩的线程数，<=0 取硬件线程数；输出与单线程逐字节相同
+        bool tga_rle = true;
+    };
 
-    SIMPLECV_API bool imwrite(const std::string &filename, const Mat &mat);
+    // 写入/编码目前只支持 Depth::U8；pgm/ppm/pnm 另接受 U16（maxval 65535），pfm 只接受 F32/F16
+    // 格式由扩展名决定：png / jpg / jpeg / bmp / tga / pgm / ppm / pnm / pfm，其它按 png 写
+    // PNM/PFM 不压缩，只支持 1/3 通道（按通道数写 P5/P6、Pf/PF），样本按行整块写出
+    // imwrite 先在内存中编码完，成功后才打开 filename 写入：编码失败时返回 false，已有的同名文件保持不变。
+    // 写入的是原文件本身（符号链接、权限、硬链接、FIFO/设备都照旧）
+    SIMPLECV_API bool imwrite(const std::string &filename, const Mat &mat,
+                              const ImwriteParams &params = ImwriteParams());
     SIMPLECV_API bool imencode(const Mat &mat, std::vector<unsigned char> &buf);
 
+    // 编码输出回调：可能被调用多次，按调用顺序拼接即为完整文件
+    typedef void (*EncodeWriteFn)(void *ctx, const void *data, std::size_t size);
+    SIMPLECV_API bool imencode(const Mat &mat, EncodeWriteFn write, void *ctx);
+    // 编码到调用方提供的缓冲区；written 返回编码结果的总字节数
+    // 容量不足时返回 false，此时 written 给出所需的大小
+    SIMPLECV_API bool imencode(const Mat &mat, void *dst, std::size_t capacity, std::size_t *written);
+
+    // 指定格式的内存编码，ext 与 imwrite 的扩展名规则相同（".jpg" 或 "jpg" 均可），结果与 imwrite 写出的文件逐字节一致
+    SIMPLECV_API bool imencode(const std::string &ext, const Mat &mat, std::vector<unsigned char> &buf,
+                               const ImwriteParams &params = ImwriteParams());
+    SIMPLECV_API bool imencode(const std::string &ext, const Mat &mat, EncodeWriteFn write, void *ctx,
+                               const ImwriteParams &params = ImwriteParams());
+    SIMPLECV_API bool imencode(const std::string &ext, const Mat &mat, void *dst, std::size_t capacity,
+                               std::size_t *written, const ImwriteParams &params = ImwriteParams());
+
+    // ===== 编解码后端 =====
+    // imread/imdecode/imwrite/imencode 先按优先级尝试已注册的后端，都不处理时交给内置的 stb（始终可用）。
+    // 从 Reader 流式解码与 GIF 多帧解码只走 stb
+    struct CodecCaps
+    {
+        bool decode = false;
+        bool encode = false;
+        bool scaled_decode = false; // decode 支持 scale = 2/4/8（imreadReduced 等）；不支持时缩小解码交给后面的后端
+        bool stride = false;        // decode 可写进调用方带 stride 的 dst；encode 可按 step 读取 ROI（否则先整理成紧密拷贝）
+        bool bit16 = false;         // decode 可输出 Depth::U16/F16/F32；encode 接受 Depth::U16
+    };
+
+    struct CodecDecodeOptions
+    {
+        ColorSpace flag = ColorSpace::UNCHANGED;
+        Depth depth = Depth::U8;
+        int scale = 1; // 1/2/4/8，输出 ceil(w/scale) x ceil(h/scale)
+    };
+
+    class SIMPLECV_API ImageCodec
+    {
+    public:
+        virtual ~ImageCodec() = default;
+        virtual const char *name() const = 0;
+        virtual CodecCaps caps() const = 0;
+        // head 是输入开头的至多 16 字节
+        virtual bool matchesMagic(const unsigned char *head, std::size_t n) const = 0;
+        // ext 为小写、不带点的扩展名
+        virtual bool matchesExtension(const std::string &ext) const = 0;
+
+        // 返回 false 表示不处理（或失败），交给下一个后端。
+        // caps().stride 的后端收到的 dst 可能是调用方已有的 Mat：尺寸/通道/depth 都一致时可直接写入，否则重新分配
+        virtual bool decode(ByteSpan buf, Mat &dst, const CodecDecodeOptions &opts);
+        // 返回 false 前不能调用 write（已经写出部分数据的失败不会再交给下一个后端）
+        virtual bool encode(const std::string &ext, const Mat &mat, EncodeWriteFn write, void *ctx,
+                            const ImwriteParams &params);
+    };
+
+    // 注册后端；同名的旧后端被替换。priority 高的先试，相同时后注册的先试。线程安全，
+    // 正在进行的编解码仍持有旧后端的引用
+    SIMPLECV_API void registerCodec(std::shared_ptr<ImageCodec> codec, int priority = 0);
+    SIMPLECV_API bool unregisterCodec(const std::string &name);
+    // 按尝试顺序列出全部后端，最后一个总是内置的 "stb"
+    SIMPLECV_API std::vector<std::shared_ptr<ImageCodec>> getCodecs();
+
+    // 后台写图：队列满时的处理方式
+    enum class AsyncWritePolicy
+    {
+        BLOCK,       // write() 阻塞到队列有空位（背压）
+        DROP_NEWEST, // 丢弃这次提交，write() 返回 false
+        DROP_OLDEST  // 丢弃队列中最早的一项腾出位置，该文件在 flush() 的错误里报告
+    };
+
+    struct AsyncWriterParams
+    {
+        int num_threads = 1;     // 编码线程数，<=0 取硬件线程数
+        int queue_capacity = 16; // 最多排队的图数（不含正在编码的），<1 按 1 处理
+        AsyncWritePolicy policy = AsyncWritePolicy::BLOCK;
+    };
+
+    struct AsyncWriteError
+    {
+        std::string filename;
+        std::string reason;
+    };
+
+    // 后台 imwrite：有界队列 + 若干编码线程，调用线程只付出一次入队的代价
+    // Mat 按引用计数交给后台线程，不拷贝像素；写完之前调用方不要改写这块内存
+    // （外部数据构造的 Mat 不持有内存，调用方还需保证其在写完前有效）
+    class SIMPLECV_API AsyncImageWriter
+    {
+    public:
+        explicit AsyncImageWriter(const AsyncWriterParams &params = AsyncWriterParams());
+        // 等价于 close()，丢掉错误列表
+        ~AsyncImageWriter();
+
+        AsyncImageWriter(const AsyncImageWriter &) = delete;
+        AsyncImageWriter &operator=(const AsyncImageWriter &) = delete;
+
+        // 返回 false：已 close，或 DROP_NEWEST 下队列已满
+        bool write(const std::string &filename, const Mat &mat, const ImwriteParams &params = ImwriteParams());
+        // 等待已入队的图全部写完；返回上次 flush/close 以来失败或被丢弃的文件
+        std::vector<AsyncWriteError> flush();
+        // 拒绝新的 write，写完队列后停掉线程；可重复调用，也可在多个线程并发调用
+        std::vector<AsyncWriteError> close();
+        // 排队中 + 正在编码的图数
+        std::size_t pending() const;
+
+    private:
+        struct Impl;
+        Impl *impl_;
+    };
+
     // imgproc
+    // 支持所有 depth；dst 的 depth 与 src 相同
     SIMPLECV_API void resize(const Mat &src, Mat &dst, int dst_width, int dst_height);
 
-    // 任意互转：RGB/BGR/RGBA/BGRA/GRAY
+    // 任意互转：RGB/BGR/RGBA/BGRA/GRAY；支持所有 depth，补出的 alpha 取该 depth 的最大值（U8 255 / U16 65535 / 浮点 1）
     SIMPLECV_API void cvtColor(const Mat &src, Mat &dst, ColorSpace dst_space, ColorSpace src_space = ColorSpace::AUTO);
     SIMPLECV_API Mat cvtColor(const Mat &src, ColorSpace dst_space, ColorSpace src_space = ColorSpace::AUTO);
+    // 直接输出平面（planes[k] 为 dst_space 的第 k 个通道），通道重排与丢弃/补 alpha 在拆分时一次完成
+    SIMPLECV_API void cvtColor(const Mat &src, std::vector<Mat> &planes, ColorSpace dst_space,
+                               ColorSpace src_space = ColorSpace::AUTO);
+
+    // 交错 HWC <-> 逐通道平面（每个平面 channels=1，depth 同源）；8 位 3/4 通道走 SSSE3/AVX2/NEON
+    // planes 中尺寸/depth 合适的 Mat 会被直接复用，例如同一块 CHW 缓冲区上的 ROI 视图
+    SIMPLECV_API void split(const Mat &src, std::vector<Mat> &planes);
+    // 所有平面必须同尺寸、同 depth、单通道
+    SIMPLECV_API void merge(const std::vector<Mat> &planes, Mat &dst);
 
     // value: 支持 1/3/4 通道值；会按 dst.channels 适配
+    // value 按 8 位量程给出，非 U8 图像按 depth 换算：U16 为 v*257，F16/F32 为 v/255（默认 alpha 255 即不透明）
     SIMPLECV_API void copyMakeBorder(
         const Mat &src,
         Mat &dst,
@@ -408,6 +1190,7 @@ namespace SimpleCV
         BorderType borderType = BorderType::CONSTANT,
         const std::vector<unsigned char> &value = std::vector<unsigned char>{0, 0, 0, 255});
 
+    // 绘图函数只处理 Depth::U8，其他 depth 直接忽略
     SIMPLECV_API void rectangle(Mat &img, Point pt1, Point pt2, const Scalar &color,
                                 int thickness = 1, int lineType = 8, int shift = 0);
     SIMPLECV_API void rectangle(Mat &img, Rect rec, const Scalar &color,
@@ -433,6 +1216,45 @@ namespace SimpleCV
                                   int thickness,
                                   int *baseLine);
 
+    // dnn 预处理
+    // 每个输出通道：out = (v * scale - mean[k]) / std[k]，k 为交换 R/B 之后的通道序号
+    struct BlobParams
+    {
+        Size size = Size(0, 0); // 输出尺寸；宽高都 > 0 才生效，否则使用输入尺寸（不 resize）
+        float scale = 1.0f;     // 例如 1/255.f
+        float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        float std[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        bool swapRB = false; // BGR <-> RGB
+    };
+
+    // HWC -> CHW float，一遍完成通道交换 + scale + mean/std 归一化 + 转置
+    // dst 由调用方提供，至少 channels*H*W 个 float
+    SIMPLECV_API bool blobFromImage(const Mat &img, float *dst, const BlobParams &params = BlobParams());
+
+    // 批量：写成 NCHW，第 i 张图从 dst + i*C*H*W 开始；num_threads <= 0 时取硬件线程数
+    // 未指定 params.size 时所有图片尺寸必须一致
+    SIMPLECV_API bool blobFromImages(const std::vector<Mat> &imgs, float *dst,
+                                     const BlobParams &params = BlobParams(), int num_threads = 0);
+
+    // 内存映射
+    // 返回的 Mat 直接指向文件映射，不拷贝像素；最后一个引用释放时自动解除映射
+    // writable=false：私有写时复制映射，修改 Mat 不会写回文件
+    // writable=true ：共享映射，修改直接落到文件
+    // 仅支持 8 位二进制 P5/P6（16 位 PNM 为大端，请用 imread）
+    SIMPLECV_API Mat mapPNM(const std::string &filename, bool writable = false);
+    // .npy：dtype 为 u1/<u2/<f2/<f4，C 顺序，shape 为 (h, w) 或 (h, w, c)
+    SIMPLECV_API Mat mapNpy(const std::string &filename, bool writable = false);
+    // 裸像素文件：数据从 header_bytes 开始，step 为 0 时按紧密排列
+    SIMPLECV_API Mat mapRaw(const std::string &filename, int h, int w, int c, Depth depth = Depth::U8,
+                            std::size_t header_bytes = 0, std::size_t step = 0, bool writable = false);
+
+    // 新建（覆盖）文件并以共享可写方式映射，写入 Mat 即写入文件
+    // PNM 只支持 1/3 通道；NPY 的头部补齐到 64 字节，像素起始地址与 cache line 对齐
+    SIMPLECV_API Mat createMappedPNM(const std::string &filename, int h, int w, int c);
+    SIMPLECV_API Mat createMappedNpy(const std::string &filename, int h, int w, int c, Depth depth = Depth::U8);
+    SIMPLECV_API Mat createMappedRaw(const std::string &filename, int h, int w, int c, Depth depth = Depth::U8,
+                                     std::size_t header_bytes = 0);
+
     // 返回匹配到的路径（默认按字典序排序）
     // pattern 示例：
     //   "images/*.png"
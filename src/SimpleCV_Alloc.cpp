@@ -0,0 +1,261 @@
+#include "SimpleCV.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace SimpleCV
+{
+    static inline void *aligned_alloc_bytes(std::size_t bytes)
+    {
+        return ::operator new(bytes, std::align_val_t(Mat::ALIGNMENT), std::nothrow);
+    }
+
+    static inline void aligned_free_bytes(void *ptr)
+    {
+        ::operator delete(ptr, std::align_val_t(Mat::ALIGNMENT));
+    }
+
+    // ===== 系统堆分配器 =====
+    class StdMatAllocator : public MatAllocator
+    {
+    public:
+        void *allocate(std::size_t bytes) override
+        {
+            return aligned_alloc_bytes(bytes);
+        }
+
+        void deallocate(void *ptr, std::size_t /*bytes*/) override
+        {
+            aligned_free_bytes(ptr);
+        }
+    };
+
+    MatAllocator *getStdAllocator()
+    {
+        // 故意泄漏：保证静态对象析构期间仍有 Mat 释放时分配器依然有效
+        static MatAllocator *instance = new StdMatAllocator();
+        return instance;
+    }
+
+    // ===== 池化分配器 =====
+    namespace
+    {
+        const std::size_t kSmallStep = 64;
+        const std::size_t kSmallClasses = 4; // 64/128/192/256
+        const int kSubClasses = 4;           // 每个 2 的幂区间的细分档数
+        const int kMaxLog2 = 8 * static_cast<int>(sizeof(std::size_t)) - 1;
+        const std::size_t kNumClasses = kSmallClasses + static_cast<std::size_t>(kMaxLog2 - 8) * kSubClasses;
+
+        inline int floor_log2(std::size_t v)
+        {
+            int r = 0;
+            while (v >>= 1)
+                ++r;
+            return r;
+        }
+
+        // bytes -> (class index, 该档的实际块大小)；超出范围返回 false
+        inline bool size_class(std::size_t bytes, std::size_t &idx, std::size_t &block)
+        {
+            if (bytes == 0)
+                bytes = 1;
+            if (bytes <= kSmallStep * kSmallClasses)
+            {
+                idx = (bytes + kSmallStep - 1) / kSmallStep - 1;
+                block = (idx + 1) * kSmallStep;
+                return true;
+            }
+
+            // 2^p < bytes <= 2^(p+1)，区间等分为 kSubClasses 档
+            const int p = floor_log2(bytes - 1);
+            if (p >= kMaxLog2)
+                return false;
+            const std::size_t base = std::size_t(1) << p;
+            const std::size_t step = base / kSubClasses;
+            const std::size_t k = (bytes - base + step - 1) / step; // 1..kSubClasses
+            idx = kSmallClasses + static_cast<std::size_t>(p - 8) * kSubClasses + (k - 1);
+            block = base + k * step;
+            return idx < kNumClasses;
+        }
+
+        // size_class 的反向：class index -> 该档的块大小
+        inline std::size_t class_block(std::size_t idx)
+        {
+            if (idx < kSmallClasses)
+                return (idx + 1) * kSmallStep;
+            const std::size_t rel = idx - kSmallClasses;
+            const std::size_t base = std::size_t(1) << (8 + rel / kSubClasses);
+            return base + (rel % kSubClasses + 1) * (base / kSubClasses);
+        }
+    }
+
+    struct PoolMatAllocator::Impl
+    {
+        mutable std::mutex mtx;
+        std::vector<std::vector<void *>> free_lists;
+        std::size_t max_cached_bytes = 0;
+        MatAllocatorStats st;
+
+        Impl() : free_lists(kNumClasses) {}
+    };
+
+    PoolMatAllocator::PoolMatAllocator(std::size_t max_cached_bytes)
+        : impl_(new Impl())
+    {
+        impl_->max_cached_bytes = max_cached_bytes;
+    }
+
+    PoolMatAllocator::~PoolMatAllocator()
+    {
+        trim();
+        delete impl_;
+    }
+
+    void *PoolMatAllocator::allocate(std::size_t bytes)
+    {
+        std::size_t idx = 0, block = 0;
+        if (!size_class(bytes, idx, block))
+            return nullptr;
+
+        {
+            std::lock_guard<std::mutex> lk(impl_->mtx);
+            std::vector<void *> &fl = impl_->free_lists[idx];
+            if (!fl.empty())
+            {
+                void *p = fl.back();
+                fl.pop_back();
+                impl_->st.hits++;
+                impl_->st.cached_blocks--;
+                impl_->st.cached_bytes -= block;
+                impl_->st.live_blocks++;
+                impl_->st.live_bytes += block;
+                return p;
+            }
+        }
+
+        void *p = aligned_alloc_bytes(block);
+        if (!p)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lk(impl_->mtx);
+        impl_->st.misses++;
+        impl_->st.live_blocks++;
+        impl_->st.live_bytes += block;
+        return p;
+    }
+
+    void PoolMatAllocator::deallocate(void *ptr, std::size_t bytes)
+    {
+        if (!ptr)
+            return;
+        std::size_t idx = 0, block = 0;
+        size_class(bytes, idx, block);
+
+        {
+            std::lock_guard<std::mutex> lk(impl_->mtx);
+            impl_->st.deallocations++;
+            impl_->st.live_blocks--;
+            impl_->st.live_bytes -= block;
+            if (impl_->st.cached_bytes + block <= impl_->max_cached_bytes)
+            {
+                std::vector<void *> &fl = impl_->free_lists[idx];
+                // push_back 可能扩容失败；失败时直接释放
+                try
+                {
+                    fl.push_back(ptr);
+                    impl_->st.cached_blocks++;
+                    impl_->st.cached_bytes += block;
+                    return;
+                }
+                catch (const std::bad_alloc &)
+                {
+                }
+            }
+        }
+        aligned_free_bytes(ptr);
+    }
+
+    MatAllocatorStats PoolMatAllocator::stats() const
+    {
+        std::lock_guard<std::mutex> lk(impl_->mtx);
+        return impl_->st;
+    }
+
+    void PoolMatAllocator::resetStats()
+    {
+        std::lock_guard<std::mutex> lk(impl_->mtx);
+        impl_->st.hits = 0;
+        impl_->st.misses = 0;
+        impl_->st.deallocations = 0;
+    }
+
+    void PoolMatAllocator::trim()
+    {
+        std::vector<std::vector<void *>> lists(kNumClasses);
+        {
+            std::lock_guard<std::mutex> lk(impl_->mtx);
+            lists.swap(impl_->free_lists);
+            impl_->st.cached_blocks = 0;
+            impl_->st.cached_bytes = 0;
+        }
+        for (auto &fl : lists)
+            for (void *p : fl)
+                aligned_free_bytes(p);
+    }
+
+    void PoolMatAllocator::setMaxCachedBytes(std::size_t bytes)
+    {
+        // 只释放超出新上限的部分，从最大的档开始：用最少的块腾出空间，小块留着继续复用
+        std::vector<void *> evicted;
+        {
+            std::lock_guard<std::mutex> lk(impl_->mtx);
+            impl_->max_cached_bytes = bytes;
+            if (impl_->st.cached_bytes > bytes)
+                evicted.reserve(impl_->st.cached_blocks);
+            for (std::size_t idx = kNumClasses; idx-- > 0 && impl_->st.cached_bytes > bytes;)
+            {
+                std::vector<void *> &fl = impl_->free_lists[idx];
+                const std::size_t block = class_block(idx);
+                while (!fl.empty() && impl_->st.cached_bytes > bytes)
+                {
+                    evicted.push_back(fl.back());
+                    fl.pop_back();
+                    impl_->st.cached_blocks--;
+                    impl_->st.cached_bytes -= block;
+                }
+            }
+        }
+        for (void *p : evicted)
+            aligned_free_bytes(p);
+    }
+
+    PoolMatAllocator *getPoolAllocator()
+    {
+        static PoolMatAllocator *instance = new PoolMatAllocator();
+        return instance;
+    }
+
+    // ===== 全局 / 线程级选择 =====
+    static std::atomic<MatAllocator *> g_default_allocator{nullptr};
+    static thread_local MatAllocator *t_thread_allocator = nullptr;
+
+    void setDefaultAllocator(MatAllocator *allocator)
+    {
+        g_default_allocator.store(allocator, std::memory_order_release);
+    }
+
+    void setThreadAllocator(MatAllocator *allocator)
+    {
+        t_thread_allocator = allocator;
+    }
+
+    MatAllocator *getDefaultAllocator()
+    {
+        if (t_thread_allocator)
+            return t_thread_allocator;
+        MatAllocator *a = g_default_allocator.load(std::memory_order_acquire);
+        return a ? a : getStdAllocator();
+    }
+}
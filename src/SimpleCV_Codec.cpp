@@ -1,84 +1,1077 @@
 #include "SimpleCV.hpp"
 #include "SimpleCV_Common.hpp"
+#include "SimpleCV_Parallel.hpp"
+#include "SimpleCV_Png.hpp"
+#include "SimpleCV_Pnm.hpp"
+#include "SimpleCV_Registry.hpp"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #endif
+
 #ifndef STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #endif
 
+namespace SimpleCV
+{
+    // 解码到调用方 dst 时，stb 申请与 dst 等大的缓冲区就直接交出 dst 的内存，
+    // 省掉“stb 缓冲区 -> dst”的拷贝；中间缓冲区碰巧等大也无妨，释放时只会被标记为空闲
+    struct DecodeHint
+    {
+        unsigned char *ptr = nullptr;
+        size_t bytes = 0;
+        bool in_use = false;
+    };
+    static thread_local DecodeHint t_decode_hint;
+
+    struct DecodeHintScope
+    {
+        explicit DecodeHintScope(Mat *dst)
+        {
+            if (dst)
+            {
+                t_decode_hint.ptr = dst->data;
+                t_decode_hint.bytes = (size_t)dst->height * (size_t)dst->step;
+                t_decode_hint.in_use = false;
+            }
+        }
+        ~DecodeHintScope() { t_decode_hint = DecodeHint(); }
+    };
+
+    static void *stbi_codec_malloc(size_t bytes)
+    {
+        DecodeHint &h = t_decode_hint;
+        if (h.ptr && !h.in_use && bytes == h.bytes)
+        {
+            h.in_use = true;
+            return h.ptr;
+        }
+        return detail::tracked_malloc(bytes);
+    }
+
+    static void *stbi_codec_realloc(void *p, size_t bytes)
+    {
+        DecodeHint &h = t_decode_hint;
+        if (p && p == h.ptr)
+        {
+            // dst 不能被 realloc，换成普通缓冲区
+            void *np = detail::tracked_malloc(bytes);
+            if (np)
+            {
+                std::memcpy(np, p, std::min(bytes, h.bytes));
+                h.in_use = false;
+            }
+            return np;
+        }
+        return detail::tracked_realloc(p, bytes);
+    }
+
+    static void stbi_codec_free(void *p)
+    {
+        DecodeHint &h = t_decode_hint;
+        if (p && p == h.ptr)
+        {
+            h.in_use = false;
+            return;
+        }
+        detail::tracked_free(p);
+    }
+}
+
+// stb 的所有堆分配都走统计（含 imread 返回的 Mat 所持有的解码缓冲区）
+#define STBI_MALLOC(sz) SimpleCV::stbi_codec_malloc(sz)
+#define STBI_REALLOC(p, newsz) SimpleCV::stbi_codec_realloc(p, newsz)
+#define STBI_FREE(p) SimpleCV::stbi_codec_free(p)
+#define STBIW_MALLOC(sz) SimpleCV::detail::tracked_malloc(sz)
+#define STBIW_REALLOC(p, newsz) SimpleCV::detail::tracked_realloc(p, newsz)
+#define STBIW_FREE(p) SimpleCV::detail::tracked_free(p)
+
 #include "stb_image.h"
 #include "stb_image_write.h"
 #include <cctype>
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <filesystem>
+#include <istream>
 #include <string_view>
 
 namespace SimpleCV
 {
-    Mat imread(const std::string &filename, ColorSpace flag)
+    // JPEG 缩小解码的比例（2^shift），只在作用域内对当前线程生效
+    struct JpegScaleScope
     {
-        int w = 0, h = 0, c = 0;
+        explicit JpegScaleScope(int shift) { stbi_set_jpeg_scale_shift_thread(shift); }
+        ~JpegScaleScope() { stbi_set_jpeg_scale_shift_thread(0); }
+    };
+
+    // 池中线程临时沿用调用线程的分配器；解码抛出异常时也要还原，线程还会被复用
+    struct ThreadAllocatorScope
+    {
+        explicit ThreadAllocatorScope(MatAllocator *alloc) : set(getDefaultAllocator() != alloc)
+        {
+            if (set)
+                setThreadAllocator(alloc);
+        }
+        ~ThreadAllocatorScope()
+        {
+            if (set)
+                setThreadAllocator(nullptr);
+        }
+        bool set;
+    };
+
+    // Reader 只能顺序读一遍：先预读一段文件头供格式探测（16 位/HDR/PNM 判断），
+    // 解码时先把这段交给 stb，再接着从 Reader 读
+    struct ReaderStream
+    {
+        Reader *reader = nullptr;
+        unsigned char prefix[256];
+        int prefix_len = 0;
+        int prefix_pos = 0;
+
+        explicit ReaderStream(Reader &r) : reader(&r)
+        {
+            while (prefix_len < (int)sizeof(prefix) && !reader->eof())
+            {
+                const int n = reader->read(prefix + prefix_len, (int)sizeof(prefix) - prefix_len);
+                if (n <= 0)
+                    break;
+                prefix_len += n;
+            }
+        }
+
+        static int read_cb(void *user, char *data, int size)
+        {
+            ReaderStream *s = static_cast<ReaderStream *>(user);
+            int n = std::min(size, s->prefix_len - s->prefix_pos);
+            if (n > 0)
+            {
+                std::memcpy(data, s->prefix + s->prefix_pos, (size_t)n);
+                s->prefix_pos += n;
+            }
+            if (n < size && !s->reader->eof())
+                n += std::max(0, s->reader->read(data + n, size - n));
+            return n;
+        }
+        static void skip_cb(void *user, int n)
+        {
+            ReaderStream *s = static_cast<ReaderStream *>(user);
+            const int k = std::max(0, std::min(n, s->prefix_len - s->prefix_pos));
+            s->prefix_pos += k;
+            if (n > k)
+                s->reader->skip(n - k);
+        }
+        static int eof_cb(void *user)
+        {
+            ReaderStream *s = static_cast<ReaderStream *>(user);
+            return s->prefix_pos >= s->prefix_len && s->reader->eof() ? 1 : 0;
+        }
+    };
+
+    static const stbi_io_callbacks kReaderCallbacks = {ReaderStream::read_cb, ReaderStream::skip_cb,
+                                                       ReaderStream::eof_cb};
+
+    void Reader::skip(int n)
+    {
+        char scratch[4096];
+        while (n > 0 && !eof())
+        {
+            const int got = read(scratch, std::min(n, (int)sizeof(scratch)));
+            if (got <= 0)
+                break;
+            n -= got;
+        }
+    }
+
+    IStreamReader::IStreamReader(std::istream &is) : is_(is) {}
+
+    int IStreamReader::read(void *dst, int size)
+    {
+        is_.read(static_cast<char *>(dst), size);
+        return static_cast<int>(is_.gcount());
+    }
+
+    void IStreamReader::skip(int n)
+    {
+        is_.ignore(n);
+    }
+
+    bool IStreamReader::eof()
+    {
+        return !is_.good() || is_.peek() == std::char_traits<char>::eof();
+    }
+
+    // 解码来源：文件、内存或 Reader，统一成同一组 stb 调用
+    // 文件来源只打开一次：首次用到时打开并预读文件头，格式探测都在这段文件头或同一个 FILE* 上完成
+    struct StbSource
+    {
+        const char *filename = nullptr;
+        const stbi_uc *buf = nullptr; // Reader 来源时指向预读的文件头，只用于探测
+        int len = 0;
+        ReaderStream *stream = nullptr;
+        int jpeg_shift = 0; // JPEG 按 1/2^shift 解码，其它格式忽略
+
+        StbSource() = default;
+        StbSource(const StbSource &) = delete;
+        StbSource &operator=(const StbSource &) = delete;
+        ~StbSource()
+        {
+            if (file_)
+                fclose(file_);
+        }
+
+        // 文件来源的 FILE*，每次交出前回到文件开头；打不开时返回 nullptr 并设置 stb 的错误信息
+        FILE *file() const
+        {
+            if (!opened_)
+            {
+                opened_ = true;
+                file_ = stbi__fopen(filename, "rb");
+                if (file_)
+                    head_len_ = (int)fread(head_, 1, sizeof(head_), file_);
+            }
+            if (!file_)
+            {
+                stbi__err("can't fopen", "Unable to open file");
+                return nullptr;
+            }
+            fseek(file_, 0, SEEK_SET);
+            return file_;
+        }
+        // 用于探测的文件头：文件来源为预读的前 256 字节，内存来源即整个缓冲区
+        const unsigned char *head(int *n) const
+        {
+            if (filename)
+            {
+                *n = file() ? head_len_ : 0;
+                return file_ ? head_ : nullptr;
+            }
+            *n = len;
+            return buf;
+        }
+
+        unsigned char *load8(int *w, int *h, int *c, int req) const
+        {
+            JpegScaleScope scale(jpeg_shift);
+            if (stream)
+                return stbi_load_from_callbacks(&kReaderCallbacks, stream, w, h, c, req);
+            if (!filename)
+                return stbi_load_from_memory(buf, len, w, h, c, req);
+            FILE *f = file();
+            return f ? stbi_load_from_file(f, w, h, c, req) : nullptr;
+        }
+        stbi_us *load16(int *w, int *h, int *c, int req) const
+        {
+            JpegScaleScope scale(jpeg_shift);
+            if (stream)
+                return stbi_load_16_from_callbacks(&kReaderCallbacks, stream, w, h, c, req);
+            if (!filename)
+                return stbi_load_16_from_memory(buf, len, w, h, c, req);
+            FILE *f = file();
+            return f ? stbi_load_from_file_16(f, w, h, c, req) : nullptr;
+        }
+        float *loadf(int *w, int *h, int *c, int req) const
+        {
+            JpegScaleScope scale(jpeg_shift);
+            if (stream)
+                return stbi_loadf_from_callbacks(&kReaderCallbacks, stream, w, h, c, req);
+            if (!filename)
+                return stbi_loadf_from_memory(buf, len, w, h, c, req);
+            FILE *f = file();
+            return f ? stbi_loadf_from_file(f, w, h, c, req) : nullptr;
+        }
+        // 给出的是解码结果的尺寸（已计入 jpeg_shift）；Reader 来源读头部会消耗数据，不提供
+        bool info(int *w, int *h, int *c) const
+        {
+            if (stream)
+                return false;
+            bool ok = false;
+            if (!filename)
+                ok = stbi_info_from_memory(buf, len, w, h, c) != 0;
+            else if (FILE *f = file())
+                ok = stbi_info_from_file(f, w, h, c) != 0;
+            if (ok && jpeg_shift > 0 && is_jpeg())
+            {
+                const int round = (1 << jpeg_shift) - 1;
+                *w = (*w + round) >> jpeg_shift;
+                *h = (*h + round) >> jpeg_shift;
+            }
+            return ok;
+        }
+        // HDR 只看开头的签名，文件头就够了
+        bool is_hdr() const
+        {
+            int n = 0;
+            const unsigned char *p = head(&n);
+            return n > 0 && stbi_is_hdr_from_memory(p, n) != 0;
+        }
+        // 16 位要读到 PNG 的 IHDR / PNM 的 maxval（可能隔着注释），在 FILE* 上探测
+        bool is_16_bit() const
+        {
+            if (!filename)
+                return stbi_is_16_bit_from_memory(buf, len) != 0;
+            FILE *f = file();
+            return f && stbi_is_16_bit_from_file(f) != 0;
+        }
+        // 二进制 PGM/PPM（P5/P6）
+        bool is_pnm() const
+        {
+            unsigned char magic[2] = {0, 0};
+            if (!read_magic(magic, 2))
+                return false;
+            return magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6');
+        }
+        // 原生路径处理的 P5/P6/Pf/PF
+        bool is_pnm_or_pfm() const
+        {
+            unsigned char magic[2] = {0, 0};
+            if (!read_magic(magic, 2))
+                return false;
+            return magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6' || magic[1] == 'f' || magic[1] == 'F');
+        }
+        bool is_jpeg() const
+        {
+            unsigned char magic[3] = {0, 0, 0};
+            if (!read_magic(magic, 3))
+                return false;
+            return magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF;
+        }
+        bool read_magic(unsigned char *magic, int n) const
+        {
+            int avail = 0;
+            const unsigned char *p = head(&avail);
+            if (avail < n)
+                return false;
+            std::memcpy(magic, p, (size_t)n);
+            return true;
+        }
+
+    private:
+        mutable FILE *file_ = nullptr;
+        mutable bool opened_ = false;
+        mutable unsigned char head_[256];
+        mutable int head_len_ = 0;
+    };
+
+    static inline std::shared_ptr<unsigned char> stb_owner(void *p)
+    {
+        return std::shared_ptr<unsigned char>(static_cast<unsigned char *>(p), [](unsigned char *ptr)
+                                              { stbi_image_free(ptr); });
+    }
+
+    // stb 输出（紧密排列）写入 dst 的一遍转换：depth 转换与 R/B 交换同时完成
+    template <typename S, typename D, typename Fn>
+    static void store_rows(const void *p, Mat &dst, bool swap_rb, Fn cvt)
+    {
+        const int c = dst.channels;
+        const size_t n = (size_t)dst.width * c;
+        const bool swap = swap_rb && c >= 3;
+        for (int y = 0; y < dst.height; ++y)
+        {
+            const S *sp = static_cast<const S *>(p) + (size_t)y * n;
+            D *dp = dst.ptr<D>(y);
+            if (!swap)
+            {
+                for (size_t i = 0; i < n; ++i)
+                    dp[i] = cvt(sp[i]);
+                continue;
+            }
+            for (int x = 0; x < dst.width; ++x)
+            {
+                const S *q = sp + (size_t)x * c;
+                D *o = dp + (size_t)x * c;
+                o[0] = cvt(q[2]);
+                o[1] = cvt(q[1]);
+                o[2] = cvt(q[0]);
+                for (int k = 3; k < c; ++k)
+                    o[k] = cvt(q[k]);
+            }
+        }
+    }
+
+    // stb_depth 为 stb 给出的样本类型（U8 / U16 / F32），按 dst.depth 转换
+    // 16 位 PNM 按大端存储，而 stb 按本机字节序直接拷贝样本，这里一并修正
+    static void store_decoded(const void *p, Depth stb_depth, Mat &dst, bool pnm16, bool swap_rb)
+    {
+        if (stb_depth == Depth::U8)
+        {
+            store_rows<std::uint8_t, std::uint8_t>(p, dst, swap_rb, [](std::uint8_t v)
+                                                   { return v; });
+            return;
+        }
+        if (stb_depth == Depth::F32)
+        {
+            if (dst.depth == Depth::F16)
+                store_rows<float, float16>(p, dst, swap_rb, [](float v)
+                                           { return float16(v); });
+            else
+                store_rows<float, float>(p, dst, swap_rb, [](float v)
+                                         { return v; });
+            return;
+        }
+
+        const bool bswap = pnm16 && host_is_little_endian();
+        auto load = [bswap](std::uint16_t v) -> std::uint16_t
+        { return bswap ? (std::uint16_t)((v >> 8) | (v << 8)) : v; };
+        const float k = 1.0f / 65535.0f; // LDR 浮点约定 0..1
+        switch (dst.depth)
+        {
+        case Depth::U8:
+            store_rows<std::uint16_t, std::uint8_t>(p, dst, swap_rb, [load](std::uint16_t v)
+                                                    { return (std::uint8_t)(load(v) >> 8); });
+            break;
+        case Depth::U16:
+            store_rows<std::uint16_t, std::uint16_t>(p, dst, swap_rb, load);
+            break;
+        case Depth::F16:
+            store_rows<std::uint16_t, float16>(p, dst, swap_rb, [load, k](std::uint16_t v)
+                                               { return float16(load(v) * k); });
+            break;
+        case Depth::F32:
+            store_rows<std::uint16_t, float>(p, dst, swap_rb, [load, k](std::uint16_t v)
+                                             { return load(v) * k; });
+            break;
+        }
+    }
+
+    // 解码到 dst：dst 的尺寸/通道/depth 与结果一致时写进它现有的缓冲区（可以是带 stride 的视图），
+    // 否则 dst 换成新缓冲区（无需转换时直接接管 stb 的输出）
+    static bool decode_image_stb(const StbSource &src, ColorSpace flag, Depth depth, Mat &dst)
+    {
+        // 二进制 PGM/PPM/PFM 不经 stb，按行直接读进 dst；先用已预读的文件头认 magic，其它格式不多读一次
+        if (!src.stream && src.is_pnm_or_pfm())
+        {
+            bool ok = false;
+            bool handled = false;
+            if (src.filename)
+            {
+                FILE *f = src.file();
+                if (!f)
+                    return false;
+                handled = detail::pnm_decode(f, nullptr, 0, flag, depth, dst, ok);
+            }
+            else
+                handled = detail::pnm_decode(nullptr, src.buf, (size_t)src.len, flag, depth, dst, ok);
+            if (handled)
+            {
+                if (!ok)
+                    stbi__err("bad PNM", "Corrupt or truncated PNM/PFM");
+                return ok;
+            }
+        }
+
         const int req_c = desired_channels(flag);
+        const bool swap_rb = is_bgr_family(flag);
+
+        // 16 位 PNM 需要先拿到 16 位样本修正字节序，再转换到目标 depth
+        const bool pnm16 = src.is_16_bit() && src.is_pnm();
+
+        // stb 给出的样本类型：HDR 直接取线性 float；其余非 U8 的请求走 16 位
+        // （不走 stbi_loadf：它会对 LDR 图像做 gamma 变换；8 位源由 stb 扩展到 16 位，v*257）
+        Depth stb_depth = Depth::U16;
+        if (depth == Depth::U8 && !pnm16)
+            stb_depth = Depth::U8;
+        else if ((depth == Depth::F32 || depth == Depth::F16) && src.is_hdr())
+            stb_depth = Depth::F32;
+        const bool direct = stb_depth == depth && !pnm16;
+
+        int w = 0, h = 0, c = 0;
+        bool reuse = false;
+        if (!dst.empty() && src.info(&w, &h, &c))
+            reuse = dst_buffer_compatible(dst, h, w, req_c != 0 ? req_c : c, depth);
 
-        unsigned char *p = stbi_load(filename.c_str(), &w, &h, &c, req_c);
+        void *p = nullptr;
+        {
+            // 结果可原样使用且 dst 紧密连续时，让 stb 直接把最终输出写进 dst
+            const bool packed = reuse && dst.isContinuous() && dst.step == dst.width * dst.elemSize();
+            DecodeHintScope hint(direct && packed ? &dst : nullptr);
+            if (stb_depth == Depth::U8)
+                p = src.load8(&w, &h, &c, req_c);
+            else if (stb_depth == Depth::F32)
+                p = src.loadf(&w, &h, &c, req_c);
+            else
+                p = src.load16(&w, &h, &c, req_c);
+        }
         if (!p)
-            return Mat();
+            return false;
+
+        const int out_c = (req_c != 0) ? req_c : c;
+        if (p == dst.data)
+        {
+            if (swap_rb)
+                swap_rb_inplace(dst);
+            return true;
+        }
 
-        int out_c = (req_c != 0) ? req_c : c;
+        std::shared_ptr<unsigned char> owner = stb_owner(p);
+        // 事先拿不到尺寸（Reader 来源）时，也在这里按实际结果复用 dst
+        if (!dst.empty() && dst_buffer_compatible(dst, h, w, out_c, depth))
+        {
+            store_decoded(p, stb_depth, dst, pnm16, swap_rb);
+            return true;
+        }
 
-        Mat m;
-        m.owner_ = std::shared_ptr<unsigned char>(p, [](unsigned char *ptr)
-                                                  { stbi_image_free(ptr); });
-        m.height = h;
-        m.width = w;
-        m.channels = out_c;
-        m.step = w * out_c;
-        m.data = m.owner_.get();
+        if (direct)
+        {
+            detail::MatAccess::adopt(dst, std::move(owner), h, w, out_c, depth, w * out_c * depthSize(depth));
+            // stb 输出 3/4 通道默认 RGB/RGBA，如果用户要 BGR/BGRA，则交换 R/B
+            if (swap_rb)
+                swap_rb_inplace(dst);
+            return true;
+        }
+
+        Mat out(h, w, out_c, depth);
+        store_decoded(p, stb_depth, out, pnm16, swap_rb);
+        dst = std::move(out);
+        return true;
+    }
+
+    // 从文件开头读出全部内容
+    static bool read_file_bytes(FILE *f, std::vector<unsigned char> &bytes)
+    {
+        bytes.clear();
+        if (!f || fseek(f, 0, SEEK_END) != 0)
+            return false;
+        const long size = ftell(f);
+        if (size <= 0 || fseek(f, 0, SEEK_SET) != 0)
+            return false;
+        bytes.resize((size_t)size);
+        bytes.resize(fread(bytes.data(), 1, bytes.size(), f));
+        return !bytes.empty();
+    }
+
+    // 先按优先级试外部后端；文件来源只在有后端认得文件头时才整个读进内存
+    static bool decode_with_backends(const StbSource &src, ColorSpace flag, Depth depth, Mat &dst)
+    {
+        int head_len = 0;
+        const unsigned char *head = src.head(&head_len);
+        if (!head)
+            return false;
+        const size_t n = std::min<size_t>(16, (size_t)head_len);
 
-        // stb 输出 3/4 通道默认 RGB/RGBA，如果用户要 BGR/BGRA，则交换 R/B
-        if (flag == ColorSpace::BGR || flag == ColorSpace::BGRA)
+        CodecDecodeOptions opts;
+        opts.flag = flag;
+        opts.depth = depth;
+        opts.scale = 1 << src.jpeg_shift;
+        const int req_c = desired_channels(flag);
+        std::vector<unsigned char> file_bytes;
+        for (const std::shared_ptr<ImageCodec> &codec : detail::external_codecs())
         {
-            swap_rb_inplace(m);
+            const CodecCaps caps = codec->caps();
+            if (!caps.decode || (opts.scale > 1 && !caps.scaled_decode) || (depth != Depth::U8 && !caps.bit16) ||
+                !codec->matchesMagic(head, n))
+                continue;
+            if (src.filename && file_bytes.empty() && !read_file_bytes(src.file(), file_bytes))
+                return false;
+            const ByteSpan buf = src.filename ? ByteSpan(file_bytes) : ByteSpan(src.buf, (size_t)src.len);
+
+            Mat out;
+            if (caps.stride)
+                out = dst;
+            if (!codec->decode(buf, out, opts) || out.empty() || out.depth != depth ||
+                (req_c != 0 && out.channels != req_c))
+                continue;
+
+            // 后端没有写进 dst 时，按 imread(path, dst) 的约定拷进尺寸一致的 dst
+            if (out.data != dst.data && !dst.empty() && dst_buffer_compatible(dst, out.height, out.width, out.channels, depth))
+            {
+                const size_t row = (size_t)out.width * out.elemSize();
+                for (int y = 0; y < out.height; ++y)
+                    std::memcpy(dst.data + (size_t)y * dst.step, out.data + (size_t)y * out.step, row);
+            }
+            else if (out.data != dst.data)
+                dst = out;
+            return true;
         }
+        return false;
+    }
+
+    static bool decode_image(const StbSource &src, ColorSpace flag, Depth depth, Mat &dst)
+    {
+        // Reader 只能读一遍，流式来源只走 stb
+        if (detail::has_external_codecs() && !src.stream && decode_with_backends(src, flag, depth, dst))
+            return true;
+        return decode_image_stb(src, flag, depth, dst);
+    }
 
+    static Mat decode_image(const StbSource &src, ColorSpace flag, Depth depth)
+    {
+        Mat m;
+        decode_image(src, flag, depth, m);
         return m;
     }
 
+    // 按文件头识别格式；TGA 没有魔数，stbi_info 认得但这里识别不出的都归为 TGA
+    static ImageFormat detect_format(const unsigned char *p, size_t n)
+    {
+        if (n >= 8 && std::memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0)
+            return ImageFormat::PNG;
+        if (n >= 3 && p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF)
+            return ImageFormat::JPEG;
+        if (n >= 2 && p[0] == 'B' && p[1] == 'M')
+            return ImageFormat::BMP;
+        if (n >= 4 && std::memcmp(p, "GIF8", 4) == 0)
+            return ImageFormat::GIF;
+        if (n >= 4 && std::memcmp(p, "8BPS", 4) == 0)
+            return ImageFormat::PSD;
+        if (n >= 4 && p[0] == 0x53 && p[1] == 0x80 && p[2] == 0xF6 && p[3] == 0x34)
+            return ImageFormat::PIC;
+        if (n >= 2 && p[0] == 'P' && (p[1] == '5' || p[1] == '6'))
+            return ImageFormat::PNM;
+        if (n >= 2 && p[0] == '#' && p[1] == '?')
+            return ImageFormat::HDR;
+        return ImageFormat::TGA;
+    }
+
+    static ImageInfo make_info(int w, int h, int c, bool is16, bool hdr, ImageFormat fmt)
+    {
+        ImageInfo info;
+        info.width = w;
+        info.height = h;
+        info.channels = c;
+        info.bits = hdr ? 32 : (is16 ? 16 : 8);
+        info.hdr = hdr;
+        info.format = fmt;
+        return info;
+    }
+
+    // stb 不认得 PFM，按 32 位 float 的 PNM 报告
+    static ImageInfo pfm_info(const unsigned char *p, size_t n)
+    {
+        PnmHeader h;
+        if (!parse_pfm_header(p, n, h))
+            return ImageInfo();
+        return make_info(h.width, h.height, h.channels, false, true, ImageFormat::PNM);
+    }
+
+    ImageInfo imreadInfo(const std::string &filename)
+    {
+        FILE *f = stbi__fopen(filename.c_str(), "rb");
+        if (!f)
+            return ImageInfo();
+
+        unsigned char magic[64] = {0};
+        const size_t n = fread(magic, 1, sizeof(magic), f);
+        fseek(f, 0, SEEK_SET);
+
+        // 三个 *_from_file 调用都会把文件位置恢复到调用前
+        int w = 0, h = 0, c = 0;
+        ImageInfo info;
+        if (stbi_info_from_file(f, &w, &h, &c))
+            info = make_info(w, h, c, stbi_is_16_bit_from_file(f) != 0, stbi_is_hdr_from_file(f) != 0,
+                             detect_format(magic, n));
+        else
+            info = pfm_info(magic, n);
+        fclose(f);
+        return info;
+    }
+
+    ImageInfo imdecodeInfo(ByteSpan buf)
+    {
+        if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()))
+            return ImageInfo();
+
+        const int len = static_cast<int>(buf.size);
+        int w = 0, h = 0, c = 0;
+        if (!stbi_info_from_memory(buf.data, len, &w, &h, &c))
+            return pfm_info(buf.data, buf.size);
+        return make_info(w, h, c, stbi_is_16_bit_from_memory(buf.data, len) != 0,
+                         stbi_is_hdr_from_memory(buf.data, len) != 0, detect_format(buf.data, buf.size));
+    }
+
+    ImageInfo imdecodeInfo(const void *data, size_t len)
+    {
+        return imdecodeInfo(ByteSpan(data, len));
+    }
+
+    Mat imread(const std::string &filename, ColorSpace flag)
+    {
+        return imread(filename, flag, Depth::U8);
+    }
+
+    Mat imread(const std::string &filename, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imread");
+        StbSource src;
+        src.filename = filename.c_str();
+        return decode_image(src, flag, depth);
+    }
+
+    bool imread(const std::string &filename, Mat &dst, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imread");
+        StbSource src;
+        src.filename = filename.c_str();
+        return decode_image(src, flag, depth, dst);
+    }
+
     Mat imdecode(const std::vector<unsigned char> &buf, ColorSpace flag)
     {
-        if (buf.empty())
+        return imdecode(ByteSpan(buf), flag, Depth::U8);
+    }
+
+    Mat imdecode(const std::vector<unsigned char> &buf, ColorSpace flag, Depth depth)
+    {
+        return imdecode(ByteSpan(buf), flag, depth);
+    }
+
+    Mat imdecode(const void *data, std::size_t len, ColorSpace flag)
+    {
+        return imdecode(ByteSpan(data, len), flag, Depth::U8);
+    }
+
+    Mat imdecode(const void *data, std::size_t len, ColorSpace flag, Depth depth)
+    {
+        return imdecode(ByteSpan(data, len), flag, depth);
+    }
+
+    Mat imdecode(ByteSpan buf, ColorSpace flag)
+    {
+        return imdecode(buf, flag, Depth::U8);
+    }
+
+    Mat imdecode(ByteSpan buf, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imdecode");
+        // stb 用 int 表示长度
+        if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()))
+            return Mat();
+
+        StbSource src;
+        src.buf = buf.data;
+        src.len = static_cast<int>(buf.size);
+        return decode_image(src, flag, depth);
+    }
+
+    bool imdecode(ByteSpan buf, Mat &dst, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imdecode");
+        if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()))
+            return false;
+
+        StbSource src;
+        src.buf = buf.data;
+        src.len = static_cast<int>(buf.size);
+        return decode_image(src, flag, depth, dst);
+    }
+
+    // 批量解码的公共部分：第 i 项由 make_src(i, src) 给出来源（返回 false 表示输入本身无效）
+    template <typename MakeSrc>
+    static int decode_batch(int n, std::vector<Mat> &dsts, ColorSpace flag, Depth depth, int num_threads,
+                            std::vector<std::string> *errors, const char *site, MakeSrc make_src)
+    {
+        dsts.resize((size_t)n);
+        if (errors)
+            errors->assign((size_t)n, std::string());
+
+        // 工作线程沿用调用线程的分配器，池化/自定义分配器对批量解码同样生效
+        MatAllocator *alloc = getDefaultAllocator();
+        std::atomic<int> decoded{0};
+        parallel_for(n, num_threads, [&](int i)
+                     {
+            ThreadAllocatorScope alloc_scope(alloc);
+            MemoryScope scope(site);
+
+            Mat &dst = dsts[(size_t)i];
+            StbSource src;
+            const char *err = nullptr;
+            // 失败原因是线程级的，池中线程上可能还留着上一项的；原生 PNM/后端失败时不会设置它
+            stbi__g_failure_reason = nullptr;
+            if (!make_src(i, src))
+                err = "empty or oversized input";
+            else if (!decode_image(src, flag, depth, dst))
+                err = stbi_failure_reason() ? stbi_failure_reason() : "decode failed";
+
+            if (err)
+            {
+                dst.release();
+                if (errors)
+                    (*errors)[(size_t)i] = err;
+            }
+            else
+                decoded.fetch_add(1, std::memory_order_relaxed); });
+        return decoded.load();
+    }
+
+    int imreadBatch(const std::vector<std::string> &filenames, std::vector<Mat> &dsts, ColorSpace flag, Depth depth,
+                    int num_threads, std::vector<std::string> *errors)
+    {
+        return decode_batch((int)filenames.size(), dsts, flag, depth, num_threads, errors, "imread",
+                            [&](int i, StbSource &src)
+                            {
+                                src.filename = filenames[(size_t)i].c_str();
+                                return true;
+                            });
+    }
+
+    int imdecodeBatch(const std::vector<ByteSpan> &bufs, std::vector<Mat> &dsts, ColorSpace flag, Depth depth,
+                      int num_threads, std::vector<std::string> *errors)
+    {
+        return decode_batch((int)bufs.size(), dsts, flag, depth, num_threads, errors, "imdecode",
+                            [&](int i, StbSource &src)
+                            {
+                                const ByteSpan &b = bufs[(size_t)i];
+                                if (b.empty() || b.size > static_cast<size_t>(std::numeric_limits<int>::max()))
+                                    return false;
+                                src.buf = b.data;
+                                src.len = static_cast<int>(b.size);
+                                return true;
+                            });
+    }
+
+    Mat imdecode(Reader &reader, ColorSpace flag, Depth depth)
+    {
+        Mat m;
+        imdecode(reader, m, flag, depth);
+        return m;
+    }
+
+    bool imdecode(Reader &reader, Mat &dst, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imdecode");
+        ReaderStream stream(reader);
+        if (stream.prefix_len == 0)
+            return false;
+
+        StbSource src;
+        src.buf = stream.prefix;
+        src.len = stream.prefix_len;
+        src.stream = &stream;
+        return decode_image(src, flag, depth, dst);
+    }
+
+    Mat imdecode(std::istream &is, ColorSpace flag, Depth depth)
+    {
+        IStreamReader reader(is);
+        return imdecode(reader, flag, depth);
+    }
+
+    static int reduce_shift(int scale)
+    {
+        switch (scale)
+        {
+        case 1:
+            return 0;
+        case 2:
+            return 1;
+        case 4:
+            return 2;
+        case 8:
+            return 3;
+        default:
+            return -1;
+        }
+    }
+
+    // JPEG 在 IDCT 阶段直接出小图；其它格式没有这种捷径，全尺寸解码后再缩小，保证输出尺寸一致
+    static Mat decode_reduced(StbSource &src, int scale, ColorSpace flag, Depth depth)
+    {
+        const int shift = reduce_shift(scale);
+        if (shift < 0)
+            return Mat();
+        if (shift == 0 || src.is_jpeg())
+        {
+            src.jpeg_shift = shift;
+            return decode_image(src, flag, depth);
+        }
+
+        Mat full = decode_image(src, flag, depth);
+        if (full.empty())
+            return full;
+        Mat out;
+        resize(full, out, (full.width + scale - 1) / scale, (full.height + scale - 1) / scale);
+        return out;
+    }
+
+    Mat imreadReduced(const std::string &filename, int scale, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imread");
+        StbSource src;
+        src.filename = filename.c_str();
+        return decode_reduced(src, scale, flag, depth);
+    }
+
+    Mat imdecodeReduced(ByteSpan buf, int scale, ColorSpace flag, Depth depth)
+    {
+        MemoryScope scope("imdecode");
+        if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()))
             return Mat();
 
+        StbSource src;
+        src.buf = buf.data;
+        src.len = static_cast<int>(buf.size);
+        return decode_reduced(src, scale, flag, depth);
+    }
+
+    // JPEG 缩小解码的捷径只在最终的解码器会缩小解码时使用：
+    // 第一个认得文件头的外部后端不支持 scale 时，让它全尺寸解码，而不是为了捷径绕回 stb
+    static bool jpeg_scaled_decoder(const StbSource &src)
+    {
+        if (!src.is_jpeg())
+            return false;
+        if (!detail::has_external_codecs() || src.stream)
+            return true;
+        int head_len = 0;
+        const unsigned char *head = src.head(&head_len);
+        const size_t n = std::min<size_t>(16, (size_t)head_len);
+        for (const std::shared_ptr<ImageCodec> &codec : detail::external_codecs())
+        {
+            const CodecCaps caps = codec->caps();
+            if (caps.decode && codec->matchesMagic(head, n))
+                return caps.scaled_decode;
+        }
+        return true;
+    }
+
+    // 解码走与 imread 相同的路径（外部后端、原生 PNM/PFM、stb），再缩放到目标尺寸。
+    // 尺寸只用于选 JPEG 的缩小比例、以及判断能否跳过缩放；探测不到（PFM、Reader 来源、只有后端认得的格式）时照常解码
+    static Mat decode_resized(StbSource &src, int width, int height, ColorSpace flag, Interp interp)
+    {
+        if (width <= 0 || height <= 0)
+            return Mat();
         int w = 0, h = 0, c = 0;
-        const int req_c = desired_channels(flag);
+        const bool known = !src.stream && src.info(&w, &h, &c);
+
+        // JPEG：取缩小后仍不小于目标尺寸的最大 IDCT 缩放比例
+        if (known && jpeg_scaled_decoder(src))
+        {
+            int shift = 3;
+            while (shift > 0 && (((w + (1 << shift) - 1) >> shift) < width || ((h + (1 << shift) - 1) >> shift) < height))
+                --shift;
+            src.jpeg_shift = shift;
+            w = (w + (1 << shift) - 1) >> shift;
+            h = (h + (1 << shift) - 1) >> shift;
+        }
 
-        unsigned char *p = stbi_load_from_memory(
-            reinterpret_cast<const stbi_uc *>(buf.data()),
-            static_cast<int>(buf.size()),
-            &w, &h, &c, req_c);
+        // 尺寸已对上时直接按 flag 解码；否则按 RGB 顺序解码，R/B 交换留给 stbir 写输出时完成
+        const bool direct = known && w == width && h == height;
+        ColorSpace decode_flag = flag;
+        if (!direct && flag == ColorSpace::BGR)
+            decode_flag = ColorSpace::RGB;
+        else if (!direct && flag == ColorSpace::BGRA)
+            decode_flag = ColorSpace::RGBA;
+        Mat decoded = decode_image(src, decode_flag, Depth::U8);
+        if (decoded.empty())
+            return Mat();
+        if (decoded.width == width && decoded.height == height && decode_flag == flag)
+            return decoded;
+        Mat out;
+        if (!detail::resize_u8(decoded, out, width, height, decode_flag != flag, interp))
+            return Mat();
+        return out;
+    }
 
-        if (!p)
+    Mat imreadResized(const std::string &filename, int width, int height, ColorSpace flag, Interp interp)
+    {
+        MemoryScope scope("imread");
+        StbSource src;
+        src.filename = filename.c_str();
+        return decode_resized(src, width, height, flag, interp);
+    }
+
+    Mat imdecodeResized(ByteSpan buf, int width, int height, ColorSpace flag, Interp interp)
+    {
+        MemoryScope scope("imdecode");
+        if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()))
             return Mat();
 
-        int out_c = (req_c != 0) ? req_c : c;
+        StbSource src;
+        src.buf = buf.data;
+        src.len = static_cast<int>(buf.size);
+        return decode_resized(src, width, height, flag, interp);
+    }
 
-        Mat m;
-        m.owner_ = std::shared_ptr<unsigned char>(p, [](unsigned char *ptr)
-                                                  { stbi_image_free(ptr); });
-        m.height = h;
-        m.width = w;
-        m.channels = out_c;
-        m.step = w * out_c;
-        m.data = m.owner_.get();
+    Mat imdecodeResized(Reader &reader, int width, int height, ColorSpace flag, Interp interp)
+    {
+        MemoryScope scope("imdecode");
+        ReaderStream stream(reader);
+        if (stream.prefix_len == 0)
+            return Mat();
+
+        StbSource src;
+        src.buf = stream.prefix;
+        src.len = stream.prefix_len;
+        src.stream = &stream;
+        return decode_resized(src, width, height, flag, interp);
+    }
+
+    // imdecodeMulti / imreadAnimation 共用，内存统计记在各自入口的标签下
+    static bool decode_multi(ByteSpan buf, std::vector<Mat> &frames, ColorSpace flag, std::vector<int> *delays)
+    {
+        frames.clear();
+        if (delays)
+            delays->clear();
+        if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()))
+            return false;
+        const int len = static_cast<int>(buf.size);
 
-        if (flag == ColorSpace::BGR || flag == ColorSpace::BGRA)
+        if (detect_format(buf.data, buf.size) != ImageFormat::GIF)
         {
-            swap_rb_inplace(m);
+            StbSource src;
+            src.buf = buf.data;
+            src.len = len;
+            Mat m = decode_image(src, flag, Depth::U8);
+            if (m.empty())
+                return false;
+            frames.push_back(m);
+            if (delays)
+                delays->push_back(0);
+            return true;
         }
 
-        return m;
+        // stb 把所有帧依次放进同一块分配：z 帧 x h 行 x w 像素
+        int *gif_delays = nullptr;
+        int w = 0, h = 0, z = 0, c = 0;
+        const int req_c = desired_channels(flag);
+        stbi_uc *p = stbi_load_gif_from_memory(buf.data, len, &gif_delays, &w, &h, &z, &c, req_c);
+        if (!p)
+            return false;
+        std::shared_ptr<unsigned char> owner = stb_owner(p);
+        const int out_c = req_c != 0 ? req_c : c;
+        const size_t row = (size_t)w * (size_t)out_c;
+        const size_t frame_bytes = row * (size_t)h;
+
+        frames.reserve((size_t)z);
+        for (int i = 0; i < z; ++i)
+            frames.emplace_back(h, w, out_c, Depth::U8, p + frame_bytes * (size_t)i, row, owner);
+        if (is_bgr_family(flag) && z > 0)
+        {
+            // 整块一次交换：把所有帧看成 z*h 行的一张图
+            Mat all(h * z, w, out_c, Depth::U8, p, row, owner);
+            swap_rb_inplace(all);
+        }
+        if (delays && gif_delays)
+            delays->assign(gif_delays, gif_delays + z);
+        else if (delays)
+            delays->assign((size_t)z, 0);
+        stbi_image_free(gif_delays);
+        return z > 0;
+    }
+
+    bool imdecodeMulti(ByteSpan buf, std::vector<Mat> &frames, ColorSpace flag, std::vector<int> *delays)
+    {
+        MemoryScope scope("imdecodeMulti");
+        return decode_multi(buf, frames, flag, delays);
+    }
+
+    bool imreadAnimation(const std::string &filename, std::vector<Mat> &frames, std::vector<int> &delays,
+                         ColorSpace flag)
+    {
+        MemoryScope scope("imreadAnimation");
+        // stb 的 GIF 多帧接口只接受内存输入
+        frames.clear();
+        delays.clear();
+        std::vector<unsigned char> bytes;
+        FILE *f = stbi__fopen(filename.c_str(), "rb");
+        if (!f)
+            return false;
+        const bool ok = read_file_bytes(f, bytes);
+        fclose(f);
+        if (!ok)
+            return false;
+        return decode_multi(bytes, frames, flag, &delays);
     }
 }
 
@@ -99,65 +1092,329 @@ namespace SimpleCV
         return to_lower(filename.substr(pos + 1));
     }
 
-    // stb 写入内存回调
-    static void stb_write_to_vector(void *context, void *data, int size)
+    // 编码统一写到 EncodeWriteFn；vector / 固定缓冲区只是两种现成的回调
+    struct EncodeSink
+    {
+        EncodeWriteFn write;
+        void *ctx;
+    };
+
+    static void stb_write_to_sink(void *context, void *data, int size)
+    {
+        auto *sink = reinterpret_cast<EncodeSink *>(context);
+        if (size > 0)
+            sink->write(sink->ctx, data, static_cast<size_t>(size));
+    }
+
+    struct FixedBuffer
+    {
+        unsigned char *dst;
+        size_t capacity;
+        size_t total; // 编码结果总长度，超出容量的部分只计数不写入
+    };
+
+    static void write_to_fixed_buffer(void *ctx, const void *data, size_t size)
+    {
+        auto *fb = reinterpret_cast<FixedBuffer *>(ctx);
+        if (fb->total <= fb->capacity && size <= fb->capacity - fb->total)
+            std::memcpy(fb->dst + fb->total, data, size);
+        fb->total += size;
+    }
+
+    static void write_to_vector(void *ctx, const void *data, size_t size)
     {
-        auto *v = reinterpret_cast<std::vector<unsigned char> *>(context);
-        auto *bytes = reinterpret_cast<unsigned char *>(data);
+        auto *v = reinterpret_cast<std::vector<unsigned char> *>(ctx);
+        auto *bytes = reinterpret_cast<const unsigned char *>(data);
         v->insert(v->end(), bytes, bytes + size);
     }
 
-    bool imencode(const Mat &mat, std::vector<unsigned char> &buf)
+    enum class EncodeFormat
     {
-        buf.clear();
-        if (mat.empty())
-            return false;
-
-        // 默认用 PNG（无损、通用）
-        // stride 是每行字节数
-        int ok = stbi_write_png_to_func(
-            stb_write_to_vector,
-            &buf,
-            mat.width,
-            mat.height,
-            mat.channels,
-            mat.data,
-            mat.step);
-        return ok ? true : false;
+        PNG,
+        JPEG,
+        BMP,
+        TGA,
+        PNM, // P5/P6，按通道数选择
+        PFM
+    };
+
+    // 扩展名可带或不带点；未知扩展名按 PNG 处理（与 imwrite 一致）
+    static EncodeFormat encode_format(const std::string &ext)
+    {
+        std::string e = to_lower(ext);
+        if (!e.empty() && e[0] == '.')
+            e.erase(0, 1);
+        if (e == "jpg" || e == "jpeg")
+            return EncodeFormat::JPEG;
+        if (e == "bmp")
+            return EncodeFormat::BMP;
+        if (e == "tga")
+            return EncodeFormat::TGA;
+        if (e == "pgm" || e == "ppm" || e == "pnm")
+            return EncodeFormat::PNM;
+        if (e == "pfm")
+            return EncodeFormat::PFM;
+        return EncodeFormat::PNG;
     }
 
-    bool imwrite(const std::string &filename, const Mat &mat)
+    // stb 的编码选项是（线程级）全局变量，调用前设置、调用后恢复默认
+    struct StbWriteOptionsScope
     {
-        if (mat.empty())
+        StbWriteOptionsScope(const ImwriteParams &params, const Mat &mat)
+        {
+            stbi_write_row_stride = (int)mat.step;
+            stbi_write_swap_rb = encode_swap_rb(params, mat.channels) ? 1 : 0;
+            stbi_write_png_compression_level = std::max(0, std::min(params.png_compression, 9));
+            stbi_write_force_png_filter = (params.png_filter >= 0 && params.png_filter <= 4) ? params.png_filter : -1;
+            stbi_write_tga_with_rle = params.tga_rle ? 1 : 0;
+        }
+        ~StbWriteOptionsScope()
+        {
+            stbi_write_png_compression_level = 8;
+            stbi_write_force_png_filter = -1;
+            stbi_write_tga_with_rle = 1;
+            stbi_write_row_stride = 0;
+            stbi_write_swap_rb = 0;
+        }
+    };
+
+    static bool encode_image_stb(EncodeFormat fmt, const Mat &mat, EncodeWriteFn write, void *ctx,
+                                 const ImwriteParams &params)
+    {
+        // PNM/PFM 不压缩，自己写（也接受 U16/F32）
+        if (fmt == EncodeFormat::PNM || fmt == EncodeFormat::PFM)
+            return detail::pnm_encode(mat, fmt == EncodeFormat::PFM, write, ctx, params);
+        // stb 写入只支持 8 位
+        if (mat.empty() || mat.depth != Depth::U8 || !write)
             return false;
+        if (fmt == EncodeFormat::PNG && params.png_mode != PngMode::STB)
+            return detail::png_encode(mat, write, ctx, params);
 
-        const std::string ext = file_ext_lower(filename);
+        // 各格式都按 mat.step 逐行读取（jpg/bmp/tga 经 stbi_write_row_stride），ROI/带 padding 的 Mat 无需先拷贝
+        EncodeSink sink{write, ctx};
+        StbWriteOptionsScope options(params, mat);
         int ok = 0;
+        switch (fmt)
+        {
+        case EncodeFormat::PNG:
+            // stride 是每行字节数
+            ok = stbi_write_png_to_func(stb_write_to_sink, &sink, mat.width, mat.height, mat.channels, mat.data,
+                                        mat.step);
+            break;
+        case EncodeFormat::JPEG:
+            // 注意：stb 写 jpg 会忽略 alpha
+            ok = stbi_write_jpg_to_func(stb_write_to_sink, &sink, mat.width, mat.height, mat.channels, mat.data,
+                                        std::max(1, std::min(params.jpeg_quality, 100)));
+            break;
+        case EncodeFormat::BMP:
+            ok = stbi_write_bmp_to_func(stb_write_to_sink, &sink, mat.width, mat.height, mat.channels, mat.data);
+            break;
+        case EncodeFormat::TGA:
+            ok = stbi_write_tga_to_func(stb_write_to_sink, &sink, mat.width, mat.height, mat.channels, mat.data);
+            break;
+        case EncodeFormat::PNM:
+        case EncodeFormat::PFM:
+            break;
+        }
+        return ok ? true : false;
+    }
+
+    // 记录后端是否已经写出过数据：写出后失败就不能再换后端重来
+    struct CountingSink
+    {
+        EncodeWriteFn write;
+        void *ctx;
+        size_t bytes;
+    };
+
+    static void write_counting(void *ctx, const void *data, size_t size)
+    {
+        auto *sink = reinterpret_cast<CountingSink *>(ctx);
+        sink->bytes += size;
+        sink->write(sink->ctx, data, size);
+    }
+
+    // 没有 stride 能力的后端收到的行必须紧密相连：显式分配 PACKED 的 Mat 逐行拷贝，不依赖源的 StepMode
+    static Mat pack_rows(const Mat &mat)
+    {
+        Mat out(mat.height, mat.width, mat.channels, mat.depth, StepMode::PACKED);
+        const size_t row = (size_t)mat.width * mat.elemSize();
+        for (int y = 0; y < mat.height; ++y)
+            std::memcpy(out.ptr(y), mat.ptr(y), row);
+        return out;
+    }
 
-        if (ext == "png")
+    // imwrite 与各个 imencode 共用：同样的格式选择与参数，只是输出目标不同
+    static bool encode_image(const std::string &ext, const Mat &mat, EncodeWriteFn write, void *ctx,
+                             const ImwriteParams &params)
+    {
+        std::string e = to_lower(ext);
+        if (!e.empty() && e[0] == '.')
+            e.erase(0, 1);
+        if (detail::has_external_codecs() && !mat.empty() && write)
         {
-            ok = stbi_write_png(filename.c_str(), mat.width, mat.height, mat.channels, mat.data, mat.step);
+            for (const std::shared_ptr<ImageCodec> &codec : detail::external_codecs())
+            {
+                const CodecCaps caps = codec->caps();
+                if (!caps.encode || !(mat.depth == Depth::U8 || (caps.bit16 && mat.depth == Depth::U16)) ||
+                    !codec->matchesExtension(e))
+                    continue;
+                const Mat packed = caps.stride || mat.isContinuous() ? Mat() : pack_rows(mat);
+                CountingSink sink{write, ctx, 0};
+                if (codec->encode(e, packed.empty() ? mat : packed, write_counting, &sink, params))
+                    return true;
+                if (sink.bytes > 0)
+                    return false;
+            }
         }
-        else if (ext == "jpg" || ext == "jpeg")
+        return encode_image_stb(encode_format(e), mat, write, ctx, params);
+    }
+
+    static bool encode_to_fixed_buffer(const std::string &ext, const Mat &mat, void *dst, size_t capacity, size_t *written,
+                                       const ImwriteParams &params)
+    {
+        FixedBuffer fb{static_cast<unsigned char *>(dst), dst ? capacity : 0, 0};
+        const bool ok = encode_image(ext, mat, write_to_fixed_buffer, &fb, params);
+        if (written)
+            *written = ok ? fb.total : 0;
+        return ok && fb.total <= fb.capacity;
+    }
+
+    // 默认用 PNG（无损、通用）
+    bool imencode(const Mat &mat, EncodeWriteFn write, void *ctx)
+    {
+        MemoryScope scope("imencode");
+        return encode_image("png", mat, write, ctx, ImwriteParams());
+    }
+
+    bool imencode(const Mat &mat, std::vector<unsigned char> &buf)
+    {
+        buf.clear();
+        return imencode(mat, write_to_vector, &buf);
+    }
+
+    bool imencode(const Mat &mat, void *dst, size_t capacity, size_t *written)
+    {
+        MemoryScope scope("imencode");
+        return encode_to_fixed_buffer("png", mat, dst, capacity, written, ImwriteParams());
+    }
+
+    bool imencode(const std::string &ext, const Mat &mat, std::vector<unsigned char> &buf, const ImwriteParams &params)
+    {
+        MemoryScope scope("imencode");
+        buf.clear();
+        return encode_image(ext, mat, write_to_vector, &buf, params);
+    }
+
+    bool imencode(const std::string &ext, const Mat &mat, EncodeWriteFn write, void *ctx, const ImwriteParams &params)
+    {
+        MemoryScope scope("imencode");
+        return encode_image(ext, mat, write, ctx, params);
+    }
+
+    bool imencode(const std::string &ext, const Mat &mat, void *dst, size_t capacity, size_t *written,
+                  const ImwriteParams &params)
+    {
+        MemoryScope scope("imencode");
+        return encode_to_fixed_buffer(ext, mat, dst, capacity, written, params);
+    }
+
+    // 有没有编码器接受这个 depth：U8 都行，PNM/PFM 自己写，U16 还可以交给声明了 bit16 的后端
+    static bool encode_depth_supported(const std::string &ext, const Mat &mat)
+    {
+        if (mat.depth == Depth::U8)
+            return true;
+        const EncodeFormat fmt = encode_format(ext);
+        if (fmt == EncodeFormat::PNM || fmt == EncodeFormat::PFM)
+            return true;
+        if (mat.depth != Depth::U16 || !detail::has_external_codecs())
+            return false;
+        for (const std::shared_ptr<ImageCodec> &codec : detail::external_codecs())
         {
-            // jpg 质量默认 95
-            // 注意：stb 写 jpg 不支持带 alpha；如果 channels==4 这里会失败/结果异常，通常要先转成 3 通道
-            ok = stbi_write_jpg(filename.c_str(), mat.width, mat.height, mat.channels, mat.data, 95);
+            const CodecCaps caps = codec->caps();
+            if (caps.encode && caps.bit16 && codec->matchesExtension(ext))
+                return true;
         }
-        else if (ext == "bmp")
+        return false;
+    }
+
+    bool imwrite(const std::string &filename, const Mat &mat, const ImwriteParams &params)
+    {
+        MemoryScope scope("imwrite");
+        const std::string ext = file_ext_lower(filename);
+        // 没有编码器接受时不打开文件，免得截断已有文件
+        if (mat.empty() || !encode_depth_supported(ext, mat))
+            return false;
+
+        // 先在内存里编码完再打开目标：编码失败不会截断已有文件；
+        // 直接写进 filename 本身（而不是改名覆盖），符号链接、权限、硬链接与 FIFO/设备都保持原来的语义
+        std::vector<unsigned char> bytes;
+        if (!encode_image(ext, mat, write_to_vector, &bytes, params))
+            return false;
+
+        FILE *f = stbiw__fopen(filename.c_str(), "wb");
+        if (!f)
+            return false;
+        bool ok = bytes.empty() || fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+        ok = fclose(f) == 0 && ok;
+        // 写到一半失败（如磁盘满）时不留下半截文件；只删普通文件，不碰符号链接、FIFO 与设备
+        std::error_code ec;
+        if (!ok && std::filesystem::symlink_status(filename, ec).type() == std::filesystem::file_type::regular)
+            std::remove(filename.c_str());
+        return ok;
+    }
+}
+
+namespace SimpleCV
+{
+    // 内置 stb 后端：getCodecs() 的最后一项，也是所有调用的兜底
+    class StbCodec : public ImageCodec
+    {
+    public:
+        const char *name() const override { return "stb"; }
+
+        CodecCaps caps() const override
         {
-            ok = stbi_write_bmp(filename.c_str(), mat.width, mat.height, mat.channels, mat.data);
+            CodecCaps c;
+            c.decode = c.encode = c.scaled_decode = c.stride = c.bit16 = true;
+            return c;
         }
-        else if (ext == "tga")
+
+        // 格式由 stb 自己探测；未知扩展名按 PNG 写
+        bool matchesMagic(const unsigned char *, std::size_t) const override { return true; }
+        bool matchesExtension(const std::string &) const override { return true; }
+
+        bool decode(ByteSpan buf, Mat &dst, const CodecDecodeOptions &opts) override
         {
-            ok = stbi_write_tga(filename.c_str(), mat.width, mat.height, mat.channels, mat.data);
+            const int shift = reduce_shift(opts.scale);
+            if (buf.empty() || buf.size > static_cast<size_t>(std::numeric_limits<int>::max()) || shift < 0)
+                return false;
+            StbSource src;
+            src.buf = buf.data;
+            src.len = static_cast<int>(buf.size);
+            if (shift == 0 || src.is_jpeg())
+            {
+                src.jpeg_shift = shift;
+                return decode_image_stb(src, opts.flag, opts.depth, dst);
+            }
+
+            Mat full;
+            if (!decode_image_stb(src, opts.flag, opts.depth, full))
+                return false;
+            resize(full, dst, (full.width + opts.scale - 1) / opts.scale, (full.height + opts.scale - 1) / opts.scale);
+            return !dst.empty();
         }
-        else
+
+        bool encode(const std::string &ext, const Mat &mat, EncodeWriteFn write, void *ctx,
+                    const ImwriteParams &params) override
         {
-            // 未知扩展名：默认写 png
-            ok = stbi_write_png(filename.c_str(), mat.width, mat.height, mat.channels, mat.data, mat.step);
+            return encode_image_stb(encode_format(ext), mat, write, ctx, params);
         }
+    };
 
-        return ok ? true : false;
+    std::shared_ptr<ImageCodec> detail::stb_codec()
+    {
+        static const std::shared_ptr<ImageCodec> codec = std::make_shared<StbCodec>();
+        return codec;
     }
 }
@@ -3,6 +3,41 @@
 
 namespace SimpleCV
 {
+    namespace detail
+    {
+        // 带统计的 malloc/realloc/free，供 stb 的 STBI_MALLOC 等宏使用（SimpleCV_Memory.cpp）
+        void *tracked_malloc(std::size_t bytes);
+        void *tracked_realloc(void *p, std::size_t bytes);
+        void tracked_free(void *p);
+
+        // 8 位缩放到 dst（尺寸不符时重新分配）：可选滤波器，swap_rb 时 3/4 通道在写输出时交换 R/B
+        // （stbir 的像素布局转换）；不设 MemoryScope，计入调用方（SimpleCV_Proc.cpp）
+        bool resize_u8(const Mat &src, Mat &dst, int dst_width, int dst_height, bool swap_rb, Interp interp);
+
+        // 一行 8 位交错像素拆成 c 个平面行，dst[k] 接收第 k 个通道；3/4 通道走 SSSE3/AVX2/NEON（SimpleCV_Planar.cpp）
+        void split_row_u8(const unsigned char *src, unsigned char *const *dst, int width, int c);
+
+        struct MatAccess
+        {
+            // 用 owner 托管的缓冲区装配 Mat（例如 stb 解码结果，由 owner 的 deleter 释放）
+            static void adopt(Mat &m, std::shared_ptr<unsigned char> owner,
+                              int h, int w, int c, Depth depth, int step)
+            {
+                m.release();
+                if (!owner || h <= 0 || w <= 0 || c <= 0)
+                    return;
+                m.owner_ = std::move(owner);
+                m.height = h;
+                m.width = w;
+                m.channels = c;
+                m.depth = depth;
+                m.step = step;
+                m.data = m.owner_.get();
+                m.update_data_bounds();
+            }
+        };
+    }
+
     static inline ColorSpace infer_space_from_channels(const Mat &m)
     {
         if (m.channels == 1)
@@ -42,7 +77,45 @@ namespace SimpleCV
         return s == ColorSpace::RGB || s == ColorSpace::RGBA;
     }
 
-    // 交换 R<->B（适用于 3/4 通道）
+    // 两个 Mat 的像素区域是否有重叠（ROI 视图可能与源共享同一块缓冲区）
+    static inline bool mats_overlap(const Mat &a, const Mat &b)
+    {
+        if (a.empty() || b.empty())
+            return false;
+        const unsigned char *a0 = a.data;
+        const unsigned char *a1 = a.data + (size_t)(a.height - 1) * (size_t)a.step + (size_t)a.width * (size_t)a.elemSize();
+        const unsigned char *b0 = b.data;
+        const unsigned char *b1 = b.data + (size_t)(b.height - 1) * (size_t)b.step + (size_t)b.width * (size_t)b.elemSize();
+        return a0 < b1 && b0 < a1;
+    }
+
+    // 调用方提供的 dst 能否直接复用（尺寸/通道/depth 一致且 stride 足够）
+    static inline bool dst_buffer_compatible(const Mat &dst, int h, int w, int c, Depth depth)
+    {
+        if (dst.empty())
+            return false;
+        if (dst.height != h || dst.width != w || dst.channels != c || dst.depth != depth)
+            return false;
+        const int min_step = w * dst.elemSize();
+        return dst.step >= min_step && dst.data != nullptr;
+    }
+
+    template <typename T>
+    static inline void swap_rb_rows(Mat &m)
+    {
+        const int c = m.channels;
+        for (int y = 0; y < m.height; ++y)
+        {
+            T *row = m.ptr<T>(y);
+            for (int x = 0; x < m.width; ++x)
+            {
+                T *p = row + (size_t)x * c;
+                std::swap(p[0], p[2]);
+            }
+        }
+    }
+
+    // 交换 R<->B（适用于 3/4 通道，任意 depth）
     static inline void swap_rb_inplace(Mat &m)
     {
         if (m.empty())
@@ -50,25 +123,25 @@ namespace SimpleCV
         if (m.channels != 3 && m.channels != 4)
             return;
 
-        for (int y = 0; y < m.height; ++y)
+        switch (m.elemSize1())
         {
-            unsigned char *row = m.data + y * m.step;
-            if (m.channels == 3)
-            {
-                for (int x = 0; x < m.width; ++x)
-                {
-                    unsigned char *p = row + x * 3;
-                    std::swap(p[0], p[2]);
-                }
-            }
-            else
-            {
-                for (int x = 0; x < m.width; ++x)
-                {
-                    unsigned char *p = row + x * 4;
-                    std::swap(p[0], p[2]);
-                }
-            }
+        case 1:
+            swap_rb_rows<std::uint8_t>(m);
+            break;
+        case 2:
+            swap_rb_rows<std::uint16_t>(m);
+            break;
+        case 4:
+            swap_rb_rows<std::uint32_t>(m);
+            break;
+        default:
+            break;
         }
     }
+
+    // 3/4 通道按 BGR(A) 存储时（ImwriteParams::src_space），编码器在取行时交换 R/B
+    static inline bool encode_swap_rb(const ImwriteParams &params, int channels)
+    {
+        return channels >= 3 && (params.src_space == ColorSpace::BGR || params.src_space == ColorSpace::BGRA);
+    }
 }
@@ -0,0 +1,161 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Common.hpp"
+#include "SimpleCV_Parallel.hpp"
+
+#include <atomic>
+#include <vector>
+
+namespace SimpleCV
+{
+    // 每个输出通道的线性变换：out = v * a + b，其中 a = scale/std，b = -mean/std
+    struct BlobTransform
+    {
+        int channels = 0;
+        int src_index[4] = {0, 1, 2, 3}; // 输出通道 k 取自输入通道 src_index[k]
+        float a[4] = {1, 1, 1, 1};
+        float b[4] = {0, 0, 0, 0};
+    };
+
+    static BlobTransform make_transform(int channels, const BlobParams &p)
+    {
+        BlobTransform t;
+        t.channels = channels;
+        if (p.swapRB && channels >= 3)
+        {
+            t.src_index[0] = 2;
+            t.src_index[2] = 0;
+        }
+        for (int k = 0; k < channels && k < 4; ++k)
+        {
+            const float sd = (p.std[k] != 0.0f) ? p.std[k] : 1.0f;
+            t.a[k] = p.scale / sd;
+            t.b[k] = -p.mean[k] / sd;
+        }
+        return t;
+    }
+
+    // U8：先用 split 的 SIMD 反交织把一行拆成各通道的连续行，
+    // 再逐个输出通道做 v * a + b——连续内存上的 u8 -> f32 乘加，编译器能向量化；通道交换只是换一个源平面
+    static void blob_u8(const Mat &img, float *dst, const BlobTransform &t)
+    {
+        const int c = t.channels;
+        const int w = img.width;
+        const size_t plane = (size_t)w * (size_t)img.height;
+
+        // 单通道本身就是连续的，不需要中转
+        std::vector<unsigned char> planar(c > 1 ? (size_t)c * (size_t)w : 0);
+        unsigned char *rows[4] = {nullptr, nullptr, nullptr, nullptr};
+        for (int k = 0; k < c && c > 1; ++k)
+            rows[k] = planar.data() + (size_t)k * (size_t)w;
+
+        for (int y = 0; y < img.height; ++y)
+        {
+            const unsigned char *sp = img.ptr(y);
+            if (c > 1)
+                detail::split_row_u8(sp, rows, w, c);
+
+            const size_t row_off = (size_t)y * (size_t)w;
+            for (int k = 0; k < c; ++k)
+            {
+                const unsigned char *p = c > 1 ? rows[t.src_index[k]] : sp;
+                const float a = t.a[k], b = t.b[k];
+                float *o = dst + (size_t)k * plane + row_off;
+                for (int x = 0; x < w; ++x)
+                    o[x] = (float)p[x] * a + b;
+            }
+        }
+    }
+
+    template <typename T>
+    static void blob_generic(const Mat &img, float *dst, const BlobTransform &t)
+    {
+        const int c = t.channels;
+        const size_t plane = (size_t)img.width * (size_t)img.height;
+        for (int y = 0; y < img.height; ++y)
+        {
+            const T *sp = img.ptr<T>(y);
+            const size_t row_off = (size_t)y * (size_t)img.width;
+            for (int k = 0; k < c; ++k)
+            {
+                const int ik = t.src_index[k];
+                const float a = t.a[k], b = t.b[k];
+                float *o = dst + (size_t)k * plane + row_off;
+                for (int x = 0; x < img.width; ++x)
+                    o[x] = (float)sp[x * c + ik] * a + b;
+            }
+        }
+    }
+
+    // 宽高都 > 0 才算指定了输出尺寸；只给一边时按未指定处理（不 resize）
+    static bool blob_size_set(const BlobParams &params)
+    {
+        return params.size.width > 0 && params.size.height > 0;
+    }
+
+    static bool blob_one(const Mat &input, float *dst, const BlobParams &params)
+    {
+        if (input.empty() || !dst || input.channels > 4)
+            return false;
+
+        // 尺寸不一致时先 resize（唯一的额外一遍）；否则直接从原图读
+        Mat resized;
+        const Mat *img = &input;
+        if (blob_size_set(params) && (params.size.width != input.width || params.size.height != input.height))
+        {
+            resize(input, resized, params.size.width, params.size.height);
+            if (resized.empty())
+                return false;
+            img = &resized;
+        }
+
+        const BlobTransform t = make_transform(img->channels, params);
+        switch (img->depth)
+        {
+        case Depth::U8:
+            blob_u8(*img, dst, t);
+            break;
+        case Depth::U16:
+            blob_generic<std::uint16_t>(*img, dst, t);
+            break;
+        case Depth::F16:
+            blob_generic<float16>(*img, dst, t);
+            break;
+        case Depth::F32:
+            blob_generic<float>(*img, dst, t);
+            break;
+        }
+        return true;
+    }
+
+    bool blobFromImage(const Mat &img, float *dst, const BlobParams &params)
+    {
+        return blob_one(img, dst, params);
+    }
+
+    bool blobFromImages(const std::vector<Mat> &imgs, float *dst, const BlobParams &params, int num_threads)
+    {
+        if (imgs.empty() || !dst)
+            return false;
+
+        // 所有图片输出尺寸必须一致（由 params.size 或第一张图决定）
+        const int c = imgs[0].channels;
+        const bool sized = blob_size_set(params);
+        const int w = sized ? params.size.width : imgs[0].width;
+        const int h = sized ? params.size.height : imgs[0].height;
+        for (const Mat &m : imgs)
+        {
+            if (m.empty() || m.channels != c)
+                return false;
+            if (!sized && (m.width != w || m.height != h))
+                return false;
+        }
+
+        const size_t per_image = (size_t)c * (size_t)w * (size_t)h;
+        std::atomic<bool> ok{true};
+        parallel_for((int)imgs.size(), num_threads, [&](int i)
+                     {
+            if (!blob_one(imgs[(size_t)i], dst + per_image * (size_t)i, params))
+                ok = false; });
+        return ok;
+    }
+}
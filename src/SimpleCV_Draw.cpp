@@ -95,7 +95,7 @@ namespace SimpleCV
 
     SIMPLECV_API void line(Mat &img, Point p0, Point p1, const Scalar &color, int thickness)
     {
-        if (img.empty() || thickness == 0)
+        if (img.empty() || img.depth != Depth::U8 || thickness == 0)
             return;
 
         if (thickness <= 1)
@@ -203,7 +203,7 @@ namespace SimpleCV
 
     SIMPLECV_API void circle(Mat &img, Point center, int radius, const Scalar &color, int thickness)
     {
-        if (img.empty() || radius <= 0 || thickness == 0)
+        if (img.empty() || img.depth != Depth::U8 || radius <= 0 || thickness == 0)
             return;
 
         if (thickness < 0)
@@ -229,7 +229,7 @@ namespace SimpleCV
     SIMPLECV_API void rectangle(Mat &img, Point pt1, Point pt2, const Scalar &color,
                                 int thickness, int /*lineType*/, int /*shift*/)
     {
-        if (img.empty() || thickness == 0)
+        if (img.empty() || img.depth != Depth::U8 || thickness == 0)
             return;
 
         int x0 = std::min(pt1.x, pt2.x);
@@ -0,0 +1,255 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Common.hpp"
+#include "SimpleCV_Registry.hpp"
+
+#include <climits>
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+// 系统 libjpeg（一般是 libjpeg-turbo，SIMD IDCT/颜色转换）作为 JPEG 后端；SIMPLECV_WITH_LIBJPEG=ON 且找到库时编译。
+// 错误经 longjmp 返回，所以 setjmp 之后的代码里不构造带析构的局部对象
+namespace SimpleCV
+{
+    namespace
+    {
+        struct ErrorMgr
+        {
+            jpeg_error_mgr pub;
+            std::jmp_buf jump;
+        };
+
+        void on_error(j_common_ptr cinfo)
+        {
+            std::longjmp(reinterpret_cast<ErrorMgr *>(cinfo->err)->jump, 1);
+        }
+
+        void on_message(j_common_ptr) {} // 不往 stderr 打警告
+
+        // 按 flag 选输出颜色空间；CMYK/YCCK 等交给 stb
+        bool output_space(J_COLOR_SPACE jpeg_space, ColorSpace flag, J_COLOR_SPACE &out, int &channels)
+        {
+            if (jpeg_space != JCS_GRAYSCALE && jpeg_space != JCS_YCbCr && jpeg_space != JCS_RGB)
+                return false;
+            switch (flag)
+            {
+            case ColorSpace::GRAY:
+                out = JCS_GRAYSCALE;
+                channels = 1;
+                return true;
+            case ColorSpace::RGB:
+                out = JCS_RGB;
+                channels = 3;
+                return true;
+#ifdef JCS_EXTENSIONS
+            case ColorSpace::BGR:
+                out = JCS_EXT_BGR;
+                channels = 3;
+                return true;
+            case ColorSpace::RGBA:
+                out = JCS_EXT_RGBX; // X 填 0xFF
+                channels = 4;
+                return true;
+            case ColorSpace::BGRA:
+                out = JCS_EXT_BGRX;
+                channels = 4;
+                return true;
+#endif
+            case ColorSpace::AUTO:
+            case ColorSpace::UNCHANGED:
+                out = jpeg_space == JCS_GRAYSCALE ? JCS_GRAYSCALE : JCS_RGB;
+                channels = jpeg_space == JCS_GRAYSCALE ? 1 : 3;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        bool jpeg_decode(ByteSpan buf, Mat &dst, const CodecDecodeOptions &opts)
+        {
+            jpeg_decompress_struct cinfo;
+            ErrorMgr err;
+            cinfo.err = jpeg_std_error(&err.pub);
+            err.pub.error_exit = on_error;
+            err.pub.output_message = on_message;
+            if (setjmp(err.jump))
+            {
+                jpeg_destroy_decompress(&cinfo);
+                return false;
+            }
+            jpeg_create_decompress(&cinfo);
+            jpeg_mem_src(&cinfo, buf.data, (unsigned long)buf.size);
+            jpeg_read_header(&cinfo, TRUE);
+
+            int channels = 0;
+            if (!output_space(cinfo.jpeg_color_space, opts.flag, cinfo.out_color_space, channels))
+            {
+                jpeg_destroy_decompress(&cinfo);
+                return false;
+            }
+            cinfo.scale_num = 1;
+            cinfo.scale_denom = (unsigned int)opts.scale;
+            jpeg_start_decompress(&cinfo);
+
+            // 直接按 dst.step 逐行解码进 dst
+            const int w = (int)cinfo.output_width, h = (int)cinfo.output_height;
+            if (!dst_buffer_compatible(dst, h, w, channels, Depth::U8))
+                dst.create(h, w, channels, Depth::U8);
+            while (cinfo.output_scanline < cinfo.output_height)
+            {
+                JSAMPROW row = dst.data + (size_t)cinfo.output_scanline * (size_t)dst.step;
+                jpeg_read_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_decompress(&cinfo);
+            jpeg_destroy_decompress(&cinfo);
+            return true;
+        }
+
+        // 压缩输出攒满 64KB 交给 EncodeWriteFn
+        struct DestMgr
+        {
+            jpeg_destination_mgr pub;
+            EncodeWriteFn write;
+            void *ctx;
+            JOCTET buf[1 << 16];
+        };
+
+        void init_destination(j_compress_ptr cinfo)
+        {
+            DestMgr *d = reinterpret_cast<DestMgr *>(cinfo->dest);
+            d->pub.next_output_byte = d->buf;
+            d->pub.free_in_buffer = sizeof(d->buf);
+        }
+
+        boolean empty_output_buffer(j_compress_ptr cinfo)
+        {
+            DestMgr *d = reinterpret_cast<DestMgr *>(cinfo->dest);
+            d->write(d->ctx, d->buf, sizeof(d->buf));
+            d->pub.next_output_byte = d->buf;
+            d->pub.free_in_buffer = sizeof(d->buf);
+            return TRUE;
+        }
+
+        void term_destination(j_compress_ptr cinfo)
+        {
+            DestMgr *d = reinterpret_cast<DestMgr *>(cinfo->dest);
+            const size_t n = sizeof(d->buf) - d->pub.free_in_buffer;
+            if (n)
+                d->write(d->ctx, d->buf, n);
+        }
+
+        bool jpeg_encode(const Mat &mat, J_COLOR_SPACE in_space, EncodeWriteFn write, void *ctx, int quality,
+                         DestMgr &dest)
+        {
+            jpeg_compress_struct cinfo;
+            ErrorMgr err;
+            cinfo.err = jpeg_std_error(&err.pub);
+            err.pub.error_exit = on_error;
+            err.pub.output_message = on_message;
+            if (setjmp(err.jump))
+            {
+                jpeg_destroy_compress(&cinfo);
+                return false;
+            }
+            jpeg_create_compress(&cinfo);
+            dest.pub.init_destination = init_destination;
+            dest.pub.empty_output_buffer = empty_output_buffer;
+            dest.pub.term_destination = term_destination;
+            dest.write = write;
+            dest.ctx = ctx;
+            cinfo.dest = &dest.pub;
+
+            cinfo.image_width = (JDIMENSION)mat.width;
+            cinfo.image_height = (JDIMENSION)mat.height;
+            cinfo.input_components = mat.channels;
+            cinfo.in_color_space = in_space;
+            jpeg_set_defaults(&cinfo);
+            jpeg_set_quality(&cinfo, quality, TRUE);
+            // 与 stb 一致：质量 > 90 时色度不下采样
+            if (quality > 90 && cinfo.num_components == 3)
+                cinfo.comp_info[0].h_samp_factor = cinfo.comp_info[0].v_samp_factor = 1;
+            jpeg_start_compress(&cinfo, TRUE);
+            while (cinfo.next_scanline < cinfo.image_height)
+            {
+                JSAMPROW row = mat.data + (size_t)cinfo.next_scanline * (size_t)mat.step;
+                jpeg_write_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_compress(&cinfo);
+            jpeg_destroy_compress(&cinfo);
+            return true;
+        }
+
+        class LibJpegCodec : public ImageCodec
+        {
+        public:
+            const char *name() const override { return "libjpeg"; }
+
+            CodecCaps caps() const override
+            {
+                CodecCaps c;
+                c.decode = c.encode = c.scaled_decode = c.stride = true;
+                return c;
+            }
+
+            bool matchesMagic(const unsigned char *head, std::size_t n) const override
+            {
+                return n >= 3 && head[0] == 0xFF && head[1] == 0xD8 && head[2] == 0xFF;
+            }
+
+            bool matchesExtension(const std::string &ext) const override
+            {
+                return ext == "jpg" || ext == "jpeg";
+            }
+
+            bool decode(ByteSpan buf, Mat &dst, const CodecDecodeOptions &opts) override
+            {
+                if (opts.depth != Depth::U8 || buf.empty() || buf.size > ULONG_MAX)
+                    return false;
+                if (opts.scale != 1 && opts.scale != 2 && opts.scale != 4 && opts.scale != 8)
+                    return false;
+                return jpeg_decode(buf, dst, opts);
+            }
+
+            bool encode(const std::string &, const Mat &mat, EncodeWriteFn write, void *ctx,
+                        const ImwriteParams &params) override
+            {
+                if (mat.empty() || mat.depth != Depth::U8)
+                    return false;
+                const bool bgr = encode_swap_rb(params, mat.channels);
+                J_COLOR_SPACE in_space;
+                switch (mat.channels)
+                {
+                case 1:
+                    in_space = JCS_GRAYSCALE;
+                    break;
+                case 3:
+                    in_space = JCS_RGB;
+#ifdef JCS_EXTENSIONS
+                    if (bgr)
+                        in_space = JCS_EXT_BGR;
+#endif
+                    break;
+#ifdef JCS_EXTENSIONS
+                case 4: // 与 stb 一样忽略 alpha
+                    in_space = bgr ? JCS_EXT_BGRX : JCS_EXT_RGBX;
+                    break;
+#endif
+                default:
+                    return false;
+                }
+#ifndef JCS_EXTENSIONS
+                if (bgr)
+                    return false;
+#endif
+                std::unique_ptr<DestMgr> dest(new DestMgr());
+                return jpeg_encode(mat, in_space, write, ctx, std::max(1, std::min(params.jpeg_quality, 100)), *dest);
+            }
+        };
+    }
+
+    std::shared_ptr<ImageCodec> detail::make_libjpeg_codec()
+    {
+        return std::make_shared<LibJpegCodec>();
+    }
+}
@@ -0,0 +1,212 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Common.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+
+namespace SimpleCV
+{
+    namespace
+    {
+        // 0 号固定为未打标签的分配，最后一个槽位收容超出上限的 site
+        const int kMaxSites = 64;
+        const int kDefaultSite = 0;
+        const int kOverflowSite = kMaxSites - 1;
+
+        struct SiteCounters
+        {
+            std::atomic<std::uint64_t> allocations{0};
+            std::atomic<std::uint64_t> deallocations{0};
+            std::atomic<std::uint64_t> total_bytes{0};
+            std::atomic<std::size_t> live_bytes{0};
+            std::atomic<std::size_t> peak_bytes{0};
+        };
+
+        struct MemoryRegistry
+        {
+            std::mutex mtx; // 只串行化新 site 的注册与快照
+            // 只追加：names[i] 写好后才发布 count，查找时无锁读取已发布的部分
+            std::string names[kMaxSites];
+            std::atomic<int> count{1};
+            SiteCounters sites[kMaxSites];
+
+            std::atomic<std::size_t> live_bytes{0};
+            std::atomic<std::size_t> peak_bytes{0};
+            std::atomic<std::uint64_t> allocations{0};
+            std::atomic<std::uint64_t> deallocations{0};
+
+            MemoryRegistry()
+            {
+                names[kDefaultSite] = "Mat::create";
+                names[kOverflowSite] = "other";
+            }
+        };
+
+        MemoryRegistry &registry()
+        {
+            // 故意泄漏：静态对象析构期间释放的 Mat 仍会回调这里
+            static MemoryRegistry *r = new MemoryRegistry();
+            return *r;
+        }
+
+        inline void atomic_max(std::atomic<std::size_t> &a, std::size_t v)
+        {
+            std::size_t cur = a.load(std::memory_order_relaxed);
+            while (cur < v && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        thread_local int t_memory_site = kDefaultSite;
+
+        // tracked_malloc 在用户指针前放一个头，记录大小与 site，free/realloc 时取回
+        struct TrackedHeader
+        {
+            std::size_t bytes;
+            int site;
+        };
+        const std::size_t kHeaderSize = 16;
+        static_assert(sizeof(TrackedHeader) <= kHeaderSize, "tracked header too large");
+    }
+
+    namespace detail
+    {
+        static int memorySiteId(const char *name)
+        {
+            if (!name || !*name)
+                return kDefaultSite;
+            MemoryRegistry &r = registry();
+            const int n = r.count.load(std::memory_order_acquire);
+            for (int i = 0; i < n; ++i)
+                if (r.names[i] == name)
+                    return i;
+
+            // 未命中才加锁；其间可能已被别的线程注册，从上次看到的位置接着查
+            std::lock_guard<std::mutex> lk(r.mtx);
+            const int cur = r.count.load(std::memory_order_relaxed);
+            for (int i = n; i < cur; ++i)
+                if (r.names[i] == name)
+                    return i;
+            if (cur >= kOverflowSite)
+                return kOverflowSite;
+            r.names[cur] = name;
+            r.count.store(cur + 1, std::memory_order_release);
+            return cur;
+        }
+
+        int memoryOnAlloc(std::size_t bytes)
+        {
+            const int site = t_memory_site;
+            MemoryRegistry &r = registry();
+            SiteCounters &s = r.sites[site];
+            s.allocations.fetch_add(1, std::memory_order_relaxed);
+            s.total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            atomic_max(s.peak_bytes, s.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+            r.allocations.fetch_add(1, std::memory_order_relaxed);
+            atomic_max(r.peak_bytes, r.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+            return site;
+        }
+
+        void memoryOnFree(int site, std::size_t bytes)
+        {
+            MemoryRegistry &r = registry();
+            SiteCounters &s = r.sites[site];
+            s.deallocations.fetch_add(1, std::memory_order_relaxed);
+            s.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+            r.deallocations.fetch_add(1, std::memory_order_relaxed);
+            r.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        void *tracked_malloc(std::size_t bytes)
+        {
+            unsigned char *base = static_cast<unsigned char *>(std::malloc(bytes + kHeaderSize));
+            if (!base)
+                return nullptr;
+            TrackedHeader *hdr = reinterpret_cast<TrackedHeader *>(base);
+            hdr->bytes = bytes;
+            hdr->site = memoryOnAlloc(bytes);
+            return base + kHeaderSize;
+        }
+
+        void *tracked_realloc(void *p, std::size_t bytes)
+        {
+            if (!p)
+                return tracked_malloc(bytes);
+            unsigned char *base = static_cast<unsigned char *>(p) - kHeaderSize;
+            const TrackedHeader old = *reinterpret_cast<TrackedHeader *>(base);
+            unsigned char *nb = static_cast<unsigned char *>(std::realloc(base, bytes + kHeaderSize));
+            if (!nb)
+                return nullptr;
+            // 按一次释放 + 一次分配记账，新块归到当前 site
+            memoryOnFree(old.site, old.bytes);
+            TrackedHeader *hdr = reinterpret_cast<TrackedHeader *>(nb);
+            hdr->bytes = bytes;
+            hdr->site = memoryOnAlloc(bytes);
+            return nb + kHeaderSize;
+        }
+
+        void tracked_free(void *p)
+        {
+            if (!p)
+                return;
+            unsigned char *base = static_cast<unsigned char *>(p) - kHeaderSize;
+            const TrackedHeader *hdr = reinterpret_cast<const TrackedHeader *>(base);
+            memoryOnFree(hdr->site, hdr->bytes);
+            std::free(base);
+        }
+    }
+
+    MemoryScope::MemoryScope(const char *name)
+        : prev_(t_memory_site)
+    {
+        t_memory_site = detail::memorySiteId(name);
+    }
+
+    MemoryScope::~MemoryScope()
+    {
+        t_memory_site = prev_;
+    }
+
+    MemorySnapshot getMemorySnapshot()
+    {
+        MemoryRegistry &r = registry();
+        MemorySnapshot snap;
+        snap.live_bytes = r.live_bytes.load(std::memory_order_relaxed);
+        snap.peak_bytes = r.peak_bytes.load(std::memory_order_relaxed);
+        snap.allocations = r.allocations.load(std::memory_order_relaxed);
+        snap.deallocations = r.deallocations.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lk(r.mtx);
+        const int count = r.count.load(std::memory_order_relaxed);
+        for (int i = 0; i < kMaxSites; ++i)
+        {
+            if (i >= count && i != kOverflowSite)
+                continue;
+            const SiteCounters &s = r.sites[i];
+            MemorySiteStats st;
+            st.allocations = s.allocations.load(std::memory_order_relaxed);
+            if (st.allocations == 0)
+                continue;
+            st.site = r.names[i];
+            st.deallocations = s.deallocations.load(std::memory_order_relaxed);
+            st.total_bytes = s.total_bytes.load(std::memory_order_relaxed);
+            st.live_bytes = s.live_bytes.load(std::memory_order_relaxed);
+            st.peak_bytes = s.peak_bytes.load(std::memory_order_relaxed);
+            snap.sites.push_back(std::move(st));
+        }
+        std::sort(snap.sites.begin(), snap.sites.end(), [](const MemorySiteStats &a, const MemorySiteStats &b)
+                  { return a.live_bytes != b.live_bytes ? a.live_bytes > b.live_bytes : a.peak_bytes > b.peak_bytes; });
+        return snap;
+    }
+
+    void resetMemoryPeak()
+    {
+        MemoryRegistry &r = registry();
+        r.peak_bytes.store(r.live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        for (SiteCounters &s : r.sites)
+            s.peak_bytes.store(s.live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
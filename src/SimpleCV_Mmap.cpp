@@ -0,0 +1,408 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Pnm.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#if defined(_WIN32) || defined(_WIN64)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SimpleCV
+{
+    // 一段文件映射；最后一个引用它的 Mat 释放时解除映射
+    class MappedFile
+    {
+    public:
+        unsigned char *base = nullptr;
+        std::size_t size = 0;
+
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+#if defined(_WIN32) || defined(_WIN64)
+            if (base)
+                UnmapViewOfFile(base);
+            if (mapping_)
+                CloseHandle(mapping_);
+            if (file_ != INVALID_HANDLE_VALUE)
+                CloseHandle(file_);
+#else
+            if (base)
+                munmap(base, size);
+#endif
+        }
+
+        // create_size > 0：新建/截断文件并扩展到 create_size，以共享可写方式映射
+        // 否则映射已有文件：writable 为共享可写；只读时用私有写时复制映射，
+        // 对 Mat 的写入不会落到文件，也不会因页面只读而崩溃
+        bool open(const std::string &filename, bool writable, std::size_t create_size)
+        {
+            const bool create = create_size > 0;
+#if defined(_WIN32) || defined(_WIN64)
+            const DWORD access = (writable || create) ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+            const DWORD disposition = create ? CREATE_ALWAYS : OPEN_EXISTING;
+            file_ = CreateFileA(filename.c_str(), access, FILE_SHARE_READ, nullptr, disposition,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE)
+                return false;
+
+            if (create)
+            {
+                size = create_size;
+            }
+            else
+            {
+                LARGE_INTEGER li;
+                if (!GetFileSizeEx(file_, &li) || li.QuadPart <= 0)
+                    return false;
+                size = static_cast<std::size_t>(li.QuadPart);
+            }
+
+            const bool shared_rw = writable || create;
+            const unsigned long long sz = static_cast<unsigned long long>(size);
+            mapping_ = CreateFileMappingA(file_, nullptr, shared_rw ? PAGE_READWRITE : PAGE_WRITECOPY,
+                                          static_cast<DWORD>(sz >> 32), static_cast<DWORD>(sz & 0xffffffffu), nullptr);
+            if (!mapping_)
+                return false;
+            base = static_cast<unsigned char *>(MapViewOfFile(mapping_, shared_rw ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, size));
+            return base != nullptr;
+#else
+            const int flags = (writable || create) ? O_RDWR : O_RDONLY;
+            const int fd = create ? ::open(filename.c_str(), flags | O_CREAT | O_TRUNC, 0644)
+                                  : ::open(filename.c_str(), flags);
+            if (fd < 0)
+                return false;
+
+            if (create)
+            {
+                if (ftruncate(fd, static_cast<off_t>(create_size)) != 0)
+                {
+                    ::close(fd);
+                    return false;
+                }
+                size = create_size;
+            }
+            else
+            {
+                struct stat st;
+                if (fstat(fd, &st) != 0 || st.st_size <= 0)
+                {
+                    ::close(fd);
+                    return false;
+                }
+                size = static_cast<std::size_t>(st.st_size);
+            }
+
+            const bool shared_rw = writable || create;
+            void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, shared_rw ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+            ::close(fd); // 映射建立后 fd 可以关闭
+            if (p == MAP_FAILED)
+                return false;
+            base = static_cast<unsigned char *>(p);
+            return true;
+#endif
+        }
+
+    private:
+#if defined(_WIN32) || defined(_WIN64)
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+#endif
+    };
+
+    // 比这更多的通道数不像是图像，多半是读错了 shape
+    static const int kMaxMappedChannels = 512;
+
+    // 一幅图在映射中占的字节数（不含文件头）；step 为 0 时取紧密行宽。
+    // 每个乘积都先检查溢出（32 位 size_t 上 (1, 65536, 65536) 这样的 shape 会绕回很小的值），
+    // 行宽还要放得进 Mat::step（int）
+    static bool mapped_layout(int h, int w, int c, Depth depth, std::size_t &step, std::size_t &bytes)
+    {
+        if (h <= 0 || w <= 0 || c <= 0 || c > kMaxMappedChannels)
+            return false;
+        const std::size_t int_max = static_cast<std::size_t>(std::numeric_limits<int>::max());
+        const std::size_t elem = static_cast<std::size_t>(c) * depthSize(depth);
+        if (static_cast<std::size_t>(w) > int_max / elem)
+            return false;
+        const std::size_t min_step = static_cast<std::size_t>(w) * elem;
+        if (step == 0)
+            step = min_step;
+        if (step < min_step || step > int_max)
+            return false;
+        const std::size_t rows = static_cast<std::size_t>(h - 1);
+        if (rows > (SIZE_MAX - min_step) / step)
+            return false;
+        bytes = step * rows + min_step;
+        return true;
+    }
+
+    // 新建文件的总大小：文件头 + 紧密排列的像素
+    static bool mapped_file_size(std::size_t header_bytes, int h, int w, int c, Depth depth, std::size_t &total)
+    {
+        std::size_t step = 0, bytes = 0;
+        if (!mapped_layout(h, w, c, depth, step, bytes) || bytes > SIZE_MAX - header_bytes)
+            return false;
+        total = header_bytes + bytes;
+        return true;
+    }
+
+    // 从映射中切出 Mat，映射的生命周期挂在 Mat 的引用计数上
+    static Mat mat_from_mapping(const std::shared_ptr<MappedFile> &mf, std::size_t offset,
+                                int h, int w, int c, Depth depth, std::size_t step)
+    {
+        std::size_t bytes = 0;
+        if (!mapped_layout(h, w, c, depth, step, bytes) || offset > mf->size || bytes > mf->size - offset)
+            return Mat();
+        return Mat(h, w, c, depth, mf->base + offset, step, std::shared_ptr<void>(mf));
+    }
+
+    static std::shared_ptr<MappedFile> map_file(const std::string &filename, bool writable, std::size_t create_size = 0)
+    {
+        auto mf = std::make_shared<MappedFile>();
+        if (!mf->open(filename, writable, create_size))
+            return nullptr;
+        return mf;
+    }
+
+    // ===== PNM =====
+    Mat mapPNM(const std::string &filename, bool writable)
+    {
+        auto mf = map_file(filename, writable);
+        if (!mf)
+            return Mat();
+        PnmHeader hdr;
+        if (!parse_pnm_header(mf->base, mf->size, hdr))
+            return Mat();
+        // 16 位 PNM 是大端样本，不能原样当作本机 uint16 使用
+        if (hdr.maxval > 255)
+            return Mat();
+        return mat_from_mapping(mf, hdr.data_offset, hdr.height, hdr.width, hdr.channels, Depth::U8, 0);
+    }
+
+    Mat createMappedPNM(const std::string &filename, int h, int w, int c)
+    {
+        if (h <= 0 || w <= 0 || (c != 1 && c != 3))
+            return Mat();
+        const std::string header = make_pnm_header(w, h, c, 255);
+        std::size_t total = 0;
+        if (!mapped_file_size(header.size(), h, w, c, Depth::U8, total))
+            return Mat();
+        auto mf = map_file(filename, true, total);
+        if (!mf)
+            return Mat();
+        std::memcpy(mf->base, header.data(), header.size());
+        return mat_from_mapping(mf, header.size(), h, w, c, Depth::U8, 0);
+    }
+
+    // ===== NPY =====
+    // 只接受 C 顺序、本机小端的 u1/u2/f2/f4，shape 为 (h, w) 或 (h, w, c)
+    static bool npy_descr_to_depth(const std::string &descr, Depth &depth)
+    {
+        if (descr == "|u1" || descr == "<u1")
+            depth = Depth::U8;
+        else if (descr == "<u2")
+            depth = Depth::U16;
+        else if (descr == "<f2")
+            depth = Depth::F16;
+        else if (descr == "<f4")
+            depth = Depth::F32;
+        else
+            return false;
+        return true;
+    }
+
+    static const char *npy_depth_descr(Depth depth)
+    {
+        switch (depth)
+        {
+        case Depth::U16:
+            return "<u2";
+        case Depth::F16:
+            return "<f2";
+        case Depth::F32:
+            return "<f4";
+        case Depth::U8:
+        default:
+            return "|u1";
+        }
+    }
+
+    // 取 dict 中 'key': 之后的值文本起点
+    static std::size_t npy_find_value(const std::string &dict, const char *key)
+    {
+        const std::string k1 = std::string("'") + key + "'";
+        std::size_t p = dict.find(k1);
+        if (p == std::string::npos)
+            return std::string::npos;
+        p = dict.find(':', p + k1.size());
+        if (p == std::string::npos)
+            return std::string::npos;
+        ++p;
+        while (p < dict.size() && dict[p] == ' ')
+            ++p;
+        return p;
+    }
+
+    static bool parse_npy_header(const unsigned char *p, std::size_t n, int &h, int &w, int &c,
+                                 Depth &depth, std::size_t &data_offset)
+    {
+        if (n < 10 || std::memcmp(p, "\x93NUMPY", 6) != 0)
+            return false;
+        const int major = p[6];
+        std::size_t header_len = 0, pos = 0;
+        if (major == 1)
+        {
+            header_len = static_cast<std::size_t>(p[8]) | (static_cast<std::size_t>(p[9]) << 8);
+            pos = 10;
+        }
+        else if (major == 2 || major == 3)
+        {
+            if (n < 12)
+                return false;
+            header_len = static_cast<std::size_t>(p[8]) | (static_cast<std::size_t>(p[9]) << 8) |
+                         (static_cast<std::size_t>(p[10]) << 16) | (static_cast<std::size_t>(p[11]) << 24);
+            pos = 12;
+        }
+        else
+        {
+            return false;
+        }
+        if (pos + header_len > n)
+            return false;
+        const std::string dict(reinterpret_cast<const char *>(p + pos), header_len);
+        data_offset = pos + header_len;
+
+        std::size_t v = npy_find_value(dict, "descr");
+        if (v == std::string::npos || v >= dict.size() || dict[v] != '\'')
+            return false;
+        const std::size_t v_end = dict.find('\'', v + 1);
+        if (v_end == std::string::npos || !npy_descr_to_depth(dict.substr(v + 1, v_end - v - 1), depth))
+            return false;
+
+        v = npy_find_value(dict, "fortran_order");
+        if (v == std::string::npos || dict.compare(v, 5, "False") != 0)
+            return false;
+
+        v = npy_find_value(dict, "shape");
+        if (v == std::string::npos || v >= dict.size() || dict[v] != '(')
+            return false;
+        const std::size_t s_end = dict.find(')', v);
+        if (s_end == std::string::npos)
+            return false;
+        long long dims[3] = {0, 0, 0};
+        int nd = 0;
+        std::size_t i = v + 1;
+        while (i < s_end)
+        {
+            while (i < s_end && (dict[i] == ' ' || dict[i] == ','))
+                ++i;
+            if (i >= s_end)
+                break;
+            if (dict[i] < '0' || dict[i] > '9' || nd >= 3)
+                return false;
+            long long d = 0;
+            while (i < s_end && dict[i] >= '0' && dict[i] <= '9')
+            {
+                d = d * 10 + (dict[i] - '0');
+                if (d > 0x7fffffffLL)
+                    return false;
+                ++i;
+            }
+            dims[nd++] = d;
+        }
+        if (nd < 2)
+            return false;
+        h = static_cast<int>(dims[0]);
+        w = static_cast<int>(dims[1]);
+        c = nd == 3 ? static_cast<int>(dims[2]) : 1;
+        return true;
+    }
+
+    static std::string make_npy_header(int h, int w, int c, Depth depth)
+    {
+        std::string dict = std::string("{'descr': '") + npy_depth_descr(depth) + "', 'fortran_order': False, 'shape': (" +
+                           std::to_string(h) + ", " + std::to_string(w) + (c > 1 ? ", " + std::to_string(c) : std::string()) + "), }";
+        // 版本 1.0：magic(6) + ver(2) + len(2) + dict，总长补齐到 64（像素数据与 cache line 对齐）
+        std::size_t total = 10 + dict.size() + 1;
+        const std::size_t padded = (total + 63) / 64 * 64;
+        dict.append(padded - total, ' ');
+        dict.push_back('\n');
+        const std::size_t len = dict.size();
+
+        std::string out("\x93NUMPY\x01\x00", 8);
+        out.push_back(static_cast<char>(len & 0xff));
+        out.push_back(static_cast<char>((len >> 8) & 0xff));
+        out += dict;
+        return out;
+    }
+
+    Mat mapNpy(const std::string &filename, bool writable)
+    {
+        if (!host_is_little_endian())
+            return Mat();
+        auto mf = map_file(filename, writable);
+        if (!mf)
+            return Mat();
+        int h = 0, w = 0, c = 0;
+        Depth depth = Depth::U8;
+        std::size_t offset = 0;
+        if (!parse_npy_header(mf->base, mf->size, h, w, c, depth, offset))
+            return Mat();
+        return mat_from_mapping(mf, offset, h, w, c, depth, 0);
+    }
+
+    Mat createMappedNpy(const std::string &filename, int h, int w, int c, Depth depth)
+    {
+        if (!host_is_little_endian() || h <= 0 || w <= 0 || c <= 0)
+            return Mat();
+        const std::string header = make_npy_header(h, w, c, depth);
+        if (header.size() > 65535 + 10)
+            return Mat();
+        std::size_t total = 0;
+        if (!mapped_file_size(header.size(), h, w, c, depth, total))
+            return Mat();
+        auto mf = map_file(filename, true, total);
+        if (!mf)
+            return Mat();
+        std::memcpy(mf->base, header.data(), header.size());
+        return mat_from_mapping(mf, header.size(), h, w, c, depth, 0);
+    }
+
+    // ===== RAW =====
+    Mat mapRaw(const std::string &filename, int h, int w, int c, Depth depth,
+               std::size_t header_bytes, std::size_t step, bool writable)
+    {
+        auto mf = map_file(filename, writable);
+        if (!mf)
+            return Mat();
+        return mat_from_mapping(mf, header_bytes, h, w, c, depth, step);
+    }
+
+    Mat createMappedRaw(const std::string &filename, int h, int w, int c, Depth depth,
+                        std::size_t header_bytes)
+    {
+        if (h <= 0 || w <= 0 || c <= 0)
+            return Mat();
+        std::size_t total = 0;
+        if (!mapped_file_size(header_bytes, h, w, c, depth, total))
+            return Mat();
+        auto mf = map_file(filename, true, total);
+        if (!mf)
+            return Mat();
+        return mat_from_mapping(mf, header_bytes, h, w, c, depth, 0);
+    }
+}
@@ -0,0 +1,118 @@
+#include "SimpleCV_Parallel.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace SimpleCV
+{
+    namespace
+    {
+        // 一次 parallel_run：调用线程与最多 slots 个工作线程按原子计数领取下标
+        struct Job
+        {
+            void (*fn)(void *, int);
+            void *ctx;
+            int n;
+            std::atomic<int> next{0};
+            int slots = 0;  // 还能加入的工作线程数
+            int active = 0; // 已加入、尚未做完的工作线程数
+            std::atomic<bool> failed{false};
+            std::exception_ptr error; // 第一个异常，等工作线程都退出后由调用线程重新抛出
+
+            // 不向外抛：异常记下后把剩余下标一并领完，其它线程随之停下
+            void run()
+            {
+                try
+                {
+                    for (int i = next.fetch_add(1); i < n; i = next.fetch_add(1))
+                        fn(ctx, i);
+                }
+                catch (...)
+                {
+                    if (!failed.exchange(true))
+                        error = std::current_exception();
+                    next.store(n);
+                }
+            }
+        };
+
+        class ThreadPool
+        {
+        public:
+            void run(int n, int num_threads, void (*fn)(void *, int), void *ctx)
+            {
+                Job job;
+                job.fn = fn;
+                job.ctx = ctx;
+                job.n = n;
+                job.slots = num_threads - 1;
+                {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    while ((int)threads_.size() < job.slots)
+                        threads_.emplace_back([this]()
+                                              { worker(); });
+                    jobs_.push_back(&job);
+                }
+                work_.notify_all();
+
+                job.run();
+
+                // 下标领完后撤下任务，再等已加入的工作线程做完手上那一项
+                std::unique_lock<std::mutex> lk(mtx_);
+                for (auto it = jobs_.begin(); it != jobs_.end(); ++it)
+                    if (*it == &job)
+                    {
+                        jobs_.erase(it);
+                        break;
+                    }
+                done_.wait(lk, [&]()
+                           { return job.active == 0; });
+                lk.unlock();
+                if (job.error)
+                    std::rethrow_exception(job.error);
+            }
+
+        private:
+            void worker()
+            {
+                std::unique_lock<std::mutex> lk(mtx_);
+                for (;;)
+                {
+                    work_.wait(lk, [&]()
+                               { return !jobs_.empty(); });
+                    Job *job = jobs_.front();
+                    ++job->active;
+                    if (--job->slots == 0)
+                        jobs_.pop_front();
+                    lk.unlock();
+                    job->run();
+                    lk.lock();
+                    if (--job->active == 0)
+                        done_.notify_all();
+                }
+            }
+
+            std::mutex mtx_;
+            std::condition_variable work_; // 有任务可加入
+            std::condition_variable done_; // 某个任务的工作线程都已做完
+            std::deque<Job *> jobs_;
+            std::vector<std::thread> threads_;
+        };
+
+        ThreadPool &pool()
+        {
+            // 故意泄漏：工作线程常驻到进程退出，不在静态析构阶段 join
+            static ThreadPool *p = new ThreadPool();
+            return *p;
+        }
+    }
+
+    void detail::parallel_run(int n, int num_threads, void (*fn)(void *ctx, int i), void *ctx)
+    {
+        pool().run(n, num_threads, fn, ctx);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+
+namespace SimpleCV
+{
+    // num_threads <= 0 时取硬件线程数
+    static inline int resolve_num_threads(int num_threads, int n)
+    {
+        if (num_threads <= 0)
+        {
+            num_threads = (int)std::thread::hardware_concurrency();
+            if (num_threads <= 0)
+                num_threads = 1;
+        }
+        return std::max(1, std::min(num_threads, n));
+    }
+
+    namespace detail
+    {
+        // 进程级线程池（SimpleCV_Parallel.cpp）：首次使用时创建，工作线程常驻，按需要的并发数补足。
+        // 调用线程也参与执行，fn(ctx, i) 对 [0, n) 各执行一次，全部完成后返回。
+        // fn 抛出异常时不再领取新的下标，等已开始的各项结束后在调用线程重新抛出第一个异常
+        void parallel_run(int n, int num_threads, void (*fn)(void *ctx, int i), void *ctx);
+    }
+
+    // 把 [0, n) 分给若干线程执行 fn(i)；按原子计数领取任务，负载不均时也能跑满。
+    // 工作线程来自常驻线程池，反复调用（例如按轮次并行）不会反复创建线程
+    template <typename Fn>
+    static inline void parallel_for(int n, int num_threads, Fn &&fn)
+    {
+        if (n <= 0)
+            return;
+        num_threads = resolve_num_threads(num_threads, n);
+        if (num_threads == 1)
+        {
+            for (int i = 0; i < n; ++i)
+                fn(i);
+            return;
+        }
+
+        using F = typename std::remove_reference<Fn>::type;
+        detail::parallel_run(n, num_threads, [](void *ctx, int i)
+                             { (*static_cast<F *>(ctx))(i); },
+                             const_cast<void *>(static_cast<const void *>(&fn)));
+    }
+}
@@ -0,0 +1,522 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Common.hpp"
+
+#include <cstring>
+#include <vector>
+
+// x86 上用 GCC/Clang 的 target 属性编译 SSSE3/AVX2 版本，运行时按 CPU 选择；
+// ARM 上 NEON 是基线指令集，直接使用。其他情况（含 MSVC）走标量实现
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLECV_PLANAR_X86 1
+#include <immintrin.h>
+#define SIMPLECV_TARGET(isa) __attribute__((target(isa)))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMPLECV_PLANAR_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace SimpleCV
+{
+    // ===== 标量实现（任意通道数，元素 1/2/4 字节）=====
+    template <typename T>
+    static void split_row_scalar(const unsigned char *src, unsigned char *const *dst, int x0, int width, int c)
+    {
+        const T *s = reinterpret_cast<const T *>(src);
+        for (int k = 0; k < c; ++k)
+        {
+            T *d = reinterpret_cast<T *>(dst[k]);
+            for (int x = x0; x < width; ++x)
+                d[x] = s[(size_t)x * c + k];
+        }
+    }
+
+    template <typename T>
+    static void merge_row_scalar(const unsigned char *const *src, unsigned char *dst, int x0, int width, int c)
+    {
+        T *d = reinterpret_cast<T *>(dst);
+        for (int k = 0; k < c; ++k)
+        {
+            const T *s = reinterpret_cast<const T *>(src[k]);
+            for (int x = x0; x < width; ++x)
+                d[(size_t)x * c + k] = s[x];
+        }
+    }
+
+#if defined(SIMPLECV_PLANAR_X86)
+    // pshufb 掩码：16 个像素为一组，交错数据占 C 个 16 字节寄存器
+    // deint[ch][r]：从第 r 个交错寄存器取通道 ch 的字节放到像素序号处，其余置 0
+    // inter[r][ch]：从通道 ch 的平面寄存器取字节，拼出第 r 个交错寄存器
+    template <int C>
+    struct ShuffleMasks
+    {
+        alignas(16) unsigned char deint[C][C][16];
+        alignas(16) unsigned char inter[C][C][16];
+
+        ShuffleMasks()
+        {
+            for (int ch = 0; ch < C; ++ch)
+                for (int r = 0; r < C; ++r)
+                    for (int i = 0; i < 16; ++i)
+                    {
+                        const int k = C * i + ch;
+                        deint[ch][r][i] = (unsigned char)(k / 16 == r ? k % 16 : 0x80);
+                    }
+            for (int r = 0; r < C; ++r)
+                for (int ch = 0; ch < C; ++ch)
+                    for (int j = 0; j < 16; ++j)
+                    {
+                        const int k = 16 * r + j;
+                        inter[r][ch][j] = (unsigned char)(k % C == ch ? k / C : 0x80);
+                    }
+        }
+    };
+
+    template <int C>
+    static const ShuffleMasks<C> &shuffle_masks()
+    {
+        static const ShuffleMasks<C> m;
+        return m;
+    }
+
+    template <int C>
+    SIMPLECV_TARGET("ssse3")
+    static int split_u8_ssse3(const unsigned char *s, unsigned char *const *d, int x, int width)
+    {
+        const ShuffleMasks<C> &m = shuffle_masks<C>();
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i v[C];
+            for (int r = 0; r < C; ++r)
+                v[r] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + (size_t)x * C + 16 * r));
+            for (int ch = 0; ch < C; ++ch)
+            {
+                __m128i acc = _mm_shuffle_epi8(v[0], _mm_load_si128(reinterpret_cast<const __m128i *>(m.deint[ch][0])));
+                for (int r = 1; r < C; ++r)
+                    acc = _mm_or_si128(acc, _mm_shuffle_epi8(v[r], _mm_load_si128(reinterpret_cast<const __m128i *>(m.deint[ch][r]))));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(d[ch] + x), acc);
+            }
+        }
+        return x;
+    }
+
+    template <int C>
+    SIMPLECV_TARGET("ssse3")
+    static int merge_u8_ssse3(const unsigned char *const *s, unsigned char *d, int x, int width)
+    {
+        const ShuffleMasks<C> &m = shuffle_masks<C>();
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i p[C];
+            for (int ch = 0; ch < C; ++ch)
+                p[ch] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s[ch] + x));
+            for (int r = 0; r < C; ++r)
+            {
+                __m128i acc = _mm_shuffle_epi8(p[0], _mm_load_si128(reinterpret_cast<const __m128i *>(m.inter[r][0])));
+                for (int ch = 1; ch < C; ++ch)
+                    acc = _mm_or_si128(acc, _mm_shuffle_epi8(p[ch], _mm_load_si128(reinterpret_cast<const __m128i *>(m.inter[r][ch]))));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(d + (size_t)x * C + 16 * r), acc);
+            }
+        }
+        return x;
+    }
+
+    // AVX2 的 vpshufb 只在 128 位 lane 内工作：把相邻两组 16 像素分别放进低/高 lane，
+    // 沿用同一套掩码，平面侧正好是连续的 32 个像素
+    template <int C>
+    SIMPLECV_TARGET("avx2")
+    static int split_u8_avx2(const unsigned char *s, unsigned char *const *d, int x, int width)
+    {
+        const ShuffleMasks<C> &m = shuffle_masks<C>();
+        __m256i mask[C][C];
+        for (int ch = 0; ch < C; ++ch)
+            for (int r = 0; r < C; ++r)
+                mask[ch][r] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(m.deint[ch][r])));
+
+        for (; x + 32 <= width; x += 32)
+        {
+            const unsigned char *lo = s + (size_t)x * C;
+            const unsigned char *hi = lo + 16 * C;
+            __m256i v[C];
+            for (int r = 0; r < C; ++r)
+                v[r] = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo + 16 * r))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi + 16 * r)), 1);
+            for (int ch = 0; ch < C; ++ch)
+            {
+                __m256i acc = _mm256_shuffle_epi8(v[0], mask[ch][0]);
+                for (int r = 1; r < C; ++r)
+                    acc = _mm256_or_si256(acc, _mm256_shuffle_epi8(v[r], mask[ch][r]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(d[ch] + x), acc);
+            }
+        }
+        return x;
+    }
+
+    template <int C>
+    SIMPLECV_TARGET("avx2")
+    static int merge_u8_avx2(const unsigned char *const *s, unsigned char *d, int x, int width)
+    {
+        const ShuffleMasks<C> &m = shuffle_masks<C>();
+        __m256i mask[C][C];
+        for (int r = 0; r < C; ++r)
+            for (int ch = 0; ch < C; ++ch)
+                mask[r][ch] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(m.inter[r][ch])));
+
+        for (; x + 32 <= width; x += 32)
+        {
+            unsigned char *lo = d + (size_t)x * C;
+            unsigned char *hi = lo + 16 * C;
+            __m256i p[C];
+            for (int ch = 0; ch < C; ++ch)
+                p[ch] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s[ch] + x));
+            for (int r = 0; r < C; ++r)
+            {
+                __m256i acc = _mm256_shuffle_epi8(p[0], mask[r][0]);
+                for (int ch = 1; ch < C; ++ch)
+                    acc = _mm256_or_si256(acc, _mm256_shuffle_epi8(p[ch], mask[r][ch]));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(lo + 16 * r), _mm256_castsi256_si128(acc));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(hi + 16 * r), _mm256_extracti128_si256(acc, 1));
+            }
+        }
+        return x;
+    }
+
+    enum SimdLevel
+    {
+        SIMD_NONE = 0,
+        SIMD_SSSE3,
+        SIMD_AVX2
+    };
+
+    static int simd_level()
+    {
+        static const int level = []()
+        {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return (int)SIMD_AVX2;
+            if (__builtin_cpu_supports("ssse3"))
+                return (int)SIMD_SSSE3;
+            return (int)SIMD_NONE;
+        }();
+        return level;
+    }
+
+    // 返回已处理的像素数，剩余部分由标量代码收尾
+    template <int C>
+    static int split_u8_simd(const unsigned char *s, unsigned char *const *d, int width)
+    {
+        int x = 0;
+        const int level = simd_level();
+        if (level >= SIMD_AVX2)
+            x = split_u8_avx2<C>(s, d, x, width);
+        if (level >= SIMD_SSSE3)
+            x = split_u8_ssse3<C>(s, d, x, width);
+        return x;
+    }
+
+    template <int C>
+    static int merge_u8_simd(const unsigned char *const *s, unsigned char *d, int width)
+    {
+        int x = 0;
+        const int level = simd_level();
+        if (level >= SIMD_AVX2)
+            x = merge_u8_avx2<C>(s, d, x, width);
+        if (level >= SIMD_SSSE3)
+            x = merge_u8_ssse3<C>(s, d, x, width);
+        return x;
+    }
+#elif defined(SIMPLECV_PLANAR_NEON)
+    template <int C>
+    static int split_u8_simd(const unsigned char *s, unsigned char *const *d, int width)
+    {
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            if (C == 3)
+            {
+                uint8x16x3_t v = vld3q_u8(s + (size_t)x * 3);
+                vst1q_u8(d[0] + x, v.val[0]);
+                vst1q_u8(d[1] + x, v.val[1]);
+                vst1q_u8(d[2] + x, v.val[2]);
+            }
+            else
+            {
+                uint8x16x4_t v = vld4q_u8(s + (size_t)x * 4);
+                vst1q_u8(d[0] + x, v.val[0]);
+                vst1q_u8(d[1] + x, v.val[1]);
+                vst1q_u8(d[2] + x, v.val[2]);
+                vst1q_u8(d[3] + x, v.val[3]);
+            }
+        }
+        return x;
+    }
+
+    template <int C>
+    static int merge_u8_simd(const unsigned char *const *s, unsigned char *d, int width)
+    {
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            if (C == 3)
+            {
+                uint8x16x3_t v;
+                v.val[0] = vld1q_u8(s[0] + x);
+                v.val[1] = vld1q_u8(s[1] + x);
+                v.val[2] = vld1q_u8(s[2] + x);
+                vst3q_u8(d + (size_t)x * 3, v);
+            }
+            else
+            {
+                uint8x16x4_t v;
+                v.val[0] = vld1q_u8(s[0] + x);
+                v.val[1] = vld1q_u8(s[1] + x);
+                v.val[2] = vld1q_u8(s[2] + x);
+                v.val[3] = vld1q_u8(s[3] + x);
+                vst4q_u8(d + (size_t)x * 4, v);
+            }
+        }
+        return x;
+    }
+#else
+    template <int C>
+    static int split_u8_simd(const unsigned char *, unsigned char *const *, int)
+    {
+        return 0;
+    }
+
+    template <int C>
+    static int merge_u8_simd(const unsigned char *const *, unsigned char *, int)
+    {
+        return 0;
+    }
+#endif
+
+    // 一行交错像素 -> c 个平面行；dst[k] 接收第 k 个通道
+    static void split_row(const unsigned char *src, unsigned char *const *dst, int width, int c, size_t esz)
+    {
+        int x = 0;
+        if (esz == 1 && c == 3)
+            x = split_u8_simd<3>(src, dst, width);
+        else if (esz == 1 && c == 4)
+            x = split_u8_simd<4>(src, dst, width);
+        if (x >= width)
+            return;
+
+        switch (esz)
+        {
+        case 1:
+            split_row_scalar<std::uint8_t>(src, dst, x, width, c);
+            break;
+        case 2:
+            split_row_scalar<std::uint16_t>(src, dst, x, width, c);
+            break;
+        case 4:
+            split_row_scalar<std::uint32_t>(src, dst, x, width, c);
+            break;
+        default:
+            break;
+        }
+    }
+
+    namespace detail
+    {
+        void split_row_u8(const unsigned char *src, unsigned char *const *dst, int width, int c)
+        {
+            split_row(src, dst, width, c, 1);
+        }
+    }
+
+    static void merge_row(const unsigned char *const *src, unsigned char *dst, int width, int c, size_t esz)
+    {
+        int x = 0;
+        if (esz == 1 && c == 3)
+            x = merge_u8_simd<3>(src, dst, width);
+        else if (esz == 1 && c == 4)
+            x = merge_u8_simd<4>(src, dst, width);
+        if (x >= width)
+            return;
+
+        switch (esz)
+        {
+        case 1:
+            merge_row_scalar<std::uint8_t>(src, dst, x, width, c);
+            break;
+        case 2:
+            merge_row_scalar<std::uint16_t>(src, dst, x, width, c);
+            break;
+        case 4:
+            merge_row_scalar<std::uint32_t>(src, dst, x, width, c);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 平面尺寸/depth 不符或与 src 重叠时重新分配，否则复用调用方给的缓冲区（可以是同一块 CHW 内存上的 ROI 视图）
+    static void ensure_planes(std::vector<Mat> &planes, size_t n, const Mat &src)
+    {
+        planes.resize(n);
+        for (Mat &p : planes)
+        {
+            if (mats_overlap(p, src) || !dst_buffer_compatible(p, src.height, src.width, 1, src.depth))
+                p.create(src.height, src.width, 1, src.depth, src.stepMode());
+        }
+    }
+
+    static void fill_alpha_row(unsigned char *row, int width, Depth depth)
+    {
+        switch (depth)
+        {
+        case Depth::U8:
+            std::memset(row, 255, (size_t)width);
+            break;
+        case Depth::U16:
+            std::memset(row, 0xff, (size_t)width * 2);
+            break;
+        case Depth::F16:
+        {
+            const std::uint16_t one = float16(1.0f).bits;
+            std::uint16_t *p = reinterpret_cast<std::uint16_t *>(row);
+            for (int x = 0; x < width; ++x)
+                p[x] = one;
+            break;
+        }
+        case Depth::F32:
+        {
+            float *p = reinterpret_cast<float *>(row);
+            for (int x = 0; x < width; ++x)
+                p[x] = 1.0f;
+            break;
+        }
+        }
+    }
+
+    void split(const Mat &src, std::vector<Mat> &planes)
+    {
+        MemoryScope scope("split");
+        if (src.empty())
+        {
+            planes.clear();
+            return;
+        }
+
+        const int c = src.channels;
+        ensure_planes(planes, (size_t)c, src);
+
+        const size_t esz = src.elemSize1();
+        std::vector<unsigned char *> rows((size_t)c);
+        for (int y = 0; y < src.height; ++y)
+        {
+            for (int k = 0; k < c; ++k)
+                rows[k] = planes[k].ptr(y);
+            split_row(src.ptr(y), rows.data(), src.width, c, esz);
+        }
+    }
+
+    void merge(const std::vector<Mat> &planes, Mat &dst)
+    {
+        MemoryScope scope("merge");
+        if (planes.empty() || planes[0].empty())
+        {
+            dst.release();
+            return;
+        }
+
+        const Mat &p0 = planes[0];
+        bool overlap = false;
+        for (const Mat &p : planes)
+        {
+            if (p.empty() || p.channels != 1 || p.height != p0.height || p.width != p0.width || p.depth != p0.depth)
+            {
+                dst.release();
+                return;
+            }
+            overlap = overlap || mats_overlap(p, dst);
+        }
+
+        const int c = (int)planes.size();
+        if (overlap || !dst_buffer_compatible(dst, p0.height, p0.width, c, p0.depth))
+            dst.create(p0.height, p0.width, c, p0.depth, p0.stepMode());
+
+        const size_t esz = p0.elemSize1();
+        std::vector<const unsigned char *> rows((size_t)c);
+        for (int y = 0; y < p0.height; ++y)
+        {
+            for (int k = 0; k < c; ++k)
+                rows[k] = planes[k].ptr(y);
+            merge_row(rows.data(), dst.ptr(y), p0.width, c, esz);
+        }
+    }
+
+    void cvtColor(const Mat &src, std::vector<Mat> &planes, ColorSpace dst_space, ColorSpace src_space)
+    {
+        MemoryScope scope("cvtColor");
+        if (src.empty())
+        {
+            planes.clear();
+            return;
+        }
+
+        if (src_space == ColorSpace::AUTO || src_space == ColorSpace::UNCHANGED)
+            src_space = infer_space_from_channels(src);
+        if (dst_space == ColorSpace::AUTO || dst_space == ColorSpace::UNCHANGED)
+        {
+            split(src, planes);
+            return;
+        }
+
+        const int dst_ch = desired_channels(dst_space);
+        if (dst_ch == 0 || desired_channels(src_space) != src.channels)
+        {
+            planes.clear();
+            return;
+        }
+
+        // 灰度输出本身就是单平面
+        if (dst_space == ColorSpace::GRAY)
+        {
+            planes.resize(1);
+            cvtColor(src, planes[0], ColorSpace::GRAY, src_space);
+            return;
+        }
+
+        ensure_planes(planes, (size_t)dst_ch, src);
+        const size_t row_bytes = (size_t)src.width * src.elemSize1();
+
+        if (src_space == ColorSpace::GRAY)
+        {
+            for (int y = 0; y < src.height; ++y)
+            {
+                for (int k = 0; k < 3; ++k)
+                    std::memcpy(planes[k].ptr(y), src.ptr(y), row_bytes);
+                if (dst_ch == 4)
+                    fill_alpha_row(planes[3].ptr(y), src.width, src.depth);
+            }
+            return;
+        }
+
+        // 彩色 -> 彩色：通道重排 + 丢弃/补 alpha 都折进一次 split
+        // dst_of[s]：源通道 s 写到哪个平面，-1 表示丢弃（写进临时行）
+        const bool same_order = is_bgr_family(src_space) == is_bgr_family(dst_space);
+        int dst_of[4] = {same_order ? 0 : 2, 1, same_order ? 2 : 0, -1};
+        if (src.channels == 4 && dst_ch == 4)
+            dst_of[3] = 3;
+        const bool fill_alpha = dst_ch == 4 && src.channels == 3;
+
+        std::vector<unsigned char> scratch;
+        if (src.channels == 4 && dst_ch == 3)
+            scratch.resize(row_bytes);
+
+        unsigned char *rows[4] = {nullptr, nullptr, nullptr, nullptr};
+        const size_t esz = src.elemSize1();
+        for (int y = 0; y < src.height; ++y)
+        {
+            for (int s = 0; s < src.channels; ++s)
+                rows[s] = dst_of[s] >= 0 ? planes[dst_of[s]].ptr(y) : scratch.data();
+            split_row(src.ptr(y), rows, src.width, src.channels, esz);
+            if (fill_alpha)
+                fill_alpha_row(planes[3].ptr(y), src.width, src.depth);
+        }
+    }
+}
@@ -0,0 +1,911 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Common.hpp"
+#include "SimpleCV_Png.hpp"
+#include "SimpleCV_Parallel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Adler-32 在 x86 上有 SSSE3 版本（GCC/Clang target 属性 + 运行时检测），其他情况走标量
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLECV_PNG_X86 1
+#include <immintrin.h>
+#endif
+
+namespace SimpleCV
+{
+    namespace
+    {
+        // ===== CRC-32（slicing-by-8，每次查 8 张表处理 8 字节）=====
+        struct Crc32Tables
+        {
+            std::uint32_t t[8][256];
+
+            Crc32Tables()
+            {
+                for (std::uint32_t i = 0; i < 256; ++i)
+                {
+                    std::uint32_t c = i;
+                    for (int k = 0; k < 8; ++k)
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    t[0][i] = c;
+                }
+                for (int i = 0; i < 256; ++i)
+                    for (int s = 1; s < 8; ++s)
+                        t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+            }
+        };
+
+        const Crc32Tables &crc_tables()
+        {
+            static const Crc32Tables tables;
+            return tables;
+        }
+
+        inline std::uint32_t load_le32(const unsigned char *p)
+        {
+            return (std::uint32_t)p[0] | ((std::uint32_t)p[1] << 8) | ((std::uint32_t)p[2] << 16) |
+                   ((std::uint32_t)p[3] << 24);
+        }
+
+        std::uint32_t crc32_update(std::uint32_t crc, const unsigned char *p, size_t n)
+        {
+            const Crc32Tables &T = crc_tables();
+            crc = ~crc;
+            for (; n >= 8; p += 8, n -= 8)
+            {
+                const std::uint32_t lo = load_le32(p) ^ crc;
+                const std::uint32_t hi = load_le32(p + 4);
+                crc = T.t[7][lo & 0xFF] ^ T.t[6][(lo >> 8) & 0xFF] ^ T.t[5][(lo >> 16) & 0xFF] ^ T.t[4][lo >> 24] ^
+                      T.t[3][hi & 0xFF] ^ T.t[2][(hi >> 8) & 0xFF] ^ T.t[1][(hi >> 16) & 0xFF] ^ T.t[0][hi >> 24];
+            }
+            while (n--)
+                crc = T.t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        // ===== Adler-32 =====
+        const std::uint32_t kAdlerBase = 65521;
+        const size_t kAdlerNmax = 5552; // s2 在 uint32 内不溢出的最大连续字节数
+
+        std::uint32_t adler32_scalar(std::uint32_t adler, const unsigned char *p, size_t n)
+        {
+            std::uint32_t s1 = adler & 0xFFFF, s2 = adler >> 16;
+            while (n > 0)
+            {
+                size_t k = std::min(n, kAdlerNmax);
+                n -= k;
+                for (; k >= 8; k -= 8, p += 8)
+                {
+                    s1 += p[0]; s2 += s1;
+                    s1 += p[1]; s2 += s1;
+                    s1 += p[2]; s2 += s1;
+                    s1 += p[3]; s2 += s1;
+                    s1 += p[4]; s2 += s1;
+                    s1 += p[5]; s2 += s1;
+                    s1 += p[6]; s2 += s1;
+                    s1 += p[7]; s2 += s1;
+                }
+                while (k--)
+                {
+                    s1 += *p++;
+                    s2 += s1;
+                }
+                s1 %= kAdlerBase;
+                s2 %= kAdlerBase;
+            }
+            return (s2 << 16) | s1;
+        }
+
+#if defined(SIMPLECV_PNG_X86)
+        // 每 32 字节：psadbw 累加 s1，pmaddubsw 按权重 32..1 累加 s2；
+        // 块内每一步 s2 还要加上此前的 s1，用 v_ps 记下各步开始时的 s1，最后乘 32 补上
+        __attribute__((target("ssse3"))) std::uint32_t adler32_ssse3(std::uint32_t adler, const unsigned char *p,
+                                                                     size_t n)
+        {
+            std::uint32_t s1 = adler & 0xFFFF, s2 = adler >> 16;
+            size_t blocks = n / 32;
+            n -= blocks * 32;
+
+            const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+            const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i ones = _mm_set1_epi16(1);
+
+            while (blocks > 0)
+            {
+                size_t k = std::min(blocks, kAdlerNmax / 32);
+                blocks -= k;
+
+                __m128i v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * k));
+                __m128i v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+                __m128i v_s1 = zero;
+                do
+                {
+                    const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                    const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+                    v_ps = _mm_add_epi32(v_ps, v_s1);
+                    v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b1, zero));
+                    v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+                    v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b2, zero));
+                    v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+                    p += 32;
+                } while (--k);
+                v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+                alignas(16) std::uint32_t a1[4], a2[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(a1), v_s1);
+                _mm_store_si128(reinterpret_cast<__m128i *>(a2), v_s2);
+                s1 += a1[0] + a1[1] + a1[2] + a1[3];
+                s2 = a2[0] + a2[1] + a2[2] + a2[3];
+                s1 %= kAdlerBase;
+                s2 %= kAdlerBase;
+            }
+            return adler32_scalar((s2 << 16) | s1, p, n);
+        }
+
+        bool cpu_has_ssse3()
+        {
+            static const bool has = []()
+            {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("ssse3") != 0;
+            }();
+            return has;
+        }
+#endif
+
+        std::uint32_t adler32_update(std::uint32_t adler, const unsigned char *p, size_t n)
+        {
+#if defined(SIMPLECV_PNG_X86)
+            if (cpu_has_ssse3())
+                return adler32_ssse3(adler, p, n);
+#endif
+            return adler32_scalar(adler, p, n);
+        }
+
+        // 拼接两段数据的 Adler-32：adler2 是后一段（长度 len2）单独从 1 开始算出的值
+        std::uint32_t adler32_combine(std::uint32_t adler1, std::uint32_t adler2, size_t len2)
+        {
+            const std::uint32_t kBase = 65521;
+            const std::uint32_t rem = (std::uint32_t)(len2 % kBase);
+            std::uint32_t sum1 = adler1 & 0xFFFF;
+            std::uint32_t sum2 = (std::uint32_t)(((std::uint64_t)rem * sum1) % kBase);
+            sum1 += (adler2 & 0xFFFF) + kBase - 1;
+            sum2 += (adler1 >> 16) + (adler2 >> 16) + kBase - rem;
+            if (sum1 >= kBase)
+                sum1 -= kBase;
+            if (sum1 >= kBase)
+                sum1 -= kBase;
+            if (sum2 >= (kBase << 1))
+                sum2 -= (kBase << 1);
+            if (sum2 >= kBase)
+                sum2 -= kBase;
+            return sum1 | (sum2 << 16);
+        }
+
+        // ===== 位输出（deflate 按 LSB 优先打包）=====
+        struct BitWriter
+        {
+            std::vector<unsigned char> out;
+            size_t pos = 0;
+            std::uint64_t bits = 0;
+            int count = 0;
+
+            void reserve(size_t bytes)
+            {
+                if (out.size() < pos + bytes + 16)
+                    out.resize(std::max(out.size() * 2, pos + bytes + 16));
+            }
+
+            // n <= 32；调用方先 reserve
+            void put(std::uint32_t v, int n)
+            {
+                bits |= (std::uint64_t)v << count;
+                count += n;
+                if (count >= 32)
+                {
+                    out[pos] = (unsigned char)bits;
+                    out[pos + 1] = (unsigned char)(bits >> 8);
+                    out[pos + 2] = (unsigned char)(bits >> 16);
+                    out[pos + 3] = (unsigned char)(bits >> 24);
+                    pos += 4;
+                    bits >>= 32;
+                    count -= 32;
+                }
+            }
+
+            // 写出完整的字节，最多留下 7 位
+            void flush_bytes()
+            {
+                while (count >= 8)
+                {
+                    out[pos++] = (unsigned char)bits;
+                    bits >>= 8;
+                    count -= 8;
+                }
+            }
+
+            void align()
+            {
+                flush_bytes();
+                if (count > 0)
+                    out[pos++] = (unsigned char)bits;
+                bits = 0;
+                count = 0;
+            }
+
+            void bytes(const unsigned char *p, size_t n)
+            {
+                std::memcpy(out.data() + pos, p, n);
+                pos += n;
+            }
+        };
+
+        // ===== deflate 码表 =====
+        const std::uint16_t kLenBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        const std::uint8_t kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                            2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        const std::uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                             193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+                                             16385, 24577};
+        const std::uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                             6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        // 码长码的传输顺序
+        const std::uint8_t kClOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        const int kWindow = 32768;
+        const int kMinMatch = 4;
+        const int kMaxMatch = 258;
+
+        struct CodeTables
+        {
+            std::uint8_t len_code[kMaxMatch + 1];
+            std::uint8_t dist_code[512]; // 距离-1 < 256 直接查，否则查 256 + ((距离-1) >> 7)
+
+            CodeTables()
+            {
+                for (int c = 0; c < 29; ++c)
+                    for (int l = kLenBase[c]; l < kLenBase[c] + (1 << kLenExtra[c]) && l <= kMaxMatch; ++l)
+                        len_code[l] = (std::uint8_t)c;
+                len_code[kMaxMatch] = 28;
+                for (int c = 0; c < 30; ++c)
+                    for (int d = kDistBase[c] - 1; d < kDistBase[c] - 1 + (1 << kDistExtra[c]); ++d)
+                    {
+                        if (d < 256)
+                            dist_code[d] = (std::uint8_t)c;
+                        else
+                            dist_code[256 + (d >> 7)] = (std::uint8_t)c;
+                    }
+            }
+
+            int dist(int d) const
+            {
+                --d;
+                return d < 256 ? dist_code[d] : dist_code[256 + (d >> 7)];
+            }
+        };
+
+        const CodeTables &code_tables()
+        {
+            static const CodeTables tables;
+            return tables;
+        }
+
+        // 限长 Huffman：最长码超过 max_bits 时把频率减半后重建（对压缩率影响很小）
+        void huffman_lengths(const std::uint32_t *freq, int n, int max_bits, std::uint8_t *lens)
+        {
+            std::uint32_t f[286];
+            std::copy(freq, freq + n, f);
+            for (;;)
+            {
+                std::fill(lens, lens + n, (std::uint8_t)0);
+                int sym[286], m = 0;
+                for (int i = 0; i < n; ++i)
+                    if (f[i])
+                        sym[m++] = i;
+                if (m == 0)
+                    return;
+                if (m == 1)
+                {
+                    lens[sym[0]] = 1;
+                    return;
+                }
+                std::sort(sym, sym + m, [&](int a, int b)
+                          { return f[a] != f[b] ? f[a] < f[b] : a < b; });
+
+                // 双队列建树：叶子按权重排好序，内部节点按生成顺序天然有序
+                std::uint32_t w[2 * 286];
+                int parent[2 * 286];
+                for (int i = 0; i < m; ++i)
+                    w[i] = f[sym[i]];
+                int leaf = 0, inner = m, next = m;
+                for (; next < 2 * m - 1; ++next)
+                {
+                    int pick[2];
+                    for (int &pk : pick)
+                    {
+                        if (leaf < m && (inner >= next || w[leaf] <= w[inner]))
+                            pk = leaf++;
+                        else
+                            pk = inner++;
+                    }
+                    w[next] = w[pick[0]] + w[pick[1]];
+                    parent[pick[0]] = parent[pick[1]] = next;
+                }
+
+                // 父节点编号总比子节点大，倒序一遍即可得到深度
+                int depth[2 * 286];
+                depth[2 * m - 2] = 0;
+                int max_depth = 0;
+                for (int i = 2 * m - 3; i >= 0; --i)
+                {
+                    depth[i] = depth[parent[i]] + 1;
+                    if (i < m)
+                        max_depth = std::max(max_depth, depth[i]);
+                }
+                if (max_depth <= max_bits)
+                {
+                    for (int i = 0; i < m; ++i)
+                        lens[sym[i]] = (std::uint8_t)depth[i];
+                    return;
+                }
+                for (int i = 0; i < n; ++i)
+                    f[i] = f[i] ? (f[i] + 1) / 2 : 0;
+            }
+        }
+
+        // 规范 Huffman 码，按位反转后可以直接 LSB 优先写出
+        void huffman_codes(const std::uint8_t *lens, int n, std::uint16_t *codes)
+        {
+            int bl_count[16] = {0};
+            for (int i = 0; i < n; ++i)
+                bl_count[lens[i]]++;
+            bl_count[0] = 0;
+            int next_code[16] = {0};
+            int code = 0;
+            for (int b = 1; b < 16; ++b)
+            {
+                code = (code + bl_count[b - 1]) << 1;
+                next_code[b] = code;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                const int len = lens[i];
+                if (!len)
+                    continue;
+                int c = next_code[len]++, r = 0;
+                for (int k = 0; k < len; ++k, c >>= 1)
+                    r = (r << 1) | (c & 1);
+                codes[i] = (std::uint16_t)r;
+            }
+        }
+
+        // 至少两个码字：单码字的码长码表会被 zlib 视为不完整
+        void ensure_two_symbols(std::uint32_t *freq, int n)
+        {
+            int used = 0;
+            for (int i = 0; i < n && used < 2; ++i)
+                used += freq[i] != 0;
+            for (int i = 0; i < n && used < 2; ++i)
+                if (!freq[i])
+                {
+                    freq[i] = 1;
+                    ++used;
+                }
+        }
+
+        // 一段字面量后跟一个匹配；字面量直接取自输入数据，len == 0 表示只有字面量（块尾）
+        struct Seq
+        {
+            std::uint32_t literals;
+            std::uint16_t len;
+            std::uint16_t dist;
+        };
+
+        // 写出时用的局部位游标：成员都在寄存器里，不会因为按字节写缓冲区而被反复读回
+        struct BitCursor
+        {
+            unsigned char *p;
+            std::uint64_t bits;
+            int count;
+
+            explicit BitCursor(BitWriter &bw) : p(bw.out.data() + bw.pos), bits(bw.bits), count(bw.count) {}
+
+            void put(std::uint32_t v, int n)
+            {
+                bits |= (std::uint64_t)v << count;
+                count += n;
+                if (count >= 32)
+                {
+                    p[0] = (unsigned char)bits;
+                    p[1] = (unsigned char)(bits >> 8);
+                    p[2] = (unsigned char)(bits >> 16);
+                    p[3] = (unsigned char)(bits >> 24);
+                    p += 4;
+                    bits >>= 32;
+                    count -= 32;
+                }
+            }
+
+            void commit(BitWriter &bw) const
+            {
+                bw.pos = (size_t)(p - bw.out.data());
+                bw.bits = bits;
+                bw.count = count;
+            }
+        };
+
+        void write_stored(BitWriter &bw, const unsigned char *raw, size_t n, bool final)
+        {
+            do
+            {
+                const size_t k = std::min(n, (size_t)65535);
+                bw.reserve(k + 8);
+                bw.put((final && k == n) ? 1 : 0, 3); // BTYPE = 00
+                bw.align();
+                bw.put((std::uint32_t)k | ((std::uint32_t)(~k & 0xFFFF) << 16), 32);
+                bw.flush_bytes();
+                if (k)
+                    bw.bytes(raw, k);
+                raw += k;
+                n -= k;
+            } while (n > 0);
+        }
+
+        // 一个 deflate 块（覆盖 raw[0, raw_len)）：动态 Huffman；算下来不如 stored 时改存原始数据
+        void write_block(BitWriter &bw, const Seq *seq, size_t nseq_in, const unsigned char *raw, size_t raw_len,
+                         bool final)
+        {
+            const CodeTables &T = code_tables();
+            std::uint32_t lf[286] = {0}, df[30] = {0};
+            const unsigned char *lit = raw;
+            for (size_t i = 0; i < nseq_in; ++i)
+            {
+                const Seq &s = seq[i];
+                for (std::uint32_t k = 0; k < s.literals; ++k)
+                    lf[lit[k]]++;
+                lit += s.literals + s.len;
+                if (s.len)
+                {
+                    lf[257 + T.len_code[s.len]]++;
+                    df[T.dist(s.dist)]++;
+                }
+            }
+            lf[256] = 1;
+            ensure_two_symbols(lf, 286);
+            ensure_two_symbols(df, 30);
+
+            std::uint8_t ll[286], dl[30];
+            huffman_lengths(lf, 286, 15, ll);
+            huffman_lengths(df, 30, 15, dl);
+
+            int hlit = 286, hdist = 30;
+            while (hlit > 257 && ll[hlit - 1] == 0)
+                --hlit;
+            while (hdist > 1 && dl[hdist - 1] == 0)
+                --hdist;
+
+            // 码长序列做游程编码：16 重复前一个 3..6 次，17/18 连续 0 3..10 / 11..138 次
+            std::uint8_t lens[286 + 30];
+            const int nlens = hlit + hdist;
+            std::copy(ll, ll + hlit, lens);
+            std::copy(dl, dl + hdist, lens + hlit);
+            std::uint8_t rle_sym[286 + 30], rle_extra[286 + 30];
+            int nrle = 0;
+            std::uint32_t cf[19] = {0};
+            for (int i = 0; i < nlens;)
+            {
+                const std::uint8_t v = lens[i];
+                int run = 1;
+                while (i + run < nlens && lens[i + run] == v)
+                    ++run;
+                if (v == 0 && run >= 3)
+                {
+                    const int r = std::min(run, 138);
+                    rle_sym[nrle] = r >= 11 ? 18 : 17;
+                    rle_extra[nrle++] = (std::uint8_t)(r >= 11 ? r - 11 : r - 3);
+                    i += r;
+                }
+                else if (v != 0 && run >= 4)
+                {
+                    rle_sym[nrle] = v;
+                    rle_extra[nrle++] = 0;
+                    const int r = std::min(run - 1, 6);
+                    rle_sym[nrle] = 16;
+                    rle_extra[nrle++] = (std::uint8_t)(r - 3);
+                    i += 1 + r;
+                }
+                else
+                {
+                    rle_sym[nrle] = v;
+                    rle_extra[nrle++] = 0;
+                    ++i;
+                }
+            }
+            for (int i = 0; i < nrle; ++i)
+                cf[rle_sym[i]]++;
+            ensure_two_symbols(cf, 19);
+            std::uint8_t cl[19];
+            huffman_lengths(cf, 19, 7, cl);
+            int hclen = 19;
+            while (hclen > 4 && cl[kClOrder[hclen - 1]] == 0)
+                --hclen;
+
+            // 估算位数，决定用动态块还是 stored 块
+            std::uint64_t dyn_bits = 3 + 5 + 5 + 4 + 3 * (std::uint64_t)hclen;
+            for (int i = 0; i < 19; ++i)
+                dyn_bits += (std::uint64_t)cf[i] * cl[i];
+            dyn_bits += (std::uint64_t)cf[16] * 2 + (std::uint64_t)cf[17] * 3 + (std::uint64_t)cf[18] * 7;
+            for (int i = 0; i < 286; ++i)
+                dyn_bits += (std::uint64_t)lf[i] * (ll[i] + (i >= 257 ? kLenExtra[i - 257] : 0));
+            for (int i = 0; i < 30; ++i)
+                dyn_bits += (std::uint64_t)df[i] * (dl[i] + kDistExtra[i]);
+            const std::uint64_t stored_bits = ((std::uint64_t)raw_len + 5 * (raw_len / 65535 + 1)) * 8 + 7;
+            if (stored_bits < dyn_bits)
+            {
+                write_stored(bw, raw, raw_len, final);
+                return;
+            }
+
+            std::uint16_t lc[286], dc[30], cc[19];
+            huffman_codes(ll, 286, lc);
+            huffman_codes(dl, 30, dc);
+            huffman_codes(cl, 19, cc);
+
+            bw.reserve((size_t)(dyn_bits / 8) + 64);
+            BitCursor bc(bw);
+            bc.put(final ? 1 : 0, 1);
+            bc.put(2, 2);
+            bc.put((std::uint32_t)(hlit - 257), 5);
+            bc.put((std::uint32_t)(hdist - 1), 5);
+            bc.put((std::uint32_t)(hclen - 4), 4);
+            for (int i = 0; i < hclen; ++i)
+                bc.put(cl[kClOrder[i]], 3);
+            for (int i = 0; i < nrle; ++i)
+            {
+                const int s = rle_sym[i];
+                bc.put(cc[s], cl[s]);
+                if (s == 16)
+                    bc.put(rle_extra[i], 2);
+                else if (s == 17)
+                    bc.put(rle_extra[i], 3);
+                else if (s == 18)
+                    bc.put(rle_extra[i], 7);
+            }
+
+            lit = raw;
+            for (size_t i = 0; i < nseq_in; ++i)
+            {
+                const Seq s = seq[i];
+                for (std::uint32_t k = 0; k < s.literals; ++k)
+                    bc.put(lc[lit[k]], ll[lit[k]]);
+                lit += s.literals + s.len;
+                if (!s.len)
+                    continue;
+                const int lcode = T.len_code[s.len];
+                bc.put(lc[257 + lcode], ll[257 + lcode]);
+                if (kLenExtra[lcode])
+                    bc.put(s.len - kLenBase[lcode], kLenExtra[lcode]);
+                const int dcode = T.dist(s.dist);
+                bc.put(dc[dcode], dl[dcode]);
+                if (kDistExtra[dcode])
+                    bc.put(s.dist - kDistBase[dcode], kDistExtra[dcode]);
+            }
+            bc.put(lc[256], ll[256]);
+            bc.commit(bw);
+        }
+
+        inline std::uint32_t load_u32(const unsigned char *p)
+        {
+            std::uint32_t v;
+            std::memcpy(&v, p, 4);
+            return v;
+        }
+
+        inline std::uint64_t load_u64(const unsigned char *p)
+        {
+            std::uint64_t v;
+            std::memcpy(&v, p, 8);
+            return v;
+        }
+
+        inline size_t match_length(const unsigned char *a, const unsigned char *b, size_t max)
+        {
+            size_t l = 0;
+            while (l + 8 <= max && load_u64(a + l) == load_u64(b + l))
+                l += 8;
+            while (l < max && a[l] == b[l])
+                ++l;
+            return l;
+        }
+
+        const int kHashBits = 15;
+        // 哈希候选至少要匹配 8 字节：滤波后的字面量本来就便宜，更短的远距离匹配编码后往往比字面量还长
+        const int kHashMatch = 8;
+
+        inline std::uint32_t hash8(const unsigned char *p)
+        {
+            return (std::uint32_t)((load_u64(p) * 0x9E3779B185EBCA87ull) >> (64 - kHashBits));
+        }
+
+        // 匹配查找 + 分块输出共用的状态
+        struct Deflater
+        {
+            // 每个 deflate 块覆盖约 128KB 输入，Huffman 表能跟上局部统计的变化
+            static constexpr size_t kBlockBytes = (size_t)1 << 17;
+
+            PngMode mode;
+            int bpp;
+            std::vector<Seq> seqs;
+            std::vector<std::int32_t> head;
+
+            Deflater(PngMode m, int b) : mode(m), bpp(b), head((size_t)1 << kHashBits) {}
+
+            // 压缩 data[hist, n)；data[0, hist) 是紧挨着的前文，只作为匹配来源
+            void compress(const unsigned char *data, size_t hist, size_t n, bool final, BitWriter &bw)
+            {
+                if (mode == PngMode::STORE)
+                {
+                    write_stored(bw, data + hist, n - hist, final);
+                    return;
+                }
+
+                const bool fast = mode == PngMode::FAST;
+                if (fast)
+                {
+                    std::fill(head.begin(), head.end(), -1);
+                    const size_t h0 = hist > (size_t)kWindow ? hist - kWindow : 0;
+                    for (size_t i = h0; i + 8 <= hist; ++i)
+                        head[hash8(data + i)] = (std::int32_t)i;
+                }
+
+                seqs.clear();
+                size_t block_start = hist, anchor = hist, pos = hist;
+                size_t misses = 0;
+                while (pos + kMinMatch <= n)
+                {
+                    const size_t max = std::min((size_t)kMaxMatch, n - pos) - kMinMatch;
+                    const std::uint32_t cur = load_u32(data + pos);
+                    size_t len = 0, dist = 0;
+                    // 先看前一个像素（RLE 模式只看这一个）
+                    if (pos >= (size_t)bpp && load_u32(data + pos - bpp) == cur)
+                    {
+                        dist = (size_t)bpp;
+                        len = kMinMatch + match_length(data + pos - bpp + kMinMatch, data + pos + kMinMatch, max);
+                    }
+                    if (fast && pos + 8 <= n)
+                    {
+                        std::int32_t &slot = head[hash8(data + pos)];
+                        const std::int32_t cand = slot;
+                        slot = (std::int32_t)pos;
+                        const size_t d = pos - (size_t)cand;
+                        if (len < 16 && cand >= 0 && d <= (size_t)kWindow && load_u32(data + cand) == cur)
+                        {
+                            const size_t l = kMinMatch + match_length(data + cand + kMinMatch, data + pos + kMinMatch, max);
+                            if (l > len && l >= (size_t)kHashMatch)
+                            {
+                                len = l;
+                                dist = d;
+                            }
+                        }
+                    }
+
+                    if (!len)
+                    {
+                        // 连续找不到匹配时逐渐加大步长，不可压缩的数据也能快速跳过
+                        pos += 1 + (++misses >> 6);
+                        continue;
+                    }
+                    seqs.push_back(Seq{(std::uint32_t)(pos - anchor), (std::uint16_t)len, (std::uint16_t)dist});
+                    pos += len;
+                    anchor = pos;
+                    misses = 0;
+                    if (pos - block_start >= kBlockBytes && pos < n)
+                    {
+                        write_block(bw, seqs.data(), seqs.size(), data + block_start, pos - block_start, false);
+                        seqs.clear();
+                        block_start = pos;
+                    }
+                }
+                if (anchor < n)
+                    seqs.push_back(Seq{(std::uint32_t)(n - anchor), 0, 0});
+                write_block(bw, seqs.data(), seqs.size(), data + block_start, n - block_start, final);
+            }
+        };
+
+        // ===== PNG 滤波（整幅图用同一个滤波器）=====
+        inline unsigned char paeth(int a, int b, int c)
+        {
+            const int p = a + b - c;
+            const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc)
+                return (unsigned char)a;
+            return (unsigned char)(pb <= pc ? b : c);
+        }
+
+        // prev 为上一行原始像素，首行传 nullptr（按全 0 处理）；out[0] 是滤波类型字节
+        void filter_row(int filter, const unsigned char *cur, const unsigned char *prev, unsigned char *out,
+                        size_t n, int bpp)
+        {
+            *out++ = (unsigned char)filter;
+            const size_t b = std::min(n, (size_t)bpp);
+            switch (filter)
+            {
+            case 1: // Sub
+                std::memcpy(out, cur, b);
+                for (size_t i = b; i < n; ++i)
+                    out[i] = (unsigned char)(cur[i] - cur[i - bpp]);
+                break;
+            case 2: // Up
+                if (!prev)
+                    std::memcpy(out, cur, n);
+                else
+                    for (size_t i = 0; i < n; ++i)
+                        out[i] = (unsigned char)(cur[i] - prev[i]);
+                break;
+            case 3: // Average
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const int left = i >= b ? cur[i - bpp] : 0;
+                    const int up = prev ? prev[i] : 0;
+                    out[i] = (unsigned char)(cur[i] - ((left + up) >> 1));
+                }
+                break;
+            case 4: // Paeth
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const int left = i >= b ? cur[i - bpp] : 0;
+                    const int up = prev ? prev[i] : 0;
+                    const int ul = (prev && i >= b) ? prev[i - bpp] : 0;
+                    out[i] = (unsigned char)(cur[i] - paeth(left, up, ul));
+                }
+                break;
+            default:
+                std::memcpy(out, cur, n);
+                break;
+            }
+        }
+
+        inline void put_be32(unsigned char *p, std::uint32_t v)
+        {
+            p[0] = (unsigned char)(v >> 24);
+            p[1] = (unsigned char)(v >> 16);
+            p[2] = (unsigned char)(v >> 8);
+            p[3] = (unsigned char)v;
+        }
+
+        void write_chunk(EncodeWriteFn write, void *ctx, const char *type, const unsigned char *data, size_t len)
+        {
+            unsigned char head[8];
+            put_be32(head, (std::uint32_t)len);
+            std::memcpy(head + 4, type, 4);
+            std::uint32_t crc = crc32_update(0, head + 4, 4);
+            if (len)
+                crc = crc32_update(crc, data, len);
+            unsigned char tail[4];
+            put_be32(tail, crc);
+            write(ctx, head, 8);
+            if (len)
+                write(ctx, data, len);
+            write(ctx, tail, 4);
+        }
+    }
+
+    namespace detail
+    {
+        bool png_encode(const Mat &mat, EncodeWriteFn write, void *ctx, const ImwriteParams &params)
+        {
+            if (mat.empty() || mat.depth != Depth::U8 || mat.channels < 1 || mat.channels > 4 || !write)
+                return false;
+
+            static const unsigned char kColorType[5] = {0, 0, 4, 2, 6}; // 按通道数：灰度/灰度+A/RGB/RGBA
+            const int bpp = mat.channels;
+            const size_t rowbytes = (size_t)mat.width * (size_t)bpp;
+            const size_t stride = rowbytes + 1;
+            int filter = params.png_filter;
+            if (filter < 0 || filter > 4)
+                filter = params.png_mode == PngMode::STORE ? 0 : 2;
+
+            static const unsigned char kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            write(ctx, kSignature, 8);
+            unsigned char ihdr[13];
+            put_be32(ihdr, (std::uint32_t)mat.width);
+            put_be32(ihdr + 4, (std::uint32_t)mat.height);
+            ihdr[8] = 8;
+            ihdr[9] = kColorType[bpp];
+            ihdr[10] = ihdr[11] = ihdr[12] = 0;
+            write_chunk(write, ctx, "IHDR", ihdr, sizeof(ihdr));
+
+            // 按约 1MB 的行带切分；每条带单独滤波、压缩（前面最多 32K 的行重新滤波一遍作为匹配前文），
+            // 非末尾的带以空 stored 块（sync flush）收尾，输出按字节对齐，按顺序拼接即为一条 zlib 流。
+            // 单线程与多线程走同一套切分，输出逐字节相同
+            const int rows_per_band = (int)std::max((size_t)1, ((size_t)1 << 20) / stride);
+            const int hist_rows = (int)(((size_t)kWindow + stride - 1) / stride);
+            const int nbands = (mat.height + rows_per_band - 1) / rows_per_band;
+            const int nthreads = resolve_num_threads(params.png_threads, nbands);
+            const bool swap_rb = encode_swap_rb(params, bpp);
+
+            struct Band
+            {
+                std::vector<unsigned char> buf;
+                BitWriter bw;
+                Deflater deflater;
+                std::uint32_t adler = 1;
+                size_t len = 0;
+                Band(PngMode m, int b) : deflater(m, b) {}
+            };
+            std::vector<Band> slots;
+            slots.reserve((size_t)nthreads);
+            for (int i = 0; i < nthreads; ++i)
+                slots.emplace_back(params.png_mode, bpp);
+
+            auto encode_band = [&](int band, Band &b)
+            {
+                const int r0 = band * rows_per_band;
+                const int r1 = std::min(mat.height, r0 + rows_per_band);
+                const int h0 = std::max(0, r0 - hist_rows);
+                b.buf.resize((size_t)(r1 - h0) * stride);
+                unsigned char *dst = b.buf.data();
+                for (int y = h0; y < r1; ++y, dst += stride)
+                {
+                    const unsigned char *cur = mat.data + (size_t)y * mat.step;
+                    filter_row(filter, cur, y > 0 ? cur - mat.step : nullptr, dst, rowbytes, bpp);
+                    // 滤波按通道独立进行，滤波后再交换 R/B 与先交换再滤波结果相同
+                    if (swap_rb)
+                        for (size_t i = 1; i < stride; i += (size_t)bpp)
+                            std::swap(dst[i], dst[i + 2]);
+                }
+                const size_t n = b.buf.size();
+                const size_t hist = (size_t)(r0 - h0) * stride;
+                const size_t skip = hist > (size_t)kWindow ? hist - kWindow : 0;
+                b.len = n - hist;
+                b.adler = adler32_update(1, b.buf.data() + hist, b.len);
+
+                b.bw.pos = 0;
+                b.bw.bits = 0;
+                b.bw.count = 0;
+                if (band == 0)
+                {
+                    b.bw.reserve(64);
+                    b.bw.put(0x78, 8); // zlib 头：deflate、32K 窗口、最快压缩级别
+                    b.bw.put(0x01, 8);
+                }
+                const bool last = r1 == mat.height;
+                b.deflater.compress(b.buf.data() + skip, hist - skip, n - skip, last, b.bw);
+                if (!last)
+                    write_stored(b.bw, nullptr, 0, false);
+                b.bw.reserve(8);
+                b.bw.align();
+            };
+
+            // 每轮 nthreads 条带并行压缩，再按顺序写出，内存占用与图像大小无关
+            std::uint32_t adler = 1;
+            for (int first = 0; first < nbands; first += nthreads)
+            {
+                const int count = std::min(nthreads, nbands - first);
+                parallel_for(count, nthreads, [&](int i) { encode_band(first + i, slots[(size_t)i]); });
+                for (int i = 0; i < count; ++i)
+                {
+                    Band &b = slots[(size_t)i];
+                    adler = adler32_combine(adler, b.adler, b.len);
+                    if (first + i == nbands - 1)
+                    {
+                        unsigned char trailer[4];
+                        put_be32(trailer, adler);
+                        b.bw.reserve(4);
+                        b.bw.bytes(trailer, 4);
+                    }
+                    if (b.bw.pos > 0)
+                        write_chunk(write, ctx, "IDAT", b.bw.out.data(), b.bw.pos);
+                }
+            }
+            write_chunk(write, ctx, "IEND", nullptr, 0);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "SimpleCV.hpp"
+
+namespace SimpleCV
+{
+    namespace detail
+    {
+        // 自带的 PNG 编码器（ImwriteParams::png_mode 不是 STB 时使用，SimpleCV_Png.cpp）
+        // 按 mat.step 逐行读取，ROI/带 padding 的 Mat 无需先整理
+        bool png_encode(const Mat &mat, EncodeWriteFn write, void *ctx, const ImwriteParams &params);
+    }
+}
@@ -0,0 +1,288 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Common.hpp"
+#include "SimpleCV_Pnm.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// 二进制 PGM/PPM/PFM 不压缩：读写都是按行搬运样本，只在需要时做字节序/R-B/depth 转换
+namespace SimpleCV
+{
+    namespace
+    {
+        const std::size_t kHeaderProbe = 1024;      // 文件头（含注释）按这么多字节解析
+        const std::size_t kChunkBytes = 1 << 20;    // 写出时攒满约 1MB 再交给 EncodeWriteFn
+
+        bool is_pfm(const PnmHeader &h)
+        {
+            return h.type == 'f' || h.type == 'F';
+        }
+
+        // 文件里的样本类型：maxval <= 255 为 8 位，否则为 16 位大端；PFM 为 32 位 float
+        Depth file_depth(const PnmHeader &h)
+        {
+            if (is_pfm(h))
+                return Depth::F32;
+            return h.maxval > 255 ? Depth::U16 : Depth::U8;
+        }
+
+        bool file_needs_bswap(const PnmHeader &h)
+        {
+            if (is_pfm(h))
+                return (h.scale < 0.0f) != host_is_little_endian();
+            return h.maxval > 255 && host_is_little_endian();
+        }
+
+        void bswap_rows(Mat &m)
+        {
+            const std::size_t k = m.elemSize1();
+            const std::size_t n = (size_t)m.width * m.channels;
+            for (int y = 0; y < m.height; ++y)
+            {
+                unsigned char *p = m.data + (size_t)y * m.step;
+                for (std::size_t i = 0; i < n; ++i, p += k)
+                    std::reverse(p, p + k);
+            }
+        }
+
+        // 像素数据来源：文件或内存
+        struct PnmInput
+        {
+            FILE *f;
+            const unsigned char *buf;
+            std::size_t len;
+            std::size_t pos;
+
+            bool read(void *dst, std::size_t n)
+            {
+                if (f)
+                    return fread(dst, 1, n, f) == n;
+                if (len - pos < n)
+                    return false;
+                std::memcpy(dst, buf + pos, n);
+                pos += n;
+                return true;
+            }
+        };
+
+        // 像素数据之后是否还有 need 字节：先于分配检查，坏文件头不会换来巨大的缓冲区
+        bool input_has(FILE *f, std::size_t len, std::size_t offset, std::size_t need)
+        {
+            if (f)
+            {
+                if (fseek(f, 0, SEEK_END) != 0)
+                    return false;
+                const long end = ftell(f);
+                if (end < 0)
+                    return false;
+                len = (std::size_t)end;
+            }
+            return offset <= len && len - offset >= need;
+        }
+
+        // PFM 转到其它 depth：整数按 0..1 的 LDR 约定截断缩放
+        template <typename D, typename Fn>
+        void convert_rows(const Mat &src, Mat &dst, Fn cvt)
+        {
+            const std::size_t n = (size_t)src.width * src.channels;
+            for (int y = 0; y < src.height; ++y)
+            {
+                const float *sp = src.ptr<float>(y);
+                D *dp = dst.ptr<D>(y);
+                for (std::size_t i = 0; i < n; ++i)
+                    dp[i] = cvt(sp[i]);
+            }
+        }
+
+        void convert_from_f32(const Mat &src, Mat &dst)
+        {
+            auto unit = [](float v)
+            { return std::min(std::max(v, 0.0f), 1.0f); };
+            switch (dst.depth)
+            {
+            case Depth::U8:
+                convert_rows<std::uint8_t>(src, dst, [unit](float v)
+                                           { return (std::uint8_t)(unit(v) * 255.0f + 0.5f); });
+                break;
+            case Depth::U16:
+                convert_rows<std::uint16_t>(src, dst, [unit](float v)
+                                            { return (std::uint16_t)(unit(v) * 65535.0f + 0.5f); });
+                break;
+            case Depth::F16:
+                convert_rows<float16>(src, dst, [](float v)
+                                      { return float16(v); });
+                break;
+            case Depth::F32:
+                convert_rows<float>(src, dst, [](float v)
+                                    { return v; });
+                break;
+            }
+        }
+
+        // 一行样本整理成文件格式：R/B 交换与样本转换一起做
+        template <typename S, typename D, typename Fn>
+        void pack_row(const S *sp, D *dp, int width, int c, bool swap_rb, Fn cvt)
+        {
+            if (!swap_rb)
+            {
+                const std::size_t n = (size_t)width * c;
+                for (std::size_t i = 0; i < n; ++i)
+                    dp[i] = cvt(sp[i]);
+                return;
+            }
+            for (int x = 0; x < width; ++x, sp += 3, dp += 3)
+            {
+                dp[0] = cvt(sp[2]);
+                dp[1] = cvt(sp[1]);
+                dp[2] = cvt(sp[0]);
+            }
+        }
+
+        void pack_mat_row(const Mat &mat, int y, unsigned char *dp, bool swap_rb, bool bswap)
+        {
+            const int w = mat.width, c = mat.channels;
+            switch (mat.depth)
+            {
+            case Depth::U8:
+                pack_row(mat.ptr<std::uint8_t>(y), dp, w, c, swap_rb, [](std::uint8_t v)
+                         { return v; });
+                break;
+            case Depth::U16:
+                pack_row(mat.ptr<std::uint16_t>(y), reinterpret_cast<std::uint16_t *>(dp), w, c, swap_rb,
+                         [bswap](std::uint16_t v)
+                         { return bswap ? (std::uint16_t)((v >> 8) | (v << 8)) : v; });
+                break;
+            case Depth::F16:
+                pack_row(mat.ptr<float16>(y), reinterpret_cast<float *>(dp), w, c, swap_rb, [](float16 v)
+                         { return static_cast<float>(v); });
+                break;
+            case Depth::F32:
+                pack_row(mat.ptr<float>(y), reinterpret_cast<float *>(dp), w, c, swap_rb, [](float v)
+                         { return v; });
+                break;
+            }
+        }
+    }
+
+    bool detail::pnm_decode(FILE *f, const unsigned char *buf, std::size_t len, ColorSpace flag, Depth depth, Mat &dst,
+                            bool &ok)
+    {
+        ok = false;
+        unsigned char head[kHeaderProbe];
+        const unsigned char *p = buf;
+        std::size_t n = len;
+        if (f)
+        {
+            n = fread(head, 1, sizeof(head), f);
+            p = head;
+        }
+        PnmHeader h;
+        if (!parse_pnm_header(p, n, h) && !parse_pfm_header(p, n, h))
+            return false;
+
+        const bool pfm = is_pfm(h);
+        const Depth fd = file_depth(h);
+        const int req_c = desired_channels(flag);
+        const int out_c = req_c != 0 ? req_c : h.channels;
+        const bool same = out_c == h.channels && depth == fd;
+        // P5/P6 要改通道数或 depth 时交给 stb；stb 不认得 PFM，只能在这里转换
+        if (!same && !pfm)
+            return false;
+
+        // 宽高已限制在 1<<24 以内，字节数按 size_t 计算
+        const std::size_t row = (size_t)h.width * h.channels * depthSize(fd);
+        if (row > SIZE_MAX / (size_t)h.height || !input_has(f, len, h.data_offset, row * (size_t)h.height))
+            return true;
+
+        // 不需要转换时直接读进 dst（可以是带 stride 的视图）
+        Mat raw;
+        if (same && dst_buffer_compatible(dst, h.height, h.width, out_c, depth))
+            raw = dst;
+        else
+            raw.create(h.height, h.width, h.channels, fd);
+
+        PnmInput in{f, buf, len, h.data_offset};
+        if (f && fseek(f, (long)h.data_offset, SEEK_SET) != 0)
+            return true;
+        bool good = true;
+        if (!pfm && (size_t)raw.step == row)
+            good = in.read(raw.data, row * (size_t)h.height);
+        else
+            for (int i = 0; good && i < h.height; ++i)
+                good = in.read(raw.data + (size_t)(pfm ? h.height - 1 - i : i) * raw.step, row);
+        if (!good)
+            return true;
+        if (file_needs_bswap(h))
+            bswap_rows(raw);
+
+        if (same)
+        {
+            if (is_bgr_family(flag))
+                swap_rb_inplace(raw);
+            if (raw.data != dst.data)
+                dst = raw;
+            ok = true;
+            return true;
+        }
+
+        Mat conv = raw;
+        if (out_c != h.channels)
+            cvtColor(raw, conv, flag, h.channels == 1 ? ColorSpace::GRAY : ColorSpace::RGB);
+        else if (is_bgr_family(flag))
+            swap_rb_inplace(conv);
+        if (conv.empty())
+            return true;
+
+        if (dst_buffer_compatible(dst, h.height, h.width, out_c, depth))
+            convert_from_f32(conv, dst);
+        else if (depth == Depth::F32)
+            dst = conv;
+        else
+        {
+            Mat out(h.height, h.width, out_c, depth);
+            convert_from_f32(conv, out);
+            dst = out;
+        }
+        ok = true;
+        return true;
+    }
+
+    bool detail::pnm_encode(const Mat &mat, bool pfm, EncodeWriteFn write, void *ctx, const ImwriteParams &params)
+    {
+        if (mat.empty() || !write || (mat.channels != 1 && mat.channels != 3))
+            return false;
+        if (pfm ? (mat.depth != Depth::F32 && mat.depth != Depth::F16)
+                : (mat.depth != Depth::U8 && mat.depth != Depth::U16))
+            return false;
+
+        const int w = mat.width, h = mat.height, c = mat.channels;
+        const std::string header = pfm ? make_pfm_header(w, h, c)
+                                       : make_pnm_header(w, h, c, mat.depth == Depth::U16 ? 65535 : 255);
+        write(ctx, header.data(), header.size());
+
+        const bool swap_rb = encode_swap_rb(params, c);
+        const bool bswap = mat.depth == Depth::U16 && host_is_little_endian();
+        const std::size_t row = (size_t)w * c * (pfm ? sizeof(float) : (size_t)depthSize(mat.depth));
+        // 样本原样可用、行序不变且紧密排列：整块像素一次写出
+        if (!swap_rb && !bswap && !pfm && (size_t)mat.step == row)
+        {
+            write(ctx, mat.data, row * (size_t)h);
+            return true;
+        }
+
+        const std::size_t rows_per_chunk = std::max<std::size_t>(1, kChunkBytes / row);
+        std::vector<unsigned char> chunk(std::min(rows_per_chunk, (size_t)h) * row);
+        std::size_t used = 0;
+        for (int i = 0; i < h; ++i)
+        {
+            pack_mat_row(mat, pfm ? h - 1 - i : i, chunk.data() + used, swap_rb, bswap);
+            used += row;
+            if (used == chunk.size() || i == h - 1)
+            {
+                write(ctx, chunk.data(), used);
+                used = 0;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include "SimpleCV.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace SimpleCV
+{
+    // 二进制 PNM 头：P5 (PGM) / P6 (PPM)；PFM：Pf（灰度）/ PF（RGB），32 位 float，行序自下而上
+    struct PnmHeader
+    {
+        char type = 0; // '5' / '6' / 'f' / 'F'
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        int maxval = 0;              // PFM 为 0
+        float scale = 0.0f;          // 仅 PFM：负数表示小端样本
+        std::size_t data_offset = 0; // 像素数据在文件中的起始位置
+    };
+
+    // 与 stb 的 STBI_MAX_DIMENSIONS 一致：更大的宽高视为坏文件
+    const int kPnmMaxDimension = 1 << 24;
+
+    static inline bool pnm_dims_valid(const PnmHeader &h)
+    {
+        return h.width > 0 && h.height > 0 && h.width <= kPnmMaxDimension && h.height <= kPnmMaxDimension;
+    }
+
+    static inline bool host_is_little_endian()
+    {
+        const std::uint16_t probe = 1;
+        unsigned char b;
+        std::memcpy(&b, &probe, 1);
+        return b == 1;
+    }
+
+    static inline bool pnm_is_space(unsigned char ch)
+    {
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' || ch == '\f';
+    }
+
+    // 跳过空白与 '#' 注释，读一个非负整数
+    static inline bool pnm_read_int(const unsigned char *p, std::size_t n, std::size_t &pos, int &out)
+    {
+        for (;;)
+        {
+            while (pos < n && pnm_is_space(p[pos]))
+                ++pos;
+            if (pos < n && p[pos] == '#')
+            {
+                while (pos < n && p[pos] != '\n' && p[pos] != '\r')
+                    ++pos;
+                continue;
+            }
+            break;
+        }
+        if (pos >= n || p[pos] < '0' || p[pos] > '9')
+            return false;
+        long long v = 0;
+        while (pos < n && p[pos] >= '0' && p[pos] <= '9')
+        {
+            v = v * 10 + (p[pos] - '0');
+            if (v > 0x7fffffffLL)
+                return false;
+            ++pos;
+        }
+        out = (int)v;
+        return true;
+    }
+
+    // p 至少包含完整的头部；失败返回 false
+    static inline bool parse_pnm_header(const unsigned char *p, std::size_t n, PnmHeader &h)
+    {
+        if (n < 3 || p[0] != 'P' || (p[1] != '5' && p[1] != '6'))
+            return false;
+        h.type = (char)p[1];
+        h.channels = (p[1] == '6') ? 3 : 1;
+        std::size_t pos = 2;
+        if (!pnm_read_int(p, n, pos, h.width) || !pnm_read_int(p, n, pos, h.height) ||
+            !pnm_read_int(p, n, pos, h.maxval))
+            return false;
+        // maxval 之后恰好一个空白字符，然后是像素数据
+        if (pos >= n || !pnm_is_space(p[pos]))
+            return false;
+        h.data_offset = pos + 1;
+        return pnm_dims_valid(h) && h.maxval > 0 && h.maxval <= 65535;
+    }
+
+    // PFM 头：width height 之后是一个非零的浮点比例
+    static inline bool parse_pfm_header(const unsigned char *p, std::size_t n, PnmHeader &h)
+    {
+        if (n < 3 || p[0] != 'P' || (p[1] != 'f' && p[1] != 'F'))
+            return false;
+        h.type = (char)p[1];
+        h.channels = (p[1] == 'F') ? 3 : 1;
+        h.maxval = 0;
+        std::size_t pos = 2;
+        if (!pnm_read_int(p, n, pos, h.width) || !pnm_read_int(p, n, pos, h.height))
+            return false;
+        while (pos < n && pnm_is_space(p[pos]))
+            ++pos;
+        char num[32];
+        std::size_t len = 0;
+        while (pos < n && len + 1 < sizeof(num) && !pnm_is_space(p[pos]))
+            num[len++] = (char)p[pos++];
+        num[len] = 0;
+        char *end = nullptr;
+        h.scale = std::strtof(num, &end);
+        if (len == 0 || end != num + len || pos >= n || !pnm_is_space(p[pos]))
+            return false;
+        h.data_offset = pos + 1;
+        return pnm_dims_valid(h) && h.scale != 0.0f;
+    }
+
+    static inline std::string make_pnm_header(int w, int h, int channels, int maxval)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "P%c\n%d %d\n%d\n", channels == 3 ? '6' : '5', w, h, maxval);
+        return buf;
+    }
+
+    // 样本按本机字节序写出，比例的符号随之给出
+    static inline std::string make_pfm_header(int w, int h, int channels)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "P%c\n%d %d\n%s\n", channels == 3 ? 'F' : 'f', w, h,
+                      host_is_little_endian() ? "-1.0" : "1.0");
+        return buf;
+    }
+
+    namespace detail
+    {
+        // 二进制 PGM/PPM/PFM 的原生解码（SimpleCV_Pnm.cpp）：f 非空时从文件读（从文件开头），否则从 buf/len 读。
+        // 返回 false 表示不是这几种格式，或是 P5/P6 需要改通道数/depth（交给 stb，转换结果与以往一致），dst 不变；
+        // 返回 true 时 ok 给出解码是否成功
+        bool pnm_decode(FILE *f, const unsigned char *buf, std::size_t len, ColorSpace flag, Depth depth, Mat &dst,
+                        bool &ok);
+
+        // 写 P5/P6（U8：maxval 255；U16：maxval 65535）或 PFM（F32/F16），只支持 1/3 通道。
+        // 按 mat.step 逐行读取，需要逐样本转换时整理进约 1MB 的缓冲区再交给 write
+        bool pnm_encode(const Mat &mat, bool pfm, EncodeWriteFn write, void *ctx, const ImwriteParams &params);
+    }
+}
@@ -5,27 +5,32 @@
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #endif
 
+// stbir 的临时缓冲区计入内存统计
+#define STBIR_MALLOC(size, user_data) ((void)(user_data), SimpleCV::detail::tracked_malloc(size))
+#define STBIR_FREE(ptr, user_data) ((void)(user_data), SimpleCV::detail::tracked_free(ptr))
+
 #include "stb_image_resize2.h"
 
 namespace SimpleCV
 {
     void resize(const Mat &src, Mat &dst, int dst_width, int dst_height)
     {
+        MemoryScope scope("resize");
         if (src.empty() || dst_width <= 0 || dst_height <= 0)
         {
             dst.release();
             return;
         }
-        if (src.step < src.width * src.channels)
+        if (src.step < src.width * src.elemSize())
         { // 防御：src stride 必须够
             dst.release();
             return;
         }
 
-        // 处理 in-place / 共享内存（最简单：指针相等就当冲突）
-        if (dst.data == src.data)
+        // 处理 in-place / 共享内存（dst 与 src 是同一缓冲区上重叠的视图）
+        if (dst.data == src.data || mats_overlap(dst, src))
         {
-            Mat tmp(dst_height, dst_width, src.channels);
+            Mat tmp(dst_height, dst_width, src.channels, src.depth, src.stepMode());
             resize(src, tmp, dst_width, dst_height);
             dst = tmp; // 或 swap
             return;
@@ -36,12 +41,13 @@ namespace SimpleCV
             dst.width == dst_width &&
             dst.height == dst_height &&
             dst.channels == src.channels &&
-            dst.step >= dst_width * dst.channels;
+            dst.depth == src.depth &&
+            dst.step >= dst_width * dst.elemSize();
 
         if (!can_reuse)
-            dst.create(dst_height, dst_width, src.channels);
+            dst.create(dst_height, dst_width, src.channels, src.depth, src.stepMode());
 
-        if (dst.step < dst.width * dst.channels)
+        if (dst.step < dst.width * dst.elemSize())
         { // 防御：dst stride 必须够
             dst.release();
             return;
@@ -67,15 +73,84 @@ namespace SimpleCV
             return;
         }
 
-        unsigned char *out = stbir_resize_uint8_linear(
-            src.data, src.width, src.height, src.step,
-            dst.data, dst.width, dst.height, dst.step,
-            layout);
+        void *out = nullptr;
+        if (src.depth == Depth::U8)
+        {
+            out = stbir_resize_uint8_linear(
+                src.data, src.width, src.height, src.step,
+                dst.data, dst.width, dst.height, dst.step,
+                layout);
+        }
+        else
+        {
+            stbir_datatype type = STBIR_TYPE_FLOAT;
+            if (src.depth == Depth::U16)
+                type = STBIR_TYPE_UINT16;
+            else if (src.depth == Depth::F16)
+                type = STBIR_TYPE_HALF_FLOAT;
+
+            out = stbir_resize(
+                src.data, src.width, src.height, src.step,
+                dst.data, dst.width, dst.height, dst.step,
+                layout, type, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT);
+        }
 
         if (!out)
             dst.release();
     }
 
+    namespace detail
+    {
+        bool resize_u8(const Mat &src, Mat &dst, int dst_width, int dst_height, bool swap_rb, Interp interp)
+        {
+            if (src.empty() || src.depth != Depth::U8 || dst_width <= 0 || dst_height <= 0)
+                return false;
+
+            static const stbir_pixel_layout kLayouts[5] = {STBIR_1CHANNEL, STBIR_1CHANNEL, STBIR_2CHANNEL, STBIR_RGB,
+                                                           STBIR_RGBA};
+            static const stbir_pixel_layout kSwapped[5] = {STBIR_1CHANNEL, STBIR_1CHANNEL, STBIR_2CHANNEL, STBIR_BGR,
+                                                           STBIR_BGRA};
+            if (src.channels < 1 || src.channels > 4)
+                return false;
+
+            stbir_filter filter = STBIR_FILTER_DEFAULT;
+            switch (interp)
+            {
+            case Interp::NEAREST:
+                filter = STBIR_FILTER_POINT_SAMPLE;
+                break;
+            case Interp::LINEAR:
+                filter = STBIR_FILTER_TRIANGLE;
+                break;
+            case Interp::CUBIC:
+                filter = STBIR_FILTER_CATMULLROM;
+                break;
+            case Interp::AREA:
+                filter = STBIR_FILTER_BOX;
+                break;
+            default:
+                break;
+            }
+
+            if (dst.empty() || dst.width != dst_width || dst.height != dst_height || dst.channels != src.channels ||
+                dst.depth != Depth::U8 || mats_overlap(dst, src))
+                dst = Mat(dst_height, dst_width, src.channels, Depth::U8);
+
+            STBIR_RESIZE r;
+            stbir_resize_init(&r, src.data, src.width, src.height, src.step, dst.data, dst.width, dst.height, dst.step,
+                              kLayouts[src.channels], STBIR_TYPE_UINT8);
+            if (swap_rb)
+                stbir_set_pixel_layouts(&r, kLayouts[src.channels], kSwapped[src.channels]);
+            if (filter != STBIR_FILTER_DEFAULT)
+                stbir_set_filters(&r, filter, filter);
+            if (!stbir_resize_extended(&r))
+            {
+                dst.release();
+                return false;
+            }
+            return true;
+        }
+    }
 }
 
 namespace SimpleCV
@@ -92,161 +167,222 @@ namespace SimpleCV
         return clamp_u8(y);
     }
 
-    static inline bool dst_buffer_compatible(const Mat &dst, int h, int w, int c)
-    {
-        if (dst.empty())
-            return false;
-        if (dst.height != h || dst.width != w || dst.channels != c)
-            return false;
-        const int min_step = w * c;
-        return dst.step >= min_step && dst.data != nullptr;
-    }
+    // 每种 depth 的存储类型 T / 运算类型 W / alpha 满值 / 灰度公式
+    template <typename T>
+    struct CvtTraits;
 
-    void cvtColor(const Mat &src, Mat &dst, ColorSpace dst_space, ColorSpace src_space)
+    template <>
+    struct CvtTraits<std::uint8_t>
     {
-        if (src.empty())
-        {
-            dst.release();
-            return;
-        }
-
-        if (src_space == ColorSpace::AUTO)
-            src_space = infer_space_from_channels(src);
-
-        // 先把 src_space 归一到 {GRAY, RGB, BGR, RGBA, BGRA}
-        if (src_space == ColorSpace::UNCHANGED)
-            src_space = infer_space_from_channels(src);
-
-        // dst_space 也不允许 UNCHANGED/AUTO（你也可以允许 AUTO=按 src 直接返回 clone）
-        if (dst_space == ColorSpace::AUTO || dst_space == ColorSpace::UNCHANGED)
-        {
-            // AUTO/UNCHANGED：保持源格式，做浅拷贝（共享底层 buffer）
-            dst = src;
-            return;
-        }
-
-        auto dst_ch = desired_channels(dst_space);
-        if (dst_ch == 0)
-        {
-            dst.release();
-            return;
-        }
-
-        // 如果用户提供的 dst 尺寸/通道/stride 满足需求，则直接复用；否则重新分配
-        if (!dst_buffer_compatible(dst, src.height, src.width, dst_ch))
-        {
-            dst.create(src.height, src.width, dst_ch);
-        }
-
-        // 一些快速路径
-        if (src_space == dst_space)
-        {
-            // channels 必须一致才能直接 copy
-            if (src.channels == dst.channels && src.step == dst.step)
-            {
-                std::memcpy(dst.data, src.data, (size_t)src.height * (size_t)src.step);
-                return;
-            }
-        }
+        typedef int W;
+        static W alpha() { return 255; }
+        static W load(std::uint8_t v) { return v; }
+        static std::uint8_t store(W v) { return (std::uint8_t)v; }
+        static W gray(W r, W g, W b) { return rgb_to_gray_u8((unsigned char)r, (unsigned char)g, (unsigned char)b); }
+    };
+
+    template <>
+    struct CvtTraits<std::uint16_t>
+    {
+        typedef int W;
+        static W alpha() { return 65535; }
+        static W load(std::uint16_t v) { return v; }
+        static std::uint16_t store(W v) { return (std::uint16_t)v; }
+        static W gray(W r, W g, W b) { return (299 * r + 587 * g + 114 * b + 500) / 1000; }
+    };
+
+    template <>
+    struct CvtTraits<float>
+    {
+        typedef float W;
+        static W alpha() { return 1.0f; }
+        static W load(float v) { return v; }
+        static float store(W v) { return v; }
+        static W gray(W r, W g, W b) { return 0.299f * r + 0.587f * g + 0.114f * b; }
+    };
+
+    template <>
+    struct CvtTraits<float16>
+    {
+        typedef float W;
+        static W alpha() { return 1.0f; }
+        static W load(float16 v) { return (float)v; }
+        static float16 store(W v) { return float16(v); }
+        static W gray(W r, W g, W b) { return 0.299f * r + 0.587f * g + 0.114f * b; }
+    };
+
+    template <typename T>
+    static bool cvt_color_rows(const Mat &src, Mat &dst, ColorSpace src_space, ColorSpace dst_space)
+    {
+        typedef CvtTraits<T> Tr;
+        typedef typename Tr::W W;
 
         // 逐像素转换
         for (int y = 0; y < src.height; ++y)
         {
-            const unsigned char *sp = src.data + y * src.step;
-            unsigned char *dp = dst.data + y * dst.step;
+            const T *sp = src.ptr<T>(y);
+            T *dp = dst.ptr<T>(y);
 
             for (int x = 0; x < src.width; ++x)
             {
                 // 先从 src 读出 (r,g,b,a) 的“逻辑值”
-                unsigned char r = 0, g = 0, b = 0, a = 255;
+                W r = 0, g = 0, b = 0, a = Tr::alpha();
 
                 if (src_space == ColorSpace::GRAY)
                 {
-                    unsigned char v = sp[x];
+                    W v = Tr::load(sp[x]);
                     r = g = b = v;
-                    a = 255;
                 }
                 else if (src_space == ColorSpace::RGB)
                 {
-                    const unsigned char *p = sp + x * 3;
-                    r = p[0];
-                    g = p[1];
-                    b = p[2];
-                    a = 255;
+                    const T *p = sp + x * 3;
+                    r = Tr::load(p[0]);
+                    g = Tr::load(p[1]);
+                    b = Tr::load(p[2]);
                 }
                 else if (src_space == ColorSpace::BGR)
                 {
-                    const unsigned char *p = sp + x * 3;
-                    b = p[0];
-                    g = p[1];
-                    r = p[2];
-                    a = 255;
+                    const T *p = sp + x * 3;
+                    b = Tr::load(p[0]);
+                    g = Tr::load(p[1]);
+                    r = Tr::load(p[2]);
                 }
                 else if (src_space == ColorSpace::RGBA)
                 {
-                    const unsigned char *p = sp + x * 4;
-                    r = p[0];
-                    g = p[1];
-                    b = p[2];
-                    a = p[3];
+                    const T *p = sp + x * 4;
+                    r = Tr::load(p[0]);
+                    g = Tr::load(p[1]);
+                    b = Tr::load(p[2]);
+                    a = Tr::load(p[3]);
                 }
                 else if (src_space == ColorSpace::BGRA)
                 {
-                    const unsigned char *p = sp + x * 4;
-                    b = p[0];
-                    g = p[1];
-                    r = p[2];
-                    a = p[3];
+                    const T *p = sp + x * 4;
+                    b = Tr::load(p[0]);
+                    g = Tr::load(p[1]);
+                    r = Tr::load(p[2]);
+                    a = Tr::load(p[3]);
                 }
                 else
                 {
                     // 不支持的 src_space
-                    dst.release();
-                    return;
+                    return false;
                 }
 
                 // 写入 dst
                 if (dst_space == ColorSpace::GRAY)
                 {
-                    dp[x] = rgb_to_gray_u8(r, g, b);
+                    dp[x] = Tr::store(Tr::gray(r, g, b));
                 }
                 else if (dst_space == ColorSpace::RGB)
                 {
-                    unsigned char *q = dp + x * 3;
-                    q[0] = r;
-                    q[1] = g;
-                    q[2] = b;
+                    T *q = dp + x * 3;
+                    q[0] = Tr::store(r);
+                    q[1] = Tr::store(g);
+                    q[2] = Tr::store(b);
                 }
                 else if (dst_space == ColorSpace::BGR)
                 {
-                    unsigned char *q = dp + x * 3;
-                    q[0] = b;
-                    q[1] = g;
-                    q[2] = r;
+                    T *q = dp + x * 3;
+                    q[0] = Tr::store(b);
+                    q[1] = Tr::store(g);
+                    q[2] = Tr::store(r);
                 }
                 else if (dst_space == ColorSpace::RGBA)
                 {
-                    unsigned char *q = dp + x * 4;
-                    q[0] = r;
-                    q[1] = g;
-                    q[2] = b;
-                    q[3] = a;
+                    T *q = dp + x * 4;
+                    q[0] = Tr::store(r);
+                    q[1] = Tr::store(g);
+                    q[2] = Tr::store(b);
+                    q[3] = Tr::store(a);
                 }
                 else if (dst_space == ColorSpace::BGRA)
                 {
-                    unsigned char *q = dp + x * 4;
-                    q[0] = b;
-                    q[1] = g;
-                    q[2] = r;
-                    q[3] = a;
+                    T *q = dp + x * 4;
+                    q[0] = Tr::store(b);
+                    q[1] = Tr::store(g);
+                    q[2] = Tr::store(r);
+                    q[3] = Tr::store(a);
                 }
                 else
                 {
-                    dst.release();
-                    return;
+                    return false;
                 }
             }
         }
+        return true;
+    }
+
+    void cvtColor(const Mat &src, Mat &dst, ColorSpace dst_space, ColorSpace src_space)
+    {
+        MemoryScope scope("cvtColor");
+        if (src.empty())
+        {
+            dst.release();
+            return;
+        }
+
+        if (src_space == ColorSpace::AUTO)
+            src_space = infer_space_from_channels(src);
+
+        // 先把 src_space 归一到 {GRAY, RGB, BGR, RGBA, BGRA}
+        if (src_space == ColorSpace::UNCHANGED)
+            src_space = infer_space_from_channels(src);
+
+        // dst_space 也不允许 UNCHANGED/AUTO（你也可以允许 AUTO=按 src 直接返回 clone）
+        if (dst_space == ColorSpace::AUTO || dst_space == ColorSpace::UNCHANGED)
+        {
+            // AUTO/UNCHANGED：保持源格式，做浅拷贝（共享底层 buffer）
+            dst = src;
+            return;
+        }
+
+        auto dst_ch = desired_channels(dst_space);
+        if (dst_ch == 0)
+        {
+            dst.release();
+            return;
+        }
+
+        // 如果用户提供的 dst 尺寸/通道/depth/stride 满足需求，则直接复用；否则重新分配
+        // 逐像素原地转换只在 dst 与 src 完全重合时安全；部分重叠的 ROI 视图改为新分配
+        const bool partial_overlap = dst.data != src.data && mats_overlap(dst, src);
+        if (partial_overlap || !dst_buffer_compatible(dst, src.height, src.width, dst_ch, src.depth))
+        {
+            dst.create(src.height, src.width, dst_ch, src.depth, src.stepMode());
+        }
+
+        // 一些快速路径
+        if (src_space == dst_space)
+        {
+            // channels 必须一致才能直接 copy；逐行拷贝，不碰行尾 padding
+            if (src.channels == dst.channels)
+            {
+                const size_t row_bytes = (size_t)src.width * (size_t)src.elemSize();
+                for (int y = 0; y < src.height; ++y)
+                    std::memcpy(dst.ptr(y), src.ptr(y), row_bytes);
+                return;
+            }
+        }
+
+        bool ok = false;
+        switch (src.depth)
+        {
+        case Depth::U8:
+            ok = cvt_color_rows<std::uint8_t>(src, dst, src_space, dst_space);
+            break;
+        case Depth::U16:
+            ok = cvt_color_rows<std::uint16_t>(src, dst, src_space, dst_space);
+            break;
+        case Depth::F16:
+            ok = cvt_color_rows<float16>(src, dst, src_space, dst_space);
+            break;
+        case Depth::F32:
+            ok = cvt_color_rows<float>(src, dst, src_space, dst_space);
+            break;
+        }
+        if (!ok)
+            dst.release();
     }
 
     Mat cvtColor(const Mat &src, ColorSpace dst_space, ColorSpace src_space)
@@ -273,6 +409,36 @@ namespace SimpleCV
         return v.back();
     }
 
+    // value 按 8 位给出，换算到 depth 的量程（与 cvtColor 的“不透明”一致：U16 为 65535，浮点为 1.0）
+    static inline void border_encode_value(unsigned char *dst, Depth depth, unsigned char v)
+    {
+        switch (depth)
+        {
+        case Depth::U16:
+        {
+            std::uint16_t t = (std::uint16_t)(v * 257);
+            std::memcpy(dst, &t, sizeof(t));
+            break;
+        }
+        case Depth::F16:
+        {
+            float16 t(v / 255.0f);
+            std::memcpy(dst, &t.bits, sizeof(t.bits));
+            break;
+        }
+        case Depth::F32:
+        {
+            float t = v / 255.0f;
+            std::memcpy(dst, &t, sizeof(t));
+            break;
+        }
+        case Depth::U8:
+        default:
+            dst[0] = v;
+            break;
+        }
+    }
+
     static inline int border_map_coord(int p, int len, BorderType bt)
     {
         // 把越界坐标 p 映射到 [0, len-1]
@@ -327,6 +493,7 @@ namespace SimpleCV
         BorderType borderType,
         const std::vector<unsigned char> &value)
     {
+        MemoryScope scope("copyMakeBorder");
         if (src.empty())
         {
             dst.release();
@@ -342,6 +509,8 @@ namespace SimpleCV
             right = 0;
 
         const int c = src.channels;
+        const int esz1 = src.elemSize1();
+        const int esz = src.elemSize();
         const int out_h = src.height + top + bottom;
         const int out_w = src.width + left + right;
 
@@ -351,29 +520,37 @@ namespace SimpleCV
             return;
         }
 
-        Mat out(out_h, out_w, c); // step = out_w*c (紧密)
+        Mat out(out_h, out_w, c, src.depth, src.stepMode()); // depth/行存储方式跟随 src
 
         // ===== 1) CONSTANT：先整张填充，再把 src 贴进去（最快）=====
         if (borderType == BorderType::CONSTANT)
         {
+            // 填充像素：非 U8 按量程换算（U16 写 v*257，浮点写 v/255）
+            unsigned char fill_px[4 * 4];
+            for (int k = 0; k < c && k < 4; ++k)
+                border_encode_value(fill_px + k * esz1, src.depth, border_pick_value(value, k));
+
             // fill
             for (int y = 0; y < out.height; ++y)
             {
-                unsigned char *row = out.data + y * out.step;
+                unsigned char *row = out.data + (size_t)y * (size_t)out.step;
                 for (int x = 0; x < out.width; ++x)
                 {
-                    unsigned char *p = row + x * c;
-                    for (int k = 0; k < c; ++k)
-                        p[k] = border_pick_value(value, k);
+                    unsigned char *p = row + (size_t)x * esz;
+                    if (c <= 4)
+                        std::memcpy(p, fill_px, (size_t)esz);
+                    else
+                        for (int k = 0; k < c; ++k)
+                            border_encode_value(p + k * esz1, src.depth, border_pick_value(value, k));
                 }
             }
 
             // paste center
             for (int y = 0; y < src.height; ++y)
             {
-                unsigned char *drow = out.data + (y + top) * out.step + left * c;
-                const unsigned char *srow = src.data + y * src.step;
-                std::memcpy(drow, srow, (size_t)src.width * (size_t)c);
+                unsigned char *drow = out.data + (size_t)(y + top) * (size_t)out.step + (size_t)left * (size_t)esz;
+                const unsigned char *srow = src.data + (size_t)y * (size_t)src.step;
+                std::memcpy(drow, srow, (size_t)src.width * (size_t)esz);
             }
 
             dst = std::move(out);
@@ -384,17 +561,17 @@ namespace SimpleCV
         for (int y = 0; y < out.height; ++y)
         {
             const int sy = border_map_coord(y - top, src.height, borderType);
-            const unsigned char *srow = src.data + sy * src.step;
-            unsigned char *drow = out.data + y * out.step;
+            const unsigned char *srow = src.data + (size_t)sy * (size_t)src.step;
+            unsigned char *drow = out.data + (size_t)y * (size_t)out.step;
 
             for (int x = 0; x < out.width; ++x)
             {
                 const int sx = border_map_coord(x - left, src.width, borderType);
-                const unsigned char *sp = srow + sx * c;
-                unsigned char *dp = drow + x * c;
+                const unsigned char *sp = srow + (size_t)sx * esz;
+                unsigned char *dp = drow + (size_t)x * esz;
 
                 // copy pixel
-                for (int k = 0; k < c; ++k)
+                for (int k = 0; k < esz; ++k)
                     dp[k] = sp[k];
             }
         }
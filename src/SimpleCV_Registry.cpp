@@ -0,0 +1,111 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Registry.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace SimpleCV
+{
+    bool ImageCodec::decode(ByteSpan, Mat &, const CodecDecodeOptions &)
+    {
+        return false;
+    }
+
+    bool ImageCodec::encode(const std::string &, const Mat &, EncodeWriteFn, void *, const ImwriteParams &)
+    {
+        return false;
+    }
+
+    namespace
+    {
+        struct Entry
+        {
+            std::shared_ptr<ImageCodec> codec;
+            int priority;
+            std::uint64_t seq;
+        };
+
+        struct Registry
+        {
+            std::mutex mtx;
+            std::vector<Entry> entries; // 按尝试顺序
+            std::uint64_t next_seq = 0;
+            std::atomic<bool> any{false};
+
+            Registry()
+            {
+#ifdef SIMPLECV_HAVE_LIBJPEG
+                add(detail::make_libjpeg_codec(), 0);
+#endif
+            }
+
+            void add(std::shared_ptr<ImageCodec> codec, int priority)
+            {
+                const std::string name = codec->name();
+                std::lock_guard<std::mutex> lk(mtx);
+                entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry &e)
+                                             { return name == e.codec->name(); }),
+                              entries.end());
+                entries.push_back(Entry{std::move(codec), priority, next_seq++});
+                std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+                                 { return a.priority != b.priority ? a.priority > b.priority : a.seq > b.seq; });
+                any.store(true, std::memory_order_release);
+            }
+        };
+
+        Registry &registry()
+        {
+            static Registry r;
+            return r;
+        }
+    }
+
+    void registerCodec(std::shared_ptr<ImageCodec> codec, int priority)
+    {
+        // "stb" 是内置兜底，不能被替换
+        if (!codec || !codec->name() || std::string(codec->name()) == "stb")
+            return;
+        registry().add(std::move(codec), priority);
+    }
+
+    bool unregisterCodec(const std::string &name)
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lk(r.mtx);
+        const size_t before = r.entries.size();
+        r.entries.erase(std::remove_if(r.entries.begin(), r.entries.end(), [&](const Entry &e)
+                                       { return name == e.codec->name(); }),
+                        r.entries.end());
+        r.any.store(!r.entries.empty(), std::memory_order_release);
+        return r.entries.size() != before;
+    }
+
+    std::vector<std::shared_ptr<ImageCodec>> getCodecs()
+    {
+        std::vector<std::shared_ptr<ImageCodec>> out = detail::external_codecs();
+        out.push_back(detail::stb_codec());
+        return out;
+    }
+
+    namespace detail
+    {
+        std::vector<std::shared_ptr<ImageCodec>> external_codecs()
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lk(r.mtx);
+            std::vector<std::shared_ptr<ImageCodec>> out;
+            out.reserve(r.entries.size());
+            for (const Entry &e : r.entries)
+                out.push_back(e.codec);
+            return out;
+        }
+
+        bool has_external_codecs()
+        {
+            return registry().any.load(std::memory_order_acquire);
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "SimpleCV.hpp"
+
+namespace SimpleCV
+{
+    namespace detail
+    {
+        // 已注册的后端（不含内置 stb），按尝试顺序（SimpleCV_Registry.cpp）
+        std::vector<std::shared_ptr<ImageCodec>> external_codecs();
+        // 没有外部后端时编解码直接走 stb，不碰锁
+        bool has_external_codecs();
+
+        // 内置 stb 后端（SimpleCV_Codec.cpp）
+        std::shared_ptr<ImageCodec> stb_codec();
+
+#ifdef SIMPLECV_HAVE_LIBJPEG
+        // 编译时找到 libjpeg 时自带的 JPEG 后端（SimpleCV_LibJpeg.cpp）
+        std::shared_ptr<ImageCodec> make_libjpeg_codec();
+#endif
+    }
+}
@@ -149,7 +149,7 @@ namespace SimpleCV
                               int /*lineType*/,
                               bool bottomLeftOrigin)
     {
-        if (img.empty() || !img.data || text.empty())
+        if (img.empty() || !img.data || img.depth != Depth::U8 || text.empty())
             return;
 
         int scale = (int)std::lround(std::max(1.0, fontScale));
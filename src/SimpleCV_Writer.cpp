@@ -0,0 +1,181 @@
+#include "SimpleCV.hpp"
+#include "SimpleCV_Parallel.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SimpleCV
+{
+    struct AsyncImageWriter::Impl
+    {
+        struct Task
+        {
+            std::string filename;
+            Mat mat; // 与调用方共享引用计数
+            ImwriteParams params;
+        };
+
+        mutable std::mutex mtx;
+        std::condition_variable not_empty; // 有任务或要退出
+        std::condition_variable not_full;  // 队列有空位或已关闭
+        std::condition_variable idle;      // 队列空且没有正在编码的任务
+        std::deque<Task> queue;
+        std::vector<AsyncWriteError> errors;
+        std::vector<std::thread> threads;
+        std::size_t capacity = 16;
+        AsyncWritePolicy policy = AsyncWritePolicy::BLOCK;
+        MatAllocator *alloc = nullptr;
+        int busy = 0;
+        bool closed = false; // 不再接受 write
+        bool stop = false;   // 工作线程在队列取空后退出
+
+        void worker()
+        {
+            // 工作线程沿用创建者线程的分配器
+            if (getDefaultAllocator() != alloc)
+                setThreadAllocator(alloc);
+
+            for (;;)
+            {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lk(mtx);
+                    not_empty.wait(lk, [&]()
+                                   { return stop || !queue.empty(); });
+                    if (queue.empty())
+                        break;
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                    ++busy;
+                }
+                not_full.notify_one();
+
+                std::string err;
+                // 格式/depth 是否可写由 imwrite 判断（如 16 位 PNM、float PFM）
+                // 异常不能逃出工作线程（否则 std::terminate），也不能跳过下面的 busy 计数
+                try
+                {
+                    if (task.mat.empty())
+                        err = "empty Mat";
+                    else if (!imwrite(task.filename, task.mat, task.params))
+                        err = "encode or write failed";
+                }
+                catch (const std::exception &e)
+                {
+                    err = std::string("exception: ") + e.what();
+                }
+                catch (...)
+                {
+                    err = "exception";
+                }
+                task.mat.release(); // 尽早归还像素的引用
+
+                std::lock_guard<std::mutex> lk(mtx);
+                if (!err.empty())
+                    errors.push_back(AsyncWriteError{task.filename, std::move(err)});
+                if (--busy == 0 && queue.empty())
+                    idle.notify_all();
+            }
+            setThreadAllocator(nullptr);
+        }
+
+        std::vector<AsyncWriteError> wait_idle()
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            idle.wait(lk, [&]()
+                      { return queue.empty() && busy == 0; });
+            std::vector<AsyncWriteError> out;
+            out.swap(errors);
+            return out;
+        }
+    };
+
+    AsyncImageWriter::AsyncImageWriter(const AsyncWriterParams &params)
+        : impl_(new Impl())
+    {
+        impl_->capacity = (std::size_t)std::max(1, params.queue_capacity);
+        impl_->policy = params.policy;
+        impl_->alloc = getDefaultAllocator();
+        const int n = resolve_num_threads(params.num_threads, INT_MAX);
+        impl_->threads.reserve((size_t)n);
+        for (int i = 0; i < n; ++i)
+            impl_->threads.emplace_back([this]()
+                                        { impl_->worker(); });
+    }
+
+    AsyncImageWriter::~AsyncImageWriter()
+    {
+        close();
+        delete impl_;
+    }
+
+    bool AsyncImageWriter::write(const std::string &filename, const Mat &mat, const ImwriteParams &params)
+    {
+        {
+            std::unique_lock<std::mutex> lk(impl_->mtx);
+            if (impl_->closed)
+                return false;
+            if (impl_->queue.size() >= impl_->capacity)
+            {
+                switch (impl_->policy)
+                {
+                case AsyncWritePolicy::BLOCK:
+                    impl_->not_full.wait(lk, [&]()
+                                         { return impl_->closed || impl_->queue.size() < impl_->capacity; });
+                    if (impl_->closed)
+                        return false;
+                    break;
+                case AsyncWritePolicy::DROP_NEWEST:
+                    return false;
+                case AsyncWritePolicy::DROP_OLDEST:
+                    impl_->errors.push_back(AsyncWriteError{impl_->queue.front().filename, "dropped: queue full"});
+                    impl_->queue.pop_front();
+                    break;
+                }
+            }
+            impl_->queue.push_back(Impl::Task{filename, mat, params});
+        }
+        impl_->not_empty.notify_one();
+        return true;
+    }
+
+    std::vector<AsyncWriteError> AsyncImageWriter::flush()
+    {
+        return impl_->wait_idle();
+    }
+
+    std::vector<AsyncWriteError> AsyncImageWriter::close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(impl_->mtx);
+            impl_->closed = true;
+        }
+        impl_->not_full.notify_all();
+        std::vector<AsyncWriteError> errors = impl_->wait_idle();
+
+        // 在锁内把线程取走：并发/重复调用 close() 时只有一个调用者会 join
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lk(impl_->mtx);
+            impl_->stop = true;
+            threads.swap(impl_->threads);
+        }
+        impl_->not_empty.notify_all();
+        for (std::thread &t : threads)
+            t.join();
+        return errors;
+    }
+
+    std::size_t AsyncImageWriter::pending() const
+    {
+        std::lock_guard<std::mutex> lk(impl_->mtx);
+        return impl_->queue.size() + (std::size_t)impl_->busy;
+    }
+}
@@ -524,6 +524,10 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// SimpleCV: decode JPEGs on this thread at 1/(1<<shift) of full size (shift 0..3)
+// using reduced-size IDCTs; full-resolution component planes are never allocated
+STBIDEF void stbi_set_jpeg_scale_shift_thread(int shift);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -1134,6 +1138,18 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL
+#else
+static
+#endif
+int stbi__jpeg_scale_shift;
+
+STBIDEF void stbi_set_jpeg_scale_shift_thread(int shift)
+{
+   stbi__jpeg_scale_shift = shift < 0 ? 0 : shift > 3 ? 3 : shift;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1993,6 +2009,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift; // SimpleCV: each 8x8 block is reconstructed as (8>>scale_shift)^2 pixels
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2523,6 +2540,50 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// SimpleCV: reduced-size IDCT. Only the top-left n*n coefficients (n = 8>>shift) are
+// used, transformed with an n-point IDCT that keeps the 8-point normalization, so the
+// output approximates the block averaged down to n*n pixels (libjpeg's scaled decode).
+// Table entries are C(u)/2 * cos((2x+1)*u*pi/(2n)), indexed [x*n+u].
+static const float stbi__idct_cos2[4] = {
+   0.35355339f,  0.35355339f,
+   0.35355339f, -0.35355339f };
+static const float stbi__idct_cos4[16] = {
+   0.35355339f,  0.46193977f,  0.35355339f,  0.19134172f,
+   0.35355339f,  0.19134172f, -0.35355339f, -0.46193977f,
+   0.35355339f, -0.19134172f, -0.35355339f,  0.46193977f,
+   0.35355339f, -0.46193977f,  0.35355339f, -0.19134172f };
+
+// n x n reduced IDCT from the top-left n x n coefficients; n is a literal at
+// every call site so the loops fully unroll
+stbi_inline static void stbi__idct_reduced(stbi_uc *out, int out_stride, const short *data, const int n, const float *ct)
+{
+   int x, y, u, v;
+   float tmp[4][4];
+   for (v=0; v < n; ++v)
+      for (x=0; x < n; ++x) {
+         float t = 0;
+         for (u=0; u < n; ++u) t += ct[x*n+u] * data[v*8+u];
+         tmp[v][x] = t;
+      }
+   for (y=0; y < n; ++y)
+      for (x=0; x < n; ++x) {
+         float t = 128.5f;
+         for (v=0; v < n; ++v) t += ct[y*n+v] * tmp[v][x];
+         // t < 0 truncates toward zero but clamps to 0 either way
+         out[y*out_stride+x] = stbi__clamp((int) t);
+      }
+}
+
+static void stbi__idct_scaled(stbi_uc *out, int out_stride, short data[64], int shift)
+{
+   if (shift == 1)
+      stbi__idct_reduced(out, out_stride, data, 4, stbi__idct_cos4);
+   else if (shift == 2)
+      stbi__idct_reduced(out, out_stride, data, 2, stbi__idct_cos2);
+   else // DC only: the block mean is F(0,0)/8, plus the level shift
+      out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2946,6 +3007,14 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+static void stbi__jpeg_idct(stbi__jpeg *z, stbi_uc *out, int out_stride, short data[64])
+{
+   if (z->scale_shift == 0)
+      z->idct_block_kernel(out, out_stride, data);
+   else
+      stbi__idct_scaled(out, out_stride, data, z->scale_shift);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2964,7 +3033,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, z->img_comp[n].data+((z->img_comp[n].w2*j*8+i*8) >> z->scale_shift), z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2992,7 +3061,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_idct(z, z->img_comp[n].data+((z->img_comp[n].w2*y2+x2) >> z->scale_shift), z->img_comp[n].w2, data);
                      }
                   }
                }
@@ -3089,7 +3158,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, z->img_comp[n].data+((z->img_comp[n].w2*j*8+i*8) >> z->scale_shift), z->img_comp[n].w2, data);
             }
          }
       }
@@ -3329,8 +3398,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      z->img_comp[i].w2 = (z->img_mcu_x * z->img_comp[i].h * 8) >> z->scale_shift;
+      z->img_comp[i].h2 = (z->img_mcu_y * z->img_comp[i].v * 8) >> z->scale_shift;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3340,10 +3409,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // one 8x8 coefficient block per block position, independent of scale_shift
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3873,6 +3942,18 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // SimpleCV: component planes were reconstructed at reduced size; from here on
+   // everything (resampling, color conversion, output) works at that size
+   if (z->scale_shift) {
+      int k, sh = z->scale_shift, round = (1 << sh) - 1;
+      z->s->img_x = (z->s->img_x + round) >> sh;
+      z->s->img_y = (z->s->img_y + round) >> sh;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].x = (z->img_comp[k].x + round) >> sh;
+         z->img_comp[k].y = (z->img_comp[k].y + round) >> sh;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -4033,6 +4114,7 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    memset(j, 0, sizeof(stbi__jpeg));
    STBI_NOTUSED(ri);
    j->s = s;
+   j->scale_shift = stbi__jpeg_scale_shift;
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
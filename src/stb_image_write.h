@@ -68,6 +68,8 @@ USAGE:
       int stbi_write_tga_with_rle;             // defaults to true; set to 0 to disable RLE
       int stbi_write_png_compression_level;    // defaults to 8; set to higher for more compression
       int stbi_write_force_png_filter;         // defaults to -1; set to 0..5 to force a filter mode
+      int stbi_write_row_stride;               // defaults to 0 (tightly packed); bytes between rows for bmp/tga/jpg
+      int stbi_write_swap_rb;                  // defaults to 0; set to 1 when 3/4-channel input is stored as BGR(A)
 
 
    You can define STBI_WRITE_NO_STDIO to disable the file variant of these
@@ -166,10 +168,28 @@ LICENSE
 #endif
 #endif
 
+// SimpleCV: the option globals below are set right before each encode call,
+// so they are per-thread to keep concurrent encodes from seeing each other's settings
+#ifndef STBIW_THREAD_LOCAL
+   #if defined(__cplusplus) && __cplusplus >= 201103L
+      #define STBIW_THREAD_LOCAL       thread_local
+   #elif defined(__GNUC__) && __GNUC__ < 5
+      #define STBIW_THREAD_LOCAL       __thread
+   #elif defined(_MSC_VER)
+      #define STBIW_THREAD_LOCAL       __declspec(thread)
+   #elif defined (__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBIW_THREAD_LOCAL       _Thread_local
+   #else
+      #define STBIW_THREAD_LOCAL
+   #endif
+#endif
+
 #ifndef STB_IMAGE_WRITE_STATIC  // C++ forbids static forward declarations
-STBIWDEF int stbi_write_tga_with_rle;
-STBIWDEF int stbi_write_png_compression_level;
-STBIWDEF int stbi_write_force_png_filter;
+STBIWDEF STBIW_THREAD_LOCAL int stbi_write_tga_with_rle;
+STBIWDEF STBIW_THREAD_LOCAL int stbi_write_png_compression_level;
+STBIWDEF STBIW_THREAD_LOCAL int stbi_write_force_png_filter;
+STBIWDEF STBIW_THREAD_LOCAL int stbi_write_row_stride;
+STBIWDEF STBIW_THREAD_LOCAL int stbi_write_swap_rb;
 #endif
 
 #ifndef STBI_WRITE_NO_STDIO
@@ -248,15 +268,26 @@ STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 #define STBIW_UCHAR(x) (unsigned char) ((x) & 0xff)
 
 #ifdef STB_IMAGE_WRITE_STATIC
-static int stbi_write_png_compression_level = 8;
-static int stbi_write_tga_with_rle = 1;
-static int stbi_write_force_png_filter = -1;
+static STBIW_THREAD_LOCAL int stbi_write_png_compression_level = 8;
+static STBIW_THREAD_LOCAL int stbi_write_tga_with_rle = 1;
+static STBIW_THREAD_LOCAL int stbi_write_force_png_filter = -1;
+static STBIW_THREAD_LOCAL int stbi_write_row_stride = 0;
+static STBIW_THREAD_LOCAL int stbi_write_swap_rb = 0;
 #else
-int stbi_write_png_compression_level = 8;
-int stbi_write_tga_with_rle = 1;
-int stbi_write_force_png_filter = -1;
+STBIW_THREAD_LOCAL int stbi_write_png_compression_level = 8;
+STBIW_THREAD_LOCAL int stbi_write_tga_with_rle = 1;
+STBIW_THREAD_LOCAL int stbi_write_force_png_filter = -1;
+STBIW_THREAD_LOCAL int stbi_write_row_stride = 0;
+STBIW_THREAD_LOCAL int stbi_write_swap_rb = 0;
 #endif
 
+// byte offset of row j for the 8-bit writers (bmp/tga/jpg)
+static size_t stbiw__row_offset(int j, int x, int comp)
+{
+   size_t stride = stbi_write_row_stride > 0 ? (size_t) stbi_write_row_stride : (size_t) x * comp;
+   return (size_t) j * stride;
+}
+
 static int stbi__flip_vertically_on_write = 0;
 
 STBIWDEF void stbi_flip_vertically_on_write(int flag)
@@ -420,6 +451,10 @@ static void stbiw__write_pixel(stbi__write_context *s, int rgb_dir, int comp, in
    unsigned char bg[3] = { 255, 0, 255}, px[3];
    int k;
 
+   // BGR(A) input: reading the channels in the opposite direction swaps R and B
+   if (stbi_write_swap_rb)
+      rgb_dir = -rgb_dir;
+
    if (write_alpha < 0)
       stbiw__write1(s, d[comp - 1]);
 
@@ -467,7 +502,7 @@ static void stbiw__write_pixels(stbi__write_context *s, int rgb_dir, int vdir, i
 
    for (; j != j_end; j += vdir) {
       for (i=0; i < x; ++i) {
-         unsigned char *d = (unsigned char *) data + (j*x+i)*comp;
+         unsigned char *d = (unsigned char *) data + stbiw__row_offset(j, x, comp) + i*comp;
          stbiw__write_pixel(s, rgb_dir, comp, write_alpha, expand_mono, d);
       }
       stbiw__write_flush(s);
@@ -557,7 +592,7 @@ static int stbi_write_tga_core(stbi__write_context *s, int x, int y, int comp, v
          jdir = -1;
       }
       for (; j != jend; j += jdir) {
-         unsigned char *row = (unsigned char *) data + j * x * comp;
+         unsigned char *row = (unsigned char *) data + stbiw__row_offset(j, x, comp);
          int len;
 
          for (i = 0; i < x; i += len) {
@@ -1169,6 +1204,15 @@ STBIWDEF unsigned char *stbi_write_png_to_mem(const unsigned char *pixels, int s
          }
       }
       // when we get here, filter_type contains the filter type, and line_buffer contains the data
+      // filters work per channel, so swapping R/B after filtering equals filtering swapped input
+      if (stbi_write_swap_rb && n >= 3) {
+         int i;
+         for (i = 0; i < x*n; i += n) {
+            signed char t = line_buffer[i];
+            line_buffer[i] = line_buffer[i+2];
+            line_buffer[i+2] = t;
+         }
+      }
       filt[j*(x*n+1)] = (unsigned char) filter_type;
       STBIW_MEMMOVE(filt+j*(x*n+1)+1, line_buffer, x*n);
    }
@@ -1525,10 +1569,11 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
       int DCY=0, DCU=0, DCV=0;
       int bitBuf=0, bitCnt=0;
       // comp == 2 is grey+alpha (alpha is ignored)
-      int ofsG = comp > 2 ? 1 : 0, ofsB = comp > 2 ? 2 : 0;
-      const unsigned char *dataR = (const unsigned char *)data;
-      const unsigned char *dataG = dataR + ofsG;
-      const unsigned char *dataB = dataR + ofsB;
+      int ofsR = (comp > 2 && stbi_write_swap_rb) ? 2 : 0;
+      int ofsG = comp > 2 ? 1 : 0, ofsB = comp > 2 ? 2 - ofsR : 0;
+      const unsigned char *dataR = (const unsigned char *)data + ofsR;
+      const unsigned char *dataG = (const unsigned char *)data + ofsG;
+      const unsigned char *dataB = (const unsigned char *)data + ofsB;
       int x, y, pos;
       if(subsample) {
          for(y = 0; y < height; y += 16) {
@@ -1537,10 +1582,10 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
                for(row = y, pos = 0; row < y+16; ++row) {
                   // row >= height => use last input row
                   int clamped_row = (row < height) ? row : height - 1;
-                  int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
+                  size_t base_p = stbiw__row_offset(stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row, width, comp);
                   for(col = x; col < x+16; ++col, ++pos) {
                      // if col >= width => use pixel from last input column
-                     int p = base_p + ((col < width) ? col : (width-1))*comp;
+                     size_t p = base_p + ((col < width) ? col : (width-1))*comp;
                      float r = dataR[p], g = dataG[p], b = dataB[p];
                      Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
                      U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
@@ -1575,10 +1620,10 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
                for(row = y, pos = 0; row < y+8; ++row) {
                   // row >= height => use last input row
                   int clamped_row = (row < height) ? row : height - 1;
-                  int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
+                  size_t base_p = stbiw__row_offset(stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row, width, comp);
                   for(col = x; col < x+8; ++col, ++pos) {
                      // if col >= width => use pixel from last input column
-                     int p = base_p + ((col < width) ? col : (width-1))*comp;
+                     size_t p = base_p + ((col < width) ? col : (width-1))*comp;
                      float r = dataR[p], g = dataG[p], b = dataB[p];
                      Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
                      U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
@@ -0,0 +1,109 @@
+#include "SimpleCV.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 对比各编解码后端（getCodecs() 列出的全部，含内置 stb）的编码/解码耗时
+// 用法: bench_codecs [image_path] [iterations]；不给图片（或传空串）时用 1920x1080 的合成图
+static double time_ms(int iters, const std::function<bool()> &fn)
+{
+    if (!fn()) // 预热，同时确认后端能处理
+        return -1.0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i)
+        fn();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count() / iters;
+}
+
+static void append(void *ctx, const void *data, std::size_t size)
+{
+    auto *v = static_cast<std::vector<unsigned char> *>(ctx);
+    v->insert(v->end(), static_cast<const unsigned char *>(data), static_cast<const unsigned char *>(data) + size);
+}
+
+int main(int argc, char *argv[])
+{
+    SimpleCV::Mat img;
+    if (argc > 1 && argv[1][0])
+        img = SimpleCV::imread(argv[1], SimpleCV::ColorSpace::RGB);
+    else
+    {
+        // 平滑渐变 + 少量噪声，接近照片的压缩难度
+        img = SimpleCV::Mat(1080, 1920, 3);
+        unsigned state = 1;
+        for (int y = 0; y < img.height; ++y)
+            for (int x = 0; x < img.width * 3; ++x)
+            {
+                state = state * 1103515245u + 12345u;
+                img.data[y * img.step + x] = static_cast<unsigned char>((x / 3 + y) / 4 + (x % 3) * 40 + (state >> 29));
+            }
+    }
+    if (img.empty())
+    {
+        std::fprintf(stderr, "Failed to read image\n");
+        return -1;
+    }
+    const int iters = argc > 2 ? std::atoi(argv[2]) : 10;
+    const double mpix = img.width * (double)img.height / 1e6;
+    std::printf("image %dx%d, %d iterations\n", img.width, img.height, iters);
+    std::printf("%-10s %-5s %-14s %10s %10s %10s\n", "codec", "fmt", "op", "ms", "MPix/s", "bytes");
+
+    const char *exts[] = {"jpg", "png"};
+    for (const std::shared_ptr<SimpleCV::ImageCodec> &codec : SimpleCV::getCodecs())
+    {
+        const SimpleCV::CodecCaps caps = codec->caps();
+        for (const char *ext : exts)
+        {
+            if (!codec->matchesExtension(ext))
+                continue;
+
+            // 编码输入统一由 stb 产生，解码对比的是同一份文件
+            std::vector<unsigned char> file;
+            SimpleCV::imencode(std::string(".") + ext, img, file);
+            if (!codec->matchesMagic(file.data(), std::min<std::size_t>(file.size(), 16)))
+                continue;
+
+            std::vector<unsigned char> out;
+            auto report = [&](const char *op, double ms, double pixels, std::size_t bytes)
+            {
+                if (ms < 0)
+                    return;
+                std::printf("%-10s %-5s %-14s %10.2f %10.1f %10zu\n", codec->name(), ext, op, ms,
+                            pixels / (ms / 1000.0), bytes);
+            };
+
+            if (caps.encode)
+            {
+                const double ms = time_ms(iters, [&]()
+                                          {
+                    out.clear();
+                    return codec->encode(ext, img, append, &out, SimpleCV::ImwriteParams()); });
+                report("encode", ms, mpix, out.size());
+            }
+            if (caps.decode)
+            {
+                SimpleCV::Mat dst;
+                SimpleCV::CodecDecodeOptions opts;
+                opts.flag = SimpleCV::ColorSpace::RGB;
+                report("decode", time_ms(iters, [&]()
+                                         { return codec->decode(file, dst, opts); }),
+                       mpix, file.size());
+                if (caps.scaled_decode && std::strcmp(ext, "jpg") == 0)
+                {
+                    opts.scale = 4;
+                    report("decode 1/4", time_ms(iters, [&]()
+                                                 { return codec->decode(file, dst, opts); }),
+                           mpix, file.size());
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,10 +1,20 @@
 #include "SimpleCV.hpp"
 
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -16,6 +26,8 @@ namespace fs = std::filesystem;
     } \
   } while(0)
 
+#define SC_UNUSED(x) (void)(x)
+
 static bool bytes_equal(const unsigned char* a, const unsigned char* b, size_t n)
 {
   return std::memcmp(a, b, n) == 0;
@@ -160,6 +172,1834 @@ static bool test_imwrite_imread_flags()
   return true;
 }
 
+static bool test_pool_allocator_reuse()
+{
+  SimpleCV::PoolMatAllocator pool;
+  SimpleCV::setThreadAllocator(&pool);
+
+  const unsigned char* first = nullptr;
+  {
+    SimpleCV::Mat a(48, 64, 3);
+    first = a.data;
+  }
+  // 同尺寸再次申请：命中缓存，不触碰系统堆
+  for (int i = 0; i < 10; ++i)
+  {
+    SimpleCV::Mat a(48, 64, 3);
+    SC_ASSERT(a.data == first);
+  }
+  SimpleCV::MatAllocatorStats st = pool.stats();
+  SC_ASSERT(st.misses == 2); // 像素缓冲区 + shared_ptr 控制块
+  SC_ASSERT(st.hits == 20);
+  SC_ASSERT(st.live_blocks == 0);
+  SC_ASSERT(st.cached_blocks == 2);
+
+  // 稍小的尺寸落在同一 size class
+  {
+    SimpleCV::Mat b(48, 63, 3);
+    SC_ASSERT(b.data == first);
+  }
+
+  // 线程级设置优先于全局设置；取消后回到全局默认
+  SimpleCV::setThreadAllocator(nullptr);
+  SC_ASSERT(SimpleCV::getDefaultAllocator() == SimpleCV::getStdAllocator());
+  SimpleCV::setDefaultAllocator(SimpleCV::getPoolAllocator());
+  SC_ASSERT(SimpleCV::getDefaultAllocator() == SimpleCV::getPoolAllocator());
+  SimpleCV::setDefaultAllocator(nullptr);
+
+  pool.trim();
+  SC_ASSERT(pool.stats().cached_bytes == 0);
+
+  // 调低缓存上限只释放超出的部分，从最大的档开始
+  SimpleCV::PoolMatAllocator small_pool;
+  const std::size_t sizes[] = {64, 1000, 100000};
+  void* blocks[3];
+  for (int i = 0; i < 3; ++i)
+    blocks[i] = small_pool.allocate(sizes[i]);
+  for (int i = 0; i < 3; ++i)
+    small_pool.deallocate(blocks[i], sizes[i]);
+  const std::size_t cached = small_pool.stats().cached_bytes;
+  SC_ASSERT(small_pool.stats().cached_blocks == 3 && cached >= 64 + 1000 + 100000);
+  small_pool.setMaxCachedBytes(cached - 1);
+  st = small_pool.stats();
+  SC_ASSERT(st.cached_blocks == 2 && st.cached_bytes < 2048);
+  small_pool.resetStats();
+  for (int i = 0; i < 2; ++i)
+    small_pool.deallocate(small_pool.allocate(sizes[i]), sizes[i]);
+  SC_ASSERT(small_pool.stats().hits == 2 && small_pool.stats().misses == 0);
+  small_pool.setMaxCachedBytes(0);
+  SC_ASSERT(small_pool.stats().cached_blocks == 0 && small_pool.stats().cached_bytes == 0);
+  return true;
+}
+
+static bool is_aligned_layout(const SimpleCV::Mat& m)
+{
+  return reinterpret_cast<std::uintptr_t>(m.data) % SimpleCV::Mat::ALIGNMENT == 0 &&
+         m.step % SimpleCV::Mat::ALIGNMENT == 0 &&
+         m.stepMode() == SimpleCV::StepMode::ALIGNED;
+}
+
+static bool test_aligned_step_kept_by_kernels()
+{
+  SimpleCV::Mat rgb(7, 13, 3, SimpleCV::StepMode::ALIGNED);
+  SC_ASSERT(is_aligned_layout(rgb));
+  SC_ASSERT(rgb.step == 64);
+  fill_pattern_rgb(rgb);
+
+  SimpleCV::Mat r;
+  SimpleCV::resize(rgb, r, 30, 5);
+  SC_ASSERT(is_aligned_layout(r) && r.step == 128);
+
+  SimpleCV::Mat g = SimpleCV::cvtColor(rgb, SimpleCV::ColorSpace::GRAY, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(is_aligned_layout(g) && g.step == 64);
+
+  SimpleCV::Mat b;
+  SimpleCV::copyMakeBorder(rgb, b, 1, 1, 2, 2, SimpleCV::BorderType::REFLECT);
+  SC_ASSERT(is_aligned_layout(b) && b.step == 64);
+  const unsigned char* src_row = rgb.data + 3 * rgb.step;
+  const unsigned char* dst_row = b.data + 4 * b.step + 2 * 3;
+  SC_ASSERT(bytes_equal(src_row, dst_row, 13 * 3));
+
+  // 复用带 padding 的 dst：行尾 padding 不被改写
+  SimpleCV::Mat same(7, 13, 3, SimpleCV::StepMode::ALIGNED);
+  std::memset(same.data, 0xAB, static_cast<size_t>(same.height) * same.step);
+  unsigned char* keep = same.data;
+  SimpleCV::cvtColor(rgb, same, SimpleCV::ColorSpace::RGB, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(same.data == keep);
+  for (int y = 0; y < same.height; ++y)
+  {
+    SC_ASSERT(bytes_equal(same.data + y * same.step, rgb.data + y * rgb.step, 13 * 3));
+    SC_ASSERT(same.data[y * same.step + 13 * 3] == 0xAB);
+  }
+
+  // clone 不继承对齐 stride，得到紧密、连续的拷贝
+  SimpleCV::Mat c = rgb.clone();
+  SC_ASSERT(c.isContinuous() && c.step == 39 && c.stepMode() == SimpleCV::StepMode::PACKED);
+  SC_ASSERT(bytes_equal(c.data + 3 * c.step, rgb.data + 3 * rgb.step, 13 * 3));
+
+  // 默认仍然紧密存储
+  SimpleCV::Mat packed(7, 13, 3);
+  SC_ASSERT(packed.step == 39 && packed.stepMode() == SimpleCV::StepMode::PACKED);
+  SimpleCV::Mat pr;
+  SimpleCV::resize(packed, pr, 30, 5);
+  SC_ASSERT(pr.step == 90);
+  return true;
+}
+
+static bool test_roi_view_zero_copy()
+{
+  SimpleCV::Mat rgb(20, 30, 3);
+  fill_pattern_rgb(rgb);
+
+  SimpleCV::Mat roi = rgb(SimpleCV::Rect(5, 4, 10, 8));
+  SC_ASSERT(roi.width == 10 && roi.height == 8 && roi.step == rgb.step);
+  SC_ASSERT(roi.data == rgb.data + 4 * rgb.step + 5 * 3);
+  SC_ASSERT(!roi.isContinuous() && roi.isSubmatrix() && !rgb.isSubmatrix());
+  SC_ASSERT(roi.data[0] == 5 && roi.data[1] == 4);
+
+  SimpleCV::Size whole;
+  SimpleCV::Point ofs;
+  roi.locateROI(whole, ofs);
+  SC_ASSERT(whole.width == 30 && whole.height == 20 && ofs.x == 5 && ofs.y == 4);
+
+  // 向外扩展，越界部分被裁剪到父矩阵内（底部只能扩到第 20 行）
+  SimpleCV::Mat grown = roi;
+  grown.adjustROI(2, 100, 1, 1);
+  SC_ASSERT(grown.width == 12 && grown.height == 18);
+  grown.locateROI(whole, ofs);
+  SC_ASSERT(ofs.x == 4 && ofs.y == 2);
+
+  // 裁剪到图像范围
+  SimpleCV::Mat edge = rgb(SimpleCV::Rect(25, 15, 10, 10));
+  SC_ASSERT(edge.width == 5 && edge.height == 5);
+
+  // clone 得到紧密存储
+  SimpleCV::Mat c = roi.clone();
+  SC_ASSERT(c.isContinuous() && c.step == 30);
+  SC_ASSERT(c.data[0] == 5 && c.data[1] == 4);
+
+  // crop -> resize -> encode -> decode
+  SimpleCV::Mat same;
+  SimpleCV::resize(roi, same, roi.width, roi.height);
+  SC_ASSERT(bytes_equal(same.data, c.data, static_cast<size_t>(c.height) * c.step));
+  std::vector<unsigned char> buf;
+  SC_ASSERT(SimpleCV::imencode(roi, buf));
+  auto dec = SimpleCV::imdecode(buf, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(dec.width == 10 && dec.height == 8);
+  SC_ASSERT(bytes_equal(dec.data, c.data, static_cast<size_t>(c.height) * c.step));
+
+  // cvtColor/copyMakeBorder 读取视图
+  auto bgr = SimpleCV::cvtColor(roi, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(bgr.data[0] == c.data[2] && bgr.data[2] == c.data[0]);
+  SimpleCV::Mat bordered;
+  SimpleCV::copyMakeBorder(roi, bordered, 1, 1, 1, 1, SimpleCV::BorderType::REPLICATE);
+  SC_ASSERT(bordered.data[0] == 5 && bordered.data[1] == 4);
+
+  // 在视图上绘制会写回父矩阵
+  SimpleCV::rectangle(roi, SimpleCV::Rect(0, 0, 2, 2), SimpleCV::Scalar(1, 2, 3), -1);
+  const unsigned char* p = rgb.data + 5 * rgb.step + 6 * 3;
+  SC_ASSERT(p[0] == 1 && p[1] == 2 && p[2] == 3);
+
+  // bmp 写入非连续视图
+  fs::path out = fs::current_path() / "simplecv_test_roi.bmp";
+  SC_ASSERT(SimpleCV::imwrite(out.string(), roi));
+  auto r = SimpleCV::imread(out.string(), SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(r.width == 10 && r.height == 8);
+  SC_ASSERT(bytes_equal(r.data + 2 * r.step, roi.data + 2 * roi.step, 30));
+  std::error_code ec;
+  fs::remove(out, ec);
+  return true;
+}
+
+static bool test_multi_depth_decode_and_proc()
+{
+  // 16 位 PGM：2x1，像素 0x1234 / 0xABCD（大端）
+  const std::string pgm = std::string("P5\n2 1\n65535\n") + "\x12\x34\xAB\xCD";
+  std::vector<unsigned char> buf(pgm.begin(), pgm.end());
+
+  auto u16 = SimpleCV::imdecode(buf, SimpleCV::ColorSpace::GRAY, SimpleCV::Depth::U16);
+  SC_ASSERT(u16.depth == SimpleCV::Depth::U16 && u16.channels == 1 && u16.width == 2);
+  SC_ASSERT(u16.elemSize() == 2 && u16.step == 4);
+  SC_ASSERT(u16.ptr<uint16_t>(0)[0] == 0x1234 && u16.ptr<uint16_t>(0)[1] == 0xABCD);
+
+  auto f32 = SimpleCV::imdecode(buf, SimpleCV::ColorSpace::GRAY, SimpleCV::Depth::F32);
+  SC_ASSERT(f32.depth == SimpleCV::Depth::F32);
+  SC_ASSERT(std::fabs(f32.ptr<float>(0)[1] - 0xABCD / 65535.0f) < 1e-6f);
+
+  auto u8 = SimpleCV::imdecode(buf, SimpleCV::ColorSpace::GRAY);
+  SC_ASSERT(u8.depth == SimpleCV::Depth::U8 && u8.data[1] == 0xAB);
+
+  // U16 GRAY -> BGRA：alpha 取 65535
+  auto bgra = SimpleCV::cvtColor(u16, SimpleCV::ColorSpace::BGRA, SimpleCV::ColorSpace::GRAY);
+  SC_ASSERT(bgra.depth == SimpleCV::Depth::U16 && bgra.channels == 4);
+  SC_ASSERT(bgra.ptr<uint16_t>(0)[4] == 0xABCD && bgra.ptr<uint16_t>(0)[7] == 65535);
+
+  // float RGB -> GRAY
+  SimpleCV::Mat rgbf(1, 1, 3, SimpleCV::Depth::F32);
+  rgbf.ptr<float>(0)[0] = 1.0f;
+  rgbf.ptr<float>(0)[1] = 0.5f;
+  rgbf.ptr<float>(0)[2] = 0.25f;
+  auto grayf = SimpleCV::cvtColor(rgbf, SimpleCV::ColorSpace::GRAY, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(std::fabs(grayf.ptr<float>(0)[0] - (0.299f + 0.587f * 0.5f + 0.114f * 0.25f)) < 1e-6f);
+
+  // half 的往返与舍入
+  SC_ASSERT(static_cast<float>(SimpleCV::float16(0.5f)) == 0.5f);
+  SC_ASSERT(SimpleCV::float16(1.0f).bits == 0x3C00);
+  SC_ASSERT(SimpleCV::float16(-2.0f).bits == 0xC000);
+  SC_ASSERT(SimpleCV::float16(65504.0f).bits == 0x7BFF);
+  SC_ASSERT(SimpleCV::float16(1e6f).bits == 0x7C00);
+  SC_ASSERT(static_cast<float>(SimpleCV::float16(5.9604645e-8f)) == 5.9604645e-8f); // 最小非规格化数
+
+  // resize 保持 depth；常数图缩放后仍为常数
+  for (SimpleCV::Depth d : {SimpleCV::Depth::U16, SimpleCV::Depth::F16, SimpleCV::Depth::F32})
+  {
+    SimpleCV::Mat m(8, 8, 3, d);
+    for (int y = 0; y < m.height; ++y)
+      for (int x = 0; x < m.width * 3; ++x)
+      {
+        if (d == SimpleCV::Depth::U16) m.ptr<uint16_t>(y)[x] = 40000;
+        else if (d == SimpleCV::Depth::F16) m.ptr<SimpleCV::float16>(y)[x] = SimpleCV::float16(0.75f);
+        else m.ptr<float>(y)[x] = 0.75f;
+      }
+    SimpleCV::Mat r;
+    SimpleCV::resize(m, r, 5, 3);
+    SC_ASSERT(r.depth == d && r.width == 5 && r.height == 3 && r.step == 5 * 3 * m.elemSize1());
+    if (d == SimpleCV::Depth::U16) SC_ASSERT(r.ptr<uint16_t>(2)[14] == 40000);
+    else if (d == SimpleCV::Depth::F16) SC_ASSERT(static_cast<float>(r.ptr<SimpleCV::float16>(2)[14]) == 0.75f);
+    else SC_ASSERT(std::fabs(r.ptr<float>(2)[14] - 0.75f) < 1e-6f);
+
+    // clone / ROI 按像素字节数计算
+    SimpleCV::Mat roi = m(SimpleCV::Rect(2, 1, 3, 3));
+    SC_ASSERT(roi.data == m.data + m.step + 2 * m.elemSize());
+    SimpleCV::Mat c = roi.clone();
+    SC_ASSERT(c.isContinuous() && c.depth == d && c.step == 3 * m.elemSize());
+
+    SimpleCV::Mat b;
+    SimpleCV::copyMakeBorder(m, b, 1, 0, 0, 0, SimpleCV::BorderType::CONSTANT, {7});
+    SC_ASSERT(b.depth == d);
+    if (d == SimpleCV::Depth::U16) SC_ASSERT(b.ptr<uint16_t>(0)[0] == 7 * 257 && b.ptr<uint16_t>(1)[0] == 40000);
+    if (d == SimpleCV::Depth::F32) SC_ASSERT(b.ptr<float>(0)[0] == 7 / 255.0f && b.ptr<float>(1)[0] == 0.75f);
+
+    // 默认填充值的 alpha 在各 depth 下都是不透明
+    SimpleCV::Mat m4(2, 2, 4, d);
+    SimpleCV::copyMakeBorder(m4, b, 0, 0, 1, 0);
+    if (d == SimpleCV::Depth::U16) SC_ASSERT(b.ptr<uint16_t>(0)[3] == 65535);
+    else if (d == SimpleCV::Depth::F16) SC_ASSERT(static_cast<float>(b.ptr<SimpleCV::float16>(0)[3]) == 1.0f);
+    else SC_ASSERT(b.ptr<float>(0)[3] == 1.0f);
+  }
+
+  // 非 U8 不能直接编码
+  std::vector<unsigned char> out;
+  SC_ASSERT(!SimpleCV::imencode(u16, out));
+
+  // 行字节数乘上 depth 大小后超出 int：按分配失败抛出，而不是绕回成一个很小的行
+  auto throws_bad_alloc = [](int h, int w, int c, SimpleCV::Depth d, SimpleCV::StepMode mode)
+  {
+    try { SimpleCV::Mat m(h, w, c, d, mode); }
+    catch (const std::bad_alloc&) { return true; }
+    return false;
+  };
+  SC_ASSERT(throws_bad_alloc(1, 1073741840, 1, SimpleCV::Depth::F32, SimpleCV::StepMode::PACKED));
+  SC_ASSERT(throws_bad_alloc(1, 65536, 65536, SimpleCV::Depth::U8, SimpleCV::StepMode::PACKED));
+  SC_ASSERT(throws_bad_alloc(1, INT_MAX - 10, 1, SimpleCV::Depth::U8, SimpleCV::StepMode::ALIGNED));
+  SC_ASSERT(SimpleCV::Mat::alignStep(INT_MAX - 10) == -1 && SimpleCV::Mat::alignStep(65) == 128);
+  return true;
+}
+
+static bool test_blob_from_image_nchw()
+{
+  SimpleCV::Mat bgr(3, 4, 3);
+  fill_pattern_rgb(bgr); // 当作 BGR：B = x, G = y, R = x+y
+
+  SimpleCV::BlobParams p;
+  p.scale = 1.0f / 255.0f;
+  p.mean[0] = 0.485f; p.mean[1] = 0.456f; p.mean[2] = 0.406f;
+  p.std[0] = 0.229f;  p.std[1] = 0.224f;  p.std[2] = 0.225f;
+  p.swapRB = true;
+
+  std::vector<float> blob(3 * 3 * 4);
+  SC_ASSERT(SimpleCV::blobFromImage(bgr, blob.data(), p));
+  for (int y = 0; y < 3; ++y)
+    for (int x = 0; x < 4; ++x)
+    {
+      const float r = (x + y) / 255.0f, g = y / 255.0f, b = x / 255.0f;
+      SC_ASSERT(std::fabs(blob[0 * 12 + y * 4 + x] - (r - 0.485f) / 0.229f) < 1e-5f);
+      SC_ASSERT(std::fabs(blob[1 * 12 + y * 4 + x] - (g - 0.456f) / 0.224f) < 1e-5f);
+      SC_ASSERT(std::fabs(blob[2 * 12 + y * 4 + x] - (b - 0.406f) / 0.225f) < 1e-5f);
+    }
+
+  // ROI 视图 + 批量多线程：结果与逐张一致
+  std::vector<SimpleCV::Mat> batch;
+  SimpleCV::Mat big(10, 10, 3);
+  fill_pattern_rgb(big);
+  for (int i = 0; i < 5; ++i)
+    batch.push_back(big(SimpleCV::Rect(i, i, 4, 3)));
+  std::vector<float> nchw(5 * 3 * 3 * 4);
+  SC_ASSERT(SimpleCV::blobFromImages(batch, nchw.data(), p, 3));
+  for (int i = 0; i < 5; ++i)
+  {
+    std::vector<float> one(3 * 3 * 4);
+    SC_ASSERT(SimpleCV::blobFromImage(batch[i], one.data(), p));
+    SC_ASSERT(std::memcmp(one.data(), nchw.data() + i * 36, 36 * sizeof(float)) == 0);
+  }
+
+  // 指定输出尺寸时先 resize
+  p.size = SimpleCV::Size(2, 2);
+  std::vector<float> small(3 * 2 * 2);
+  SC_ASSERT(SimpleCV::blobFromImage(bgr, small.data(), p));
+
+  // 尺寸不一致且未指定 size：拒绝
+  batch.push_back(big);
+  p.size = SimpleCV::Size(0, 0);
+  SC_ASSERT(!SimpleCV::blobFromImages(batch, nchw.data(), p));
+
+  // 只给一边的 size 按未指定处理：尺寸不一致同样拒绝，一致时按原尺寸写
+  p.size = SimpleCV::Size(4, 0);
+  SC_ASSERT(!SimpleCV::blobFromImages(batch, nchw.data(), p));
+  batch.pop_back();
+  std::vector<float> half_set(5 * 3 * 3 * 4);
+  SC_ASSERT(SimpleCV::blobFromImages(batch, half_set.data(), p));
+  SC_ASSERT(half_set == nchw);
+
+  // 融合路径（SIMD 反交织 + 逐平面乘加）与朴素的三遍结果一致：
+  // cvtColor 交换 R/B -> 转 float 乘 scale -> 减 mean 除 std。宽度取奇数，覆盖 SIMD 块之后的尾部
+  p.size = SimpleCV::Size(0, 0);
+  p.mean[3] = 0.5f;
+  p.std[3] = 0.25f;
+  const int channel_counts[] = {1, 3, 4};
+  for (int c : channel_counts)
+  {
+    SimpleCV::Mat img(7, 77, c);
+    for (int y = 0; y < img.height; ++y)
+      for (int i = 0; i < img.width * c; ++i)
+        img.data[y * img.step + i] = static_cast<unsigned char>((i * 37 + y * 101) & 0xFF);
+    std::vector<float> fused(static_cast<size_t>(c) * 7 * 77);
+    SC_ASSERT(SimpleCV::blobFromImage(img(SimpleCV::Rect(0, 0, 77, 7)), fused.data(), p));
+
+    SimpleCV::Mat swapped = img;
+    if (c == 3)
+      swapped = SimpleCV::cvtColor(img, SimpleCV::ColorSpace::RGB, SimpleCV::ColorSpace::BGR);
+    else if (c == 4)
+      swapped = SimpleCV::cvtColor(img, SimpleCV::ColorSpace::RGBA, SimpleCV::ColorSpace::BGRA);
+    for (int k = 0; k < c; ++k)
+      for (int y = 0; y < 7; ++y)
+        for (int x = 0; x < 77; ++x)
+        {
+          const float v = swapped.data[y * swapped.step + x * c + k] * p.scale;
+          const float ref = (v - p.mean[k]) / p.std[k];
+          SC_ASSERT(std::fabs(fused[(static_cast<size_t>(k) * 7 + y) * 77 + x] - ref) < 1e-4f);
+        }
+  }
+  return true;
+}
+
+static int g_deleter_calls = 0;
+static void counting_deleter(void* data, void* ctx)
+{
+  SC_UNUSED(ctx);
+  ++g_deleter_calls;
+  delete[] static_cast<unsigned char*>(data);
+}
+
+static bool test_external_buffer_lifetime()
+{
+  // C 风格 deleter + context
+  g_deleter_calls = 0;
+  {
+    unsigned char* buf = new unsigned char[4 * 16];
+    SimpleCV::Mat roi;
+    {
+      SimpleCV::Mat m(4, 5, 3, SimpleCV::Depth::U8, buf, 16, counting_deleter, nullptr);
+      SC_ASSERT(m.data == buf && m.step == 16 && !m.isContinuous());
+      roi = m(SimpleCV::Rect(1, 1, 2, 2));
+    }
+    SC_ASSERT(g_deleter_calls == 0); // ROI 视图仍持有
+    SC_ASSERT(roi.data == buf + 16 + 3);
+  }
+  SC_ASSERT(g_deleter_calls == 1);
+
+  // shared_ptr<void> holder（例如包着 AVFrame 的智能指针）
+  auto frame = std::make_shared<std::vector<float>>(2 * 3);
+  std::weak_ptr<std::vector<float>> alive = frame;
+  {
+    SimpleCV::Mat m(2, 3, 1, SimpleCV::Depth::F32, frame->data(), 0, frame);
+    frame.reset();
+    SC_ASSERT(!alive.expired());
+    SC_ASSERT(m.step == 12 && m.depth == SimpleCV::Depth::F32);
+    SimpleCV::Mat copy = m;
+    m.release();
+    SC_ASSERT(!alive.expired());
+    copy.ptr<float>(1)[2] = 3.5f;
+    SC_ASSERT(alive.lock()->at(5) == 3.5f);
+  }
+  SC_ASSERT(alive.expired());
+  return true;
+}
+
+static bool test_mapped_pnm_npy_raw()
+{
+  fs::path ppm = fs::current_path() / "simplecv_test_map.ppm";
+  fs::path npy = fs::current_path() / "simplecv_test_map.npy";
+
+  // 新建映射文件，直接写像素
+  {
+    SimpleCV::Mat m = SimpleCV::createMappedPNM(ppm.string(), 3, 4, 3);
+    SC_ASSERT(!m.empty() && m.channels == 3);
+    fill_pattern_rgb(m);
+  }
+  {
+    SimpleCV::Mat m = SimpleCV::createMappedNpy(npy.string(), 2, 3, 1, SimpleCV::Depth::F32);
+    SC_ASSERT(!m.empty() && m.depth == SimpleCV::Depth::F32);
+    SC_ASSERT(reinterpret_cast<std::uintptr_t>(m.data) % 64 == 0);
+    for (int y = 0; y < 2; ++y)
+      for (int x = 0; x < 3; ++x)
+        m.ptr<float>(y)[x] = y * 10.0f + x;
+  }
+
+  // stb 解码结果应与映射内容一致
+  SimpleCV::Mat ref(3, 4, 3);
+  fill_pattern_rgb(ref);
+  auto dec = SimpleCV::imread(ppm.string(), SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(dec.height == 3 && dec.width == 4 && bytes_equal(dec.data, ref.data, 3 * 12));
+
+  // 只读映射：写时复制，不影响文件
+  {
+    SimpleCV::Mat m = SimpleCV::mapPNM(ppm.string());
+    SC_ASSERT(m.height == 3 && m.width == 4 && bytes_equal(m.data, ref.data, 3 * 12));
+    m.data[0] = 200;
+  }
+  SC_ASSERT(SimpleCV::mapPNM(ppm.string()).data[0] == ref.data[0]);
+
+  // 映射 Mat 的 ROI 视图保持映射存活
+  SimpleCV::Mat roi;
+  {
+    SimpleCV::Mat m = SimpleCV::mapNpy(npy.string());
+    SC_ASSERT(m.height == 2 && m.width == 3 && m.channels == 1 && m.depth == SimpleCV::Depth::F32);
+    roi = m(SimpleCV::Rect(1, 1, 2, 1));
+  }
+  SC_ASSERT(roi.ptr<float>(0)[1] == 12.0f);
+
+  // 裸映射：跳过 PPM 头，step 取整行
+  const size_t header = fs::file_size(ppm) - 3 * 12;
+  auto raw = SimpleCV::mapRaw(ppm.string(), 3, 4, 3, SimpleCV::Depth::U8, header);
+  SC_ASSERT(!raw.empty() && bytes_equal(raw.data, ref.data, 3 * 12));
+  SC_ASSERT(SimpleCV::mapRaw(ppm.string(), 4, 4, 3, SimpleCV::Depth::U8, header).empty());
+  // 行宽超出 int、通道数离谱、header 越过文件末尾：都拒绝，不切出越界的 Mat
+  SC_ASSERT(SimpleCV::mapRaw(ppm.string(), 1, 0x40000000, 1, SimpleCV::Depth::F32, 0).empty());
+  SC_ASSERT(SimpleCV::mapRaw(ppm.string(), 1, 1, 1, SimpleCV::Depth::U8, 0, static_cast<size_t>(1) << 31).empty());
+  SC_ASSERT(SimpleCV::mapRaw(ppm.string(), 1, 1, 1, SimpleCV::Depth::U8, SIZE_MAX).empty());
+  std::error_code ec;
+  fs::path huge = fs::current_path() / "simplecv_test_map_huge.raw";
+  SC_ASSERT(SimpleCV::createMappedRaw(huge.string(), 2, 0x7fffffff, 4, SimpleCV::Depth::F32).empty());
+  SC_ASSERT(!fs::exists(huge));
+
+  // shape (1, 65536, 65536) 的 u1：32 位 size_t 上 w*c 会绕回 0，这里按通道数直接拒绝
+  {
+    fs::path bad_npy = fs::current_path() / "simplecv_test_map_bad.npy";
+    std::string dict = "{'descr': '|u1', 'fortran_order': False, 'shape': (1, 65536, 65536), }";
+    dict.append((10 + dict.size() + 1 + 63) / 64 * 64 - 10 - dict.size() - 1, ' ');
+    dict.push_back('\n');
+    std::string file("\x93NUMPY\x01\x00", 8);
+    file.push_back(static_cast<char>(dict.size()));
+    file.push_back(0);
+    file += dict;
+    file.append(64, '\0');
+    std::FILE* f = std::fopen(bad_npy.string().c_str(), "wb");
+    SC_ASSERT(f);
+    std::fwrite(file.data(), 1, file.size(), f);
+    std::fclose(f);
+    SC_ASSERT(SimpleCV::mapNpy(bad_npy.string()).empty());
+    fs::remove(bad_npy, ec);
+  }
+
+  roi.release();
+  raw.release();
+  fs::remove(ppm, ec);
+  fs::remove(npy, ec);
+  return true;
+}
+
+static bool test_split_merge_planar()
+{
+  // 宽度 53 = 32 + 16 + 5，覆盖 AVX2 / SSE 主循环和标量收尾
+  const int h = 3, w = 53;
+  for (int c = 3; c <= 4; ++c)
+  {
+    SimpleCV::Mat src(h, w, c);
+    for (int y = 0; y < h; ++y)
+      for (int x = 0; x < w; ++x)
+        for (int k = 0; k < c; ++k)
+          src.ptr(y)[x * c + k] = static_cast<unsigned char>(x * 4 + k + y * 7);
+
+    std::vector<SimpleCV::Mat> planes;
+    SimpleCV::split(src, planes);
+    SC_ASSERT(static_cast<int>(planes.size()) == c);
+    for (int k = 0; k < c; ++k)
+      for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+          SC_ASSERT(planes[k].ptr(y)[x] == src.ptr(y)[x * c + k]);
+
+    SimpleCV::Mat back;
+    SimpleCV::merge(planes, back);
+    SC_ASSERT(back.channels == c && back.width == w);
+    for (int y = 0; y < h; ++y)
+      SC_ASSERT(bytes_equal(back.ptr(y), src.ptr(y), static_cast<size_t>(w) * c));
+  }
+
+  // 拆到调用方给的一整块 CHW 缓冲区里（平面为 ROI 视图，不重新分配）
+  SimpleCV::Mat bgra(h, w, 4);
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      for (int k = 0; k < 4; ++k)
+        bgra.ptr(y)[x * 4 + k] = static_cast<unsigned char>(k * 60 + x);
+  SimpleCV::Mat chw(3 * h, w, 1);
+  std::vector<SimpleCV::Mat> rgb;
+  for (int k = 0; k < 3; ++k)
+    rgb.push_back(chw(SimpleCV::Rect(0, k * h, w, h)));
+  SimpleCV::cvtColor(bgra, rgb, SimpleCV::ColorSpace::RGB, SimpleCV::ColorSpace::BGRA);
+  SC_ASSERT(rgb.size() == 3 && rgb[1].data == chw.data + static_cast<size_t>(h) * chw.step);
+  for (int k = 0; k < 3; ++k)
+    SC_ASSERT(rgb[k].ptr(1)[40] == static_cast<unsigned char>((2 - k) * 60 + 40));
+
+  // 宽类型走标量路径，补 alpha
+  SimpleCV::Mat f(2, 5, 3, SimpleCV::Depth::F32);
+  for (int y = 0; y < 2; ++y)
+    for (int x = 0; x < 15; ++x)
+      f.ptr<float>(y)[x] = static_cast<float>(x) + y * 0.5f;
+  std::vector<SimpleCV::Mat> fp;
+  SimpleCV::cvtColor(f, fp, SimpleCV::ColorSpace::BGRA, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(fp.size() == 4 && fp[0].depth == SimpleCV::Depth::F32);
+  SC_ASSERT(fp[0].ptr<float>(1)[2] == 8.5f && fp[2].ptr<float>(1)[2] == 6.5f && fp[3].ptr<float>(0)[4] == 1.0f);
+  return true;
+}
+
+static const SimpleCV::MemorySiteStats* find_site(const SimpleCV::MemorySnapshot& snap, const char* name)
+{
+  for (const auto& s : snap.sites)
+    if (s.site == name)
+      return &s;
+  return nullptr;
+}
+
+static bool test_memory_accounting()
+{
+  const size_t live0 = SimpleCV::getMemorySnapshot().live_bytes;
+  {
+    SimpleCV::MemoryScope scope("test_memory");
+    SimpleCV::Mat a(100, 100, 3);
+    SimpleCV::Mat b(10, 10, 1);
+    auto snap = SimpleCV::getMemorySnapshot();
+    const auto* site = find_site(snap, "test_memory");
+    SC_ASSERT(site && site->allocations == 2 && site->live_bytes == 30100);
+    SC_ASSERT(snap.live_bytes >= live0 + 30100);
+  }
+  auto snap = SimpleCV::getMemorySnapshot();
+  const auto* site = find_site(snap, "test_memory");
+  SC_ASSERT(site && site->deallocations == 2 && site->live_bytes == 0 && site->peak_bytes == 30100);
+  SC_ASSERT(snap.live_bytes == live0);
+
+  // 解码结果由 stb 分配，记在 imdecode 名下，随 Mat 释放归还
+  SimpleCV::Mat rgb(8, 6, 3);
+  fill_pattern_rgb(rgb);
+  std::vector<unsigned char> buf;
+  SC_ASSERT(SimpleCV::imencode(rgb, buf));
+  {
+    SimpleCV::Mat dec = SimpleCV::imdecode(buf, SimpleCV::ColorSpace::RGB);
+    const auto d_snap = SimpleCV::getMemorySnapshot();
+    const auto* d = find_site(d_snap, "imdecode");
+    SC_ASSERT(d && d->live_bytes == 8 * 6 * 3);
+
+    // resize：stbir 的临时缓冲区在返回前释放，只剩 dst
+    SimpleCV::Mat small;
+    SimpleCV::resize(dec, small, 3, 4);
+    const auto r_snap = SimpleCV::getMemorySnapshot();
+    const auto* r = find_site(r_snap, "resize");
+    SC_ASSERT(r && r->allocations >= 2 && r->live_bytes == 3 * 4 * 3 && r->peak_bytes > r->live_bytes);
+  }
+  SC_ASSERT(find_site(SimpleCV::getMemorySnapshot(), "imdecode")->live_bytes == 0);
+
+  SimpleCV::resetMemoryPeak();
+  SC_ASSERT(find_site(SimpleCV::getMemorySnapshot(), "test_memory")->peak_bytes == 0);
+  return true;
+}
+
+static void append_to_string(void* ctx, const void* data, size_t size)
+{
+  static_cast<std::string*>(ctx)->append(static_cast<const char*>(data), size);
+}
+
+static bool test_imdecode_span_and_encode_targets()
+{
+  SimpleCV::Mat rgb(5, 7, 3);
+  fill_pattern_rgb(rgb);
+
+  // 回调目标
+  std::string png;
+  SC_ASSERT(SimpleCV::imencode(rgb, append_to_string, &png));
+  SC_ASSERT(!png.empty());
+
+  // 从指针 + 长度 / string 直接解码
+  auto a = SimpleCV::imdecode(png.data(), png.size(), SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(a.height == 5 && a.width == 7 && bytes_equal(a.data, rgb.data, 5 * 21));
+  auto b = SimpleCV::imdecode(SimpleCV::ByteSpan(png), SimpleCV::ColorSpace::RGB, SimpleCV::Depth::U16);
+  SC_ASSERT(b.depth == SimpleCV::Depth::U16 && b.ptr<std::uint16_t>(1)[0] == rgb.ptr(1)[0] * 257);
+  SC_ASSERT(SimpleCV::imdecode(png.data(), 0).empty());
+
+  // 固定缓冲区：容量不足时报告所需大小
+  std::vector<unsigned char> small(8);
+  size_t written = 0;
+  SC_ASSERT(!SimpleCV::imencode(rgb, small.data(), small.size(), &written));
+  SC_ASSERT(written == png.size());
+  std::vector<unsigned char> fit(written);
+  SC_ASSERT(SimpleCV::imencode(rgb, fit.data(), fit.size(), &written));
+  SC_ASSERT(written == png.size() && std::memcmp(fit.data(), png.data(), written) == 0);
+  return true;
+}
+
+static bool test_decode_into_dst()
+{
+  SimpleCV::Mat rgb(5, 7, 3);
+  fill_pattern_rgb(rgb);
+  std::vector<unsigned char> png;
+  SC_ASSERT(SimpleCV::imencode(rgb, png));
+  auto expect_bgr = SimpleCV::cvtColor(rgb, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB);
+
+  // 紧密的预分配 dst：复用同一块缓冲区
+  SimpleCV::Mat dst(5, 7, 3);
+  unsigned char* before = dst.data;
+  SC_ASSERT(SimpleCV::imdecode(png, dst, SimpleCV::ColorSpace::BGR));
+  SC_ASSERT(dst.data == before && bytes_equal(dst.data, expect_bgr.data, 5 * 21));
+
+  // 带 stride 的 ROI 视图：只改写视图内的像素
+  SimpleCV::Mat canvas(12, 20, 3);
+  std::memset(canvas.data, 7, static_cast<size_t>(canvas.step) * canvas.height);
+  SimpleCV::Mat roi = canvas(SimpleCV::Rect(4, 3, 7, 5));
+  SC_ASSERT(SimpleCV::imdecode(png, roi, SimpleCV::ColorSpace::BGR));
+  SC_ASSERT(roi.data == canvas.data + 3 * canvas.step + 12);
+  for (int y = 0; y < 5; ++y)
+    SC_ASSERT(bytes_equal(roi.ptr(y), expect_bgr.ptr(y), 21));
+  SC_ASSERT(canvas.ptr(3)[11] == 7 && canvas.ptr(3)[12 + 21] == 7 && canvas.ptr(8)[12] == 7);
+
+  // 16 位 dst 走 depth 转换路径；尺寸不符时换成新缓冲区
+  SimpleCV::Mat d16(5, 7, 3, SimpleCV::Depth::U16);
+  before = d16.data;
+  SC_ASSERT(SimpleCV::imdecode(png, d16, SimpleCV::ColorSpace::RGB, SimpleCV::Depth::U16));
+  SC_ASSERT(d16.data == before && d16.ptr<std::uint16_t>(2)[4] == rgb.ptr(2)[4] * 257);
+  SimpleCV::Mat wrong(2, 2, 3);
+  SC_ASSERT(SimpleCV::imdecode(png, wrong, SimpleCV::ColorSpace::GRAY));
+  SC_ASSERT(wrong.height == 5 && wrong.width == 7 && wrong.channels == 1);
+
+  // 文件版本
+  fs::path out = fs::current_path() / "simplecv_test_into.png";
+  SC_ASSERT(SimpleCV::imwrite(out.string(), rgb));
+  SimpleCV::Mat f(5, 7, 3);
+  before = f.data;
+  SC_ASSERT(SimpleCV::imread(out.string(), f, SimpleCV::ColorSpace::RGB));
+  SC_ASSERT(f.data == before && bytes_equal(f.data, rgb.data, 5 * 21));
+  std::error_code ec;
+  fs::remove(out, ec);
+  SC_ASSERT(!SimpleCV::imread(out.string(), f));
+  return true;
+}
+
+static bool test_image_info_probe()
+{
+  SimpleCV::Mat rgba(9, 13, 4);
+  std::memset(rgba.data, 100, static_cast<size_t>(rgba.step) * rgba.height);
+  std::vector<unsigned char> png;
+  SC_ASSERT(SimpleCV::imencode(rgba, png));
+
+  auto info = SimpleCV::imdecodeInfo(png.data(), png.size());
+  SC_ASSERT(!info.empty() && info.width == 13 && info.height == 9 && info.channels == 4);
+  SC_ASSERT(info.bits == 8 && !info.hdr && info.format == SimpleCV::ImageFormat::PNG);
+
+  // 16 位 PGM（P5，maxval 65535）
+  fs::path pgm = fs::current_path() / "simplecv_test_info.pgm";
+  {
+    std::string bytes = "P5\n3 2\n65535\n";
+    bytes.append(3 * 2 * 2, '\x01');
+    FILE* f = std::fopen(pgm.string().c_str(), "wb");
+    SC_ASSERT(f != nullptr);
+    std::fwrite(bytes.data(), 1, bytes.size(), f);
+    std::fclose(f);
+  }
+  info = SimpleCV::imreadInfo(pgm.string());
+  SC_ASSERT(info.width == 3 && info.height == 2 && info.channels == 1 && info.bits == 16);
+  SC_ASSERT(info.format == SimpleCV::ImageFormat::PNM);
+  std::error_code ec;
+  fs::remove(pgm, ec);
+
+  SC_ASSERT(SimpleCV::imreadInfo(pgm.string()).empty());
+  SC_ASSERT(SimpleCV::imdecodeInfo(png.data(), 10).empty());
+  return true;
+}
+
+static bool test_reduced_jpeg_decode()
+{
+  // 平滑渐变，宽高都不是 8 的倍数
+  const int w = 53, h = 37;
+  SimpleCV::Mat rgb(h, w, 3);
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+    {
+      unsigned char* p = rgb.data + y * rgb.step + x * 3;
+      p[0] = static_cast<unsigned char>(40 + x * 3);
+      p[1] = static_cast<unsigned char>(30 + y * 4);
+      p[2] = static_cast<unsigned char>(200 - x - y);
+    }
+  fs::path jpg = fs::current_path() / "simplecv_test_reduced.jpg";
+  SC_ASSERT(SimpleCV::imwrite(jpg.string(), rgb));
+
+  SimpleCV::Mat full = SimpleCV::imread(jpg.string(), SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(full.width == w && full.height == h);
+
+  std::vector<unsigned char> bytes;
+  {
+    FILE* f = std::fopen(jpg.string().c_str(), "rb");
+    SC_ASSERT(f != nullptr);
+    unsigned char tmp[4096];
+    size_t n;
+    while ((n = std::fread(tmp, 1, sizeof(tmp), f)) > 0)
+      bytes.insert(bytes.end(), tmp, tmp + n);
+    std::fclose(f);
+  }
+
+  for (int scale : {1, 2, 4, 8})
+  {
+    SimpleCV::Mat small = SimpleCV::imdecodeReduced(bytes, scale, SimpleCV::ColorSpace::RGB);
+    const int sw = (w + scale - 1) / scale, sh = (h + scale - 1) / scale;
+    SC_ASSERT(small.width == sw && small.height == sh && small.channels == 3);
+
+    // 与全尺寸解码的块均值比较
+    double sum = 0;
+    int cnt = 0;
+    for (int y = 0; y < sh; ++y)
+      for (int x = 0; x < sw; ++x)
+        for (int c = 0; c < 3; ++c)
+        {
+          int acc = 0, n = 0;
+          for (int yy = y * scale; yy < std::min(h, (y + 1) * scale); ++yy)
+            for (int xx = x * scale; xx < std::min(w, (x + 1) * scale); ++xx, ++n)
+              acc += full.data[yy * full.step + xx * 3 + c];
+          const int d = std::abs(acc / n - small.data[y * small.step + x * 3 + c]);
+          SC_ASSERT(d <= 24);
+          sum += d;
+          ++cnt;
+        }
+    SC_ASSERT(sum / cnt < 4.0);
+  }
+
+  // BGR 与按文件读取走同一条路径
+  SimpleCV::Mat bgr = SimpleCV::imreadReduced(jpg.string(), 4, SimpleCV::ColorSpace::BGR);
+  SimpleCV::Mat rgb4 = SimpleCV::imdecodeReduced(bytes, 4, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(bgr.width == rgb4.width && bgr.height == rgb4.height);
+  SC_ASSERT(bgr.data[3 * bgr.step] == rgb4.data[3 * rgb4.step + 2]);
+
+  // 非 JPEG 全尺寸解码后缩小；非法比例返回空
+  std::vector<unsigned char> png;
+  SC_ASSERT(SimpleCV::imencode(rgb, png));
+  SimpleCV::Mat png2 = SimpleCV::imdecodeReduced(png, 2);
+  SC_ASSERT(png2.width == 27 && png2.height == 19 && png2.channels == 3);
+  SC_ASSERT(SimpleCV::imdecodeReduced(bytes, 3).empty());
+
+  std::error_code ec;
+  fs::remove(jpg, ec);
+  return true;
+}
+
+// 测试用后端：认得 "THRW" 开头的输入，解码时抛出异常
+struct ThrowingTestCodec : SimpleCV::ImageCodec
+{
+  const char* name() const override { return "throw-test"; }
+  SimpleCV::CodecCaps caps() const override
+  {
+    SimpleCV::CodecCaps c;
+    c.decode = true;
+    return c;
+  }
+  bool matchesMagic(const unsigned char* head, std::size_t n) const override
+  {
+    return n >= 4 && std::memcmp(head, "THRW", 4) == 0;
+  }
+  bool matchesExtension(const std::string&) const override { return false; }
+  bool decode(SimpleCV::ByteSpan, SimpleCV::Mat&, const SimpleCV::CodecDecodeOptions&) override
+  {
+    throw std::runtime_error("throw-test");
+  }
+};
+
+static bool test_batch_decode()
+{
+  // 尺寸各不相同，第 3 项是坏数据
+  std::vector<std::vector<unsigned char>> encoded(6);
+  for (int i = 0; i < 6; ++i)
+  {
+    SimpleCV::Mat m(5 + i, 7 + 2 * i, 3);
+    std::memset(m.data, 10 * i + 1, static_cast<size_t>(m.step) * m.height);
+    SC_ASSERT(SimpleCV::imencode(m, encoded[i]));
+  }
+  encoded[3].resize(12);
+
+  std::vector<SimpleCV::ByteSpan> spans;
+  for (const auto& e : encoded)
+    spans.emplace_back(e);
+
+  std::vector<SimpleCV::Mat> out;
+  std::vector<std::string> errors;
+  const int n = SimpleCV::imdecodeBatch(spans, out, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U8, 4, &errors);
+  SC_ASSERT(n == 5 && out.size() == 6 && errors.size() == 6);
+  for (int i = 0; i < 6; ++i)
+  {
+    if (i == 3)
+    {
+      SC_ASSERT(out[i].empty() && !errors[i].empty());
+      continue;
+    }
+    SC_ASSERT(errors[i].empty());
+    SC_ASSERT(out[i].height == 5 + i && out[i].width == 7 + 2 * i && out[i].channels == 3);
+    SC_ASSERT(out[i].data[0] == 10 * i + 1);
+  }
+
+  // 再跑一次：尺寸一致的结果直接写进上次的缓冲区
+  const unsigned char* reused = out[5].data;
+  SC_ASSERT(SimpleCV::imdecodeBatch(spans, out, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U8, 2) == 5);
+  SC_ASSERT(out[5].data == reused);
+
+  // 单线程依次：坏 PNG 之后的截断 PPM 报自己的错，不沿用上一项留下的失败原因
+  std::vector<unsigned char> ppm;
+  SC_ASSERT(SimpleCV::imencode(".ppm", SimpleCV::Mat(4, 4, 3), ppm));
+  ppm.resize(ppm.size() - 5);
+  std::vector<SimpleCV::ByteSpan> bad = {spans[3], SimpleCV::ByteSpan(ppm)};
+  SC_ASSERT(SimpleCV::imdecodeBatch(bad, out, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U8, 1, &errors) == 0);
+  SC_ASSERT(!errors[0].empty() && !errors[1].empty() && errors[0] != errors[1]);
+
+  // 后端在工作线程上抛出异常：在调用线程重新抛出，线程池之后照常可用
+  SimpleCV::registerCodec(std::make_shared<ThrowingTestCodec>());
+  const unsigned char thrw[] = {'T', 'H', 'R', 'W'};
+  std::vector<SimpleCV::ByteSpan> throwing(16, SimpleCV::ByteSpan(thrw, sizeof(thrw)));
+  for (int round = 0; round < 4; ++round)
+  {
+    bool caught = false;
+    try
+    {
+      SimpleCV::imdecodeBatch(throwing, out, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U8, 4);
+    }
+    catch (const std::runtime_error& e)
+    {
+      caught = std::string(e.what()) == "throw-test";
+    }
+    SC_ASSERT(caught);
+  }
+  SC_ASSERT(SimpleCV::unregisterCodec("throw-test"));
+  SC_ASSERT(SimpleCV::imdecodeBatch(spans, out, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U8, 4) == 5);
+
+  // 文件版本：缺失的文件逐项报错，不影响其它项
+  fs::path png = fs::current_path() / "simplecv_test_batch.png";
+  {
+    FILE* f = std::fopen(png.string().c_str(), "wb");
+    SC_ASSERT(f != nullptr);
+    std::fwrite(encoded[2].data(), 1, encoded[2].size(), f);
+    std::fclose(f);
+  }
+  std::vector<std::string> paths = {png.string(), (fs::current_path() / "simplecv_missing.png").string(), png.string()};
+  SC_ASSERT(SimpleCV::imreadBatch(paths, out, SimpleCV::ColorSpace::GRAY, SimpleCV::Depth::U8, 0, &errors) == 2);
+  SC_ASSERT(out.size() == 3 && out[1].empty() && !errors[1].empty());
+  SC_ASSERT(out[0].channels == 1 && out[2].width == 11 && out[2].data[0] == 21);
+  std::error_code ec;
+  fs::remove(png, ec);
+  return true;
+}
+
+// 每次最多给 7 字节，模拟管道/网络流
+struct ChunkReader : SimpleCV::Reader
+{
+  const std::vector<unsigned char>& src;
+  size_t pos = 0;
+  explicit ChunkReader(const std::vector<unsigned char>& s) : src(s) {}
+  int read(void* dst, int size) override
+  {
+    const size_t n = std::min<size_t>({static_cast<size_t>(size), 7, src.size() - pos});
+    std::memcpy(dst, src.data() + pos, n);
+    pos += n;
+    return static_cast<int>(n);
+  }
+  bool eof() override { return pos >= src.size(); }
+};
+
+static bool test_decode_from_reader()
+{
+  SimpleCV::Mat rgb(21, 30, 3);
+  for (int y = 0; y < rgb.height; ++y)
+    for (int x = 0; x < rgb.width * 3; ++x)
+      rgb.data[y * rgb.step + x] = static_cast<unsigned char>(x * 2 + y);
+  std::vector<unsigned char> png;
+  SC_ASSERT(SimpleCV::imencode(rgb, png));
+
+  // std::istream
+  std::istringstream iss(std::string(png.begin(), png.end()));
+  SimpleCV::Mat a = SimpleCV::imdecode(iss, SimpleCV::ColorSpace::BGR);
+  SC_ASSERT(a.width == 30 && a.height == 21 && a.channels == 3);
+  SC_ASSERT(a.data[0] == rgb.data[2] && a.data[20 * a.step + 5] == rgb.data[20 * rgb.step + 3]);
+
+  // 小块读取 + 复用 dst
+  ChunkReader r1(png);
+  SimpleCV::Mat dst(21, 30, 3);
+  const unsigned char* buf = dst.data;
+  SC_ASSERT(SimpleCV::imdecode(r1, dst));
+  SC_ASSERT(dst.data == buf && std::memcmp(dst.data, rgb.data, static_cast<size_t>(rgb.step) * 21) == 0);
+
+  // 16 位 PGM：字节序修正依赖预读的文件头
+  std::string pgm = "P5\n# comment\n2 1\n65535\n";
+  pgm += std::string("\x12\x34\xab\xcd", 4);
+  std::vector<unsigned char> pgm_bytes(pgm.begin(), pgm.end());
+  ChunkReader r2(pgm_bytes);
+  SimpleCV::Mat u16 = SimpleCV::imdecode(r2, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U16);
+  SC_ASSERT(u16.width == 2 && u16.depth == SimpleCV::Depth::U16);
+  SC_ASSERT(reinterpret_cast<const std::uint16_t*>(u16.data)[0] == 0x1234);
+  SC_ASSERT(reinterpret_cast<const std::uint16_t*>(u16.data)[1] == 0xabcd);
+
+  std::vector<unsigned char> empty;
+  ChunkReader r3(empty);
+  SC_ASSERT(SimpleCV::imdecode(r3).empty());
+  return true;
+}
+
+static std::vector<unsigned char> read_file_bytes(const fs::path& p)
+{
+  std::vector<unsigned char> bytes;
+  FILE* f = std::fopen(p.string().c_str(), "rb");
+  if (!f)
+    return bytes;
+  unsigned char tmp[4096];
+  size_t n;
+  while ((n = std::fread(tmp, 1, sizeof(tmp), f)) > 0)
+    bytes.insert(bytes.end(), tmp, tmp + n);
+  std::fclose(f);
+  return bytes;
+}
+
+static bool test_imencode_formats_and_params()
+{
+  SimpleCV::Mat rgb(32, 48, 3);
+  for (int y = 0; y < rgb.height; ++y)
+    for (int x = 0; x < rgb.width * 3; ++x)
+      rgb.data[y * rgb.step + x] = static_cast<unsigned char>((x * 5) ^ (y * 3));
+
+  SimpleCV::ImwriteParams hi, lo;
+  lo.jpeg_quality = 20;
+  std::vector<unsigned char> jpg_hi, jpg_lo;
+  SC_ASSERT(SimpleCV::imencode(".jpg", rgb, jpg_hi, hi));
+  SC_ASSERT(SimpleCV::imencode("JPEG", rgb, jpg_lo, lo));
+  SC_ASSERT(SimpleCV::imdecodeInfo(jpg_hi.data(), jpg_hi.size()).format == SimpleCV::ImageFormat::JPEG);
+  SC_ASSERT(jpg_lo.size() < jpg_hi.size());
+
+  // 内存编码与 imwrite 写出的文件一致
+  fs::path path = fs::current_path() / "simplecv_test_params.jpg";
+  SC_ASSERT(SimpleCV::imwrite(path.string(), rgb, lo));
+  SC_ASSERT(read_file_bytes(path) == jpg_lo);
+  std::error_code ec;
+  fs::remove(path, ec);
+
+  // PNG 的压缩级别/固定滤波器只影响大小，解码结果不变
+  SimpleCV::ImwriteParams fixed;
+  fixed.png_compression = 9;
+  fixed.png_filter = 0;
+  std::vector<unsigned char> png;
+  SC_ASSERT(SimpleCV::imencode("png", rgb, png, fixed));
+  SimpleCV::Mat back = SimpleCV::imdecode(png, SimpleCV::ColorSpace::RGB);
+  SC_ASSERT(back.width == 48 && std::memcmp(back.data, rgb.data, static_cast<size_t>(rgb.step) * rgb.height) == 0);
+
+  for (const char* ext : {".bmp", ".tga"})
+  {
+    std::vector<unsigned char> buf;
+    SimpleCV::ImwriteParams raw;
+    raw.tga_rle = false;
+    SC_ASSERT(SimpleCV::imencode(ext, rgb, buf, raw));
+    back = SimpleCV::imdecode(buf, SimpleCV::ColorSpace::RGB);
+    SC_ASSERT(back.height == 32 && std::memcmp(back.data, rgb.data, static_cast<size_t>(rgb.step) * rgb.height) == 0);
+  }
+  std::vector<unsigned char> bmp;
+  SC_ASSERT(SimpleCV::imencode("bmp", rgb, bmp));
+  SC_ASSERT(bmp[0] == 'B' && bmp[1] == 'M');
+
+  // 固定缓冲区：容量不足时给出所需大小
+  size_t need = 0;
+  SC_ASSERT(!SimpleCV::imencode(".jpg", rgb, nullptr, 0, &need, lo));
+  SC_ASSERT(need == jpg_lo.size());
+  std::vector<unsigned char> fixed_buf(need);
+  SC_ASSERT(SimpleCV::imencode(".jpg", rgb, fixed_buf.data(), fixed_buf.size(), &need, lo));
+  SC_ASSERT(fixed_buf == jpg_lo);
+  return true;
+}
+
+static bool test_png_fast_modes()
+{
+  // 平滑渐变 + 纯色块 + 噪声，宽度不是 4 的倍数
+  SimpleCV::Mat big(70, 131, 4);
+  unsigned state = 12345;
+  for (int y = 0; y < big.height; ++y)
+    for (int x = 0; x < big.width * 4; ++x)
+    {
+      state = state * 1103515245u + 12345u;
+      unsigned char v = static_cast<unsigned char>(x + 2 * y);
+      if (y >= 20 && y < 40)
+        v = 77;
+      else if (y >= 50)
+        v = static_cast<unsigned char>(state >> 24);
+      big.data[y * big.step + x] = v;
+    }
+
+  const SimpleCV::PngMode modes[] = {SimpleCV::PngMode::FAST, SimpleCV::PngMode::RLE, SimpleCV::PngMode::STORE};
+  for (int channels = 1; channels <= 4; ++channels)
+    for (SimpleCV::PngMode mode : modes)
+      for (int filter = -1; filter <= 4; ++filter)
+      {
+        // ROI 视图：按 step 逐行读取
+        SimpleCV::Mat src(big.height, big.width, channels);
+        for (int y = 0; y < src.height; ++y)
+          std::memcpy(src.data + y * src.step, big.data + y * big.step, static_cast<size_t>(src.width) * channels);
+        SimpleCV::Mat roi = src(SimpleCV::Rect(3, 5, 101, 60));
+
+        SimpleCV::ImwriteParams params;
+        params.png_mode = mode;
+        params.png_filter = filter;
+        std::vector<unsigned char> png;
+        SC_ASSERT(SimpleCV::imencode(".png", roi, png, params));
+        SimpleCV::Mat back = SimpleCV::imdecode(png);
+        SC_ASSERT(back.width == 101 && back.height == 60 && back.channels == channels);
+        for (int y = 0; y < back.height; ++y)
+          SC_ASSERT(std::memcmp(back.data + y * back.step, roi.data + y * roi.step, static_cast<size_t>(101) * channels) == 0);
+      }
+
+  // 大块纯色：快速模式远小于不压缩
+  SimpleCV::Mat flat(256, 256, 3);
+  std::memset(flat.data, 200, static_cast<size_t>(flat.step) * flat.height);
+  SimpleCV::ImwriteParams fast, store;
+  fast.png_mode = SimpleCV::PngMode::FAST;
+  store.png_mode = SimpleCV::PngMode::STORE;
+  std::vector<unsigned char> a, b;
+  SC_ASSERT(SimpleCV::imencode("png", flat, a, fast) && SimpleCV::imencode("png", flat, b, store));
+  SC_ASSERT(a.size() * 50 < b.size() && b.size() > static_cast<size_t>(256 * 256 * 3));
+  return true;
+}
+
+static bool test_png_parallel_bands()
+{
+  // 约 2.3MB，会切成 3 条行带；下半部分是噪声
+  SimpleCV::Mat src(1200, 640, 3);
+  unsigned state = 777;
+  for (int y = 0; y < src.height; ++y)
+    for (int x = 0; x < src.width * 3; ++x)
+    {
+      state = state * 1103515245u + 12345u;
+      src.data[y * src.step + x] = y < 700 ? static_cast<unsigned char>((x / 3 + y) & 0xF0)
+                                            : static_cast<unsigned char>(state >> 24);
+    }
+
+  const SimpleCV::PngMode modes[] = {SimpleCV::PngMode::FAST, SimpleCV::PngMode::RLE, SimpleCV::PngMode::STORE};
+  for (SimpleCV::PngMode mode : modes)
+  {
+    SimpleCV::ImwriteParams serial, parallel;
+    serial.png_mode = parallel.png_mode = mode;
+    parallel.png_threads = 3;
+    std::vector<unsigned char> a, b;
+    SC_ASSERT(SimpleCV::imencode(".png", src, a, serial));
+    SC_ASSERT(SimpleCV::imencode(".png", src, b, parallel));
+    SC_ASSERT(a == b); // 与线程数无关
+
+    SimpleCV::Mat back = SimpleCV::imdecode(b);
+    SC_ASSERT(back.width == src.width && back.height == src.height && back.channels == 3);
+    SC_ASSERT(std::memcmp(back.data, src.data, static_cast<size_t>(src.step) * src.height) == 0);
+  }
+  return true;
+}
+
+static bool test_imencode_strided_views()
+{
+  SimpleCV::Mat big(45, 77, 4);
+  for (int y = 0; y < big.height; ++y)
+    for (int x = 0; x < big.width * 4; ++x)
+      big.data[y * big.step + x] = static_cast<unsigned char>((x * 7 + y * 13) ^ (x >> 3));
+
+  const char* exts[] = {".jpg", ".bmp", ".tga"};
+  for (int channels = 1; channels <= 4; ++channels)
+  {
+    SimpleCV::Mat src(big.height, big.width, channels);
+    for (int y = 0; y < src.height; ++y)
+      std::memcpy(src.data + y * src.step, big.data + y * big.step, static_cast<size_t>(src.width) * channels);
+    // ROI 视图的行不连续，编码结果必须与紧密拷贝逐字节一致
+    SimpleCV::Mat roi = src(SimpleCV::Rect(5, 3, 33, 29));
+    SimpleCV::Mat packed = roi.clone();
+    SC_ASSERT(!roi.isContinuous() && packed.isContinuous());
+    for (const char* ext : exts)
+      for (int rle = 0; rle <= 1; ++rle)
+      {
+        SimpleCV::ImwriteParams params;
+        params.tga_rle = rle != 0;
+        std::vector<unsigned char> a, b;
+        SC_ASSERT(SimpleCV::imencode(ext, roi, a, params));
+        SC_ASSERT(SimpleCV::imencode(ext, packed, b, params));
+        SC_ASSERT(a == b);
+      }
+  }
+  return true;
+}
+
+static bool test_imencode_bgr_source()
+{
+  const char* exts[] = {".png", ".jpg", ".bmp", ".tga"};
+  for (int channels = 3; channels <= 4; ++channels)
+  {
+    SimpleCV::Mat bgr(37, 53, channels);
+    for (int y = 0; y < bgr.height; ++y)
+      for (int x = 0; x < bgr.width * channels; ++x)
+        bgr.data[y * bgr.step + x] = static_cast<unsigned char>(x * 5 + y * 3 + (x % channels) * 60);
+    SimpleCV::Mat roi = bgr(SimpleCV::Rect(2, 1, 40, 30));
+    const SimpleCV::ColorSpace src_space = channels == 3 ? SimpleCV::ColorSpace::BGR : SimpleCV::ColorSpace::BGRA;
+    const SimpleCV::ColorSpace rgb_space = channels == 3 ? SimpleCV::ColorSpace::RGB : SimpleCV::ColorSpace::RGBA;
+    SimpleCV::Mat rgb = SimpleCV::cvtColor(roi, rgb_space, src_space);
+
+    // 直接按 BGR 编码，结果与先 cvtColor 成 RGB 再编码逐字节一致
+    for (const char* ext : exts)
+      for (int mode = 0; mode < 2; ++mode)
+      {
+        SimpleCV::ImwriteParams swapped, plain;
+        swapped.src_space = src_space;
+        swapped.png_mode = plain.png_mode = mode ? SimpleCV::PngMode::FAST : SimpleCV::PngMode::STB;
+        swapped.tga_rle = plain.tga_rle = mode == 0;
+        std::vector<unsigned char> a, b;
+        SC_ASSERT(SimpleCV::imencode(ext, roi, a, swapped));
+        SC_ASSERT(SimpleCV::imencode(ext, rgb, b, plain));
+        SC_ASSERT(a == b);
+      }
+  }
+  return true;
+}
+
+// 所有申请都抛 bad_alloc 的分配器，用来模拟后台编码时内存不够
+struct ThrowingAllocator : SimpleCV::MatAllocator
+{
+  void* allocate(std::size_t) override { throw std::bad_alloc(); }
+  void deallocate(void*, std::size_t) override {}
+};
+
+// 没有 stride 能力的后端：非连续的 ROI 要先经 MatAllocator 整理成紧密拷贝
+struct PackedOnlyTestCodec : SimpleCV::ImageCodec
+{
+  const char* name() const override { return "packed-only-test"; }
+  SimpleCV::CodecCaps caps() const override
+  {
+    SimpleCV::CodecCaps c;
+    c.encode = true;
+    return c;
+  }
+  bool matchesMagic(const unsigned char*, std::size_t) const override { return false; }
+  bool matchesExtension(const std::string& ext) const override { return ext == "pko"; }
+  bool encode(const std::string&, const SimpleCV::Mat& mat, SimpleCV::EncodeWriteFn write, void* ctx,
+              const SimpleCV::ImwriteParams&) override
+  {
+    write(ctx, mat.data, static_cast<size_t>(mat.step) * mat.height);
+    return true;
+  }
+};
+
+static bool test_async_image_writer()
+{
+  // 像素由 holder 持有，用 weak_ptr 观察后台线程何时归还引用
+  auto pixels = std::make_shared<std::vector<unsigned char>>(48 * 64 * 3);
+  std::weak_ptr<std::vector<unsigned char>> watch = pixels;
+  SimpleCV::Mat img(48, 64, 3, SimpleCV::Depth::U8, pixels->data(), static_cast<size_t>(64 * 3), pixels);
+  pixels.reset();
+  for (int y = 0; y < img.height; ++y)
+    for (int x = 0; x < img.width * 3; ++x)
+      img.data[y * img.step + x] = static_cast<unsigned char>(x + y * 4);
+  std::error_code ec;
+
+  // 正常写出 + 一个写不出去的路径
+  {
+    SimpleCV::AsyncWriterParams params;
+    params.num_threads = 2;
+    params.queue_capacity = 2;
+    SimpleCV::AsyncImageWriter writer(params);
+    std::vector<fs::path> outs;
+    for (int i = 0; i < 6; ++i)
+    {
+      outs.push_back(fs::current_path() / ("simplecv_test_async_" + std::to_string(i) + ".png"));
+      SC_ASSERT(writer.write(outs.back().string(), img));
+    }
+    const fs::path bad = fs::current_path() / "simplecv_no_such_dir" / "x.png";
+    SC_ASSERT(writer.write(bad.string(), img));
+
+    std::vector<SimpleCV::AsyncWriteError> errors = writer.flush();
+    SC_ASSERT(writer.pending() == 0);
+    SC_ASSERT(errors.size() == 1 && errors[0].filename == bad.string());
+    SC_ASSERT(watch.use_count() == 1); // 没有拷贝像素，且后台线程已归还引用
+    for (const fs::path& out : outs)
+    {
+      SimpleCV::Mat back = SimpleCV::imread(out.string());
+      SC_ASSERT(back.width == 64 && back.height == 48 && back.channels == 3);
+      SC_ASSERT(std::memcmp(back.data, img.data, static_cast<size_t>(img.step) * img.height) == 0);
+      fs::remove(out, ec);
+    }
+    SC_ASSERT(writer.close().empty());
+    SC_ASSERT(!writer.write(outs[0].string(), img));
+  }
+
+  // 编码时抛异常：记为该文件的错误，工作线程继续处理后面的任务，不留下临时文件
+  {
+    ThrowingAllocator throwing;
+    SimpleCV::registerCodec(std::make_shared<PackedOnlyTestCodec>(), 100);
+    SimpleCV::setThreadAllocator(&throwing); // 工作线程沿用创建者的分配器
+    SimpleCV::AsyncWriterParams params;
+    params.num_threads = 1;
+    SimpleCV::AsyncImageWriter writer(params);
+    SimpleCV::setThreadAllocator(nullptr);
+    const fs::path boom = fs::current_path() / "simplecv_test_async_throw.pko";
+    const fs::path after = fs::current_path() / "simplecv_test_async_after.bmp";
+    SC_ASSERT(writer.write(boom.string(), img(SimpleCV::Rect(1, 1, 8, 8))));
+    SC_ASSERT(writer.write(after.string(), img));
+    const std::vector<SimpleCV::AsyncWriteError> errors = writer.flush();
+    SimpleCV::unregisterCodec("packed-only-test");
+    SC_ASSERT(errors.size() == 1 && errors[0].filename == boom.string());
+    SC_ASSERT(errors[0].reason.find("exception") != std::string::npos);
+    SC_ASSERT(writer.pending() == 0 && !fs::exists(boom) && fs::exists(after));
+    for (const auto& entry : fs::directory_iterator(fs::current_path()))
+      SC_ASSERT(entry.path().extension() != ".tmp");
+    fs::remove(after, ec);
+    SC_ASSERT(writer.close().empty());
+  }
+
+  // close() 可以在多个线程同时调用：只有一个会 join 工作线程
+  {
+    SimpleCV::AsyncImageWriter writer;
+    const fs::path out = fs::current_path() / "simplecv_test_async_close.bmp";
+    SC_ASSERT(writer.write(out.string(), img));
+    std::vector<std::thread> closers;
+    for (int i = 0; i < 4; ++i)
+      closers.emplace_back([&]() { writer.close(); });
+    for (std::thread& t : closers)
+      t.join();
+    SC_ASSERT(writer.pending() == 0 && fs::exists(out));
+    fs::remove(out, ec);
+  }
+
+  // 非 U8：imwrite 接受的（16 位 PGM、float PFM）同样能排队写出，U16 PNG 仍报错
+  {
+    SimpleCV::Mat g16(6, 5, 1, SimpleCV::Depth::U16);
+    SimpleCV::Mat f32(6, 5, 3, SimpleCV::Depth::F32);
+    for (int y = 0; y < 6; ++y)
+    {
+      for (int x = 0; x < 5; ++x)
+        g16.ptr<uint16_t>(y)[x] = static_cast<uint16_t>(1000 * y + x);
+      for (int i = 0; i < 15; ++i)
+        f32.ptr<float>(y)[i] = y + i * 0.5f;
+    }
+    const fs::path pgm = fs::current_path() / "simplecv_test_async16.pgm";
+    const fs::path pfm = fs::current_path() / "simplecv_test_async.pfm";
+    const fs::path png = fs::current_path() / "simplecv_test_async16.png";
+    SimpleCV::AsyncImageWriter writer;
+    SC_ASSERT(writer.write(pgm.string(), g16) && writer.write(pfm.string(), f32) && writer.write(png.string(), g16));
+    const std::vector<SimpleCV::AsyncWriteError> errors = writer.close();
+    SC_ASSERT(errors.size() == 1 && errors[0].filename == png.string());
+    SimpleCV::Mat back16 = SimpleCV::imread(pgm.string(), SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U16);
+    SimpleCV::Mat backf = SimpleCV::imread(pfm.string(), SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::F32);
+    SC_ASSERT(back16.depth == SimpleCV::Depth::U16 && std::memcmp(back16.data, g16.data, 6 * 5 * 2) == 0);
+    SC_ASSERT(backf.depth == SimpleCV::Depth::F32 && std::memcmp(backf.data, f32.data, 6 * 15 * 4) == 0);
+    fs::remove(pgm, ec);
+    fs::remove(pfm, ec);
+    SC_ASSERT(!fs::exists(png));
+  }
+
+  // 丢弃策略：接受的都写出，被挤掉/拒绝的数目对得上
+  const SimpleCV::AsyncWritePolicy policies[] = {SimpleCV::AsyncWritePolicy::DROP_NEWEST,
+                                                 SimpleCV::AsyncWritePolicy::DROP_OLDEST};
+  for (SimpleCV::AsyncWritePolicy policy : policies)
+  {
+    SimpleCV::AsyncWriterParams params;
+    params.queue_capacity = 1;
+    params.policy = policy;
+    SimpleCV::AsyncImageWriter writer(params);
+    const int n = 20;
+    int accepted = 0;
+    for (int i = 0; i < n; ++i)
+      accepted += writer.write((fs::current_path() / ("simplecv_test_drop_" + std::to_string(i) + ".bmp")).string(), img) ? 1 : 0;
+    const std::vector<SimpleCV::AsyncWriteError> errors = writer.close();
+    int written = 0;
+    for (int i = 0; i < n; ++i)
+    {
+      const fs::path out = fs::current_path() / ("simplecv_test_drop_" + std::to_string(i) + ".bmp");
+      written += fs::exists(out) ? 1 : 0;
+      fs::remove(out, ec);
+    }
+    if (policy == SimpleCV::AsyncWritePolicy::DROP_NEWEST)
+      SC_ASSERT(errors.empty() && written == accepted);
+    else
+      SC_ASSERT(accepted == n && written + static_cast<int>(errors.size()) == n);
+    SC_ASSERT(written >= 1);
+  }
+  return true;
+}
+
+// 手工拼一个 GIF89a 动图：4 色全局调色板，每帧整幅覆盖。
+// LZW 每个像素前都发一次 clear code，码长固定 3 位，不需要真正建字典
+static std::vector<unsigned char> make_test_gif(int w, int h, const std::vector<std::vector<unsigned char>>& frames,
+                                                const std::vector<int>& delays_cs)
+{
+  std::vector<unsigned char> g = {'G', 'I', 'F', '8', '9', 'a'};
+  auto le16 = [&](int v) { g.push_back(static_cast<unsigned char>(v & 0xFF)); g.push_back(static_cast<unsigned char>(v >> 8)); };
+  le16(w);
+  le16(h);
+  g.push_back(0x81); // 全局调色板，2^(1+1) = 4 色
+  g.push_back(0);
+  g.push_back(0);
+  const unsigned char palette[12] = {0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255};
+  g.insert(g.end(), palette, palette + 12);
+
+  for (size_t f = 0; f < frames.size(); ++f)
+  {
+    const unsigned char gce[4] = {0x21, 0xF9, 0x04, 0x04}; // disposal = 1（保留）
+    g.insert(g.end(), gce, gce + 4);
+    le16(delays_cs[f]);
+    g.push_back(0);
+    g.push_back(0);
+
+    g.push_back(0x2C);
+    le16(0);
+    le16(0);
+    le16(w);
+    le16(h);
+    g.push_back(0);
+
+    std::vector<unsigned char> lzw;
+    unsigned bits = 0;
+    int count = 0;
+    auto put = [&](unsigned code)
+    {
+      bits |= code << count;
+      count += 3;
+      while (count >= 8)
+      {
+        lzw.push_back(static_cast<unsigned char>(bits & 0xFF));
+        bits >>= 8;
+        count -= 8;
+      }
+    };
+    for (unsigned char idx : frames[f])
+    {
+      put(4); // clear
+      put(idx);
+    }
+    put(5); // end of information
+    if (count > 0)
+      lzw.push_back(static_cast<unsigned char>(bits & 0xFF));
+
+    g.push_back(2); // LZW 最小码长
+    for (size_t i = 0; i < lzw.size(); i += 255)
+    {
+      const size_t n = std::min<size_t>(255, lzw.size() - i);
+      g.push_back(static_cast<unsigned char>(n));
+      g.insert(g.end(), lzw.begin() + static_cast<std::ptrdiff_t>(i), lzw.begin() + static_cast<std::ptrdiff_t>(i + n));
+    }
+    g.push_back(0);
+  }
+  g.push_back(0x3B);
+  return g;
+}
+
+static bool test_gif_animation_frames()
+{
+  const int w = 5, h = 3;
+  std::vector<std::vector<unsigned char>> idx(3, std::vector<unsigned char>(w * h));
+  for (int f = 0; f < 3; ++f)
+    for (int i = 0; i < w * h; ++i)
+      idx[f][i] = static_cast<unsigned char>((i + f) % 4);
+  const std::vector<unsigned char> gif = make_test_gif(w, h, idx, {10, 25, 4});
+  const unsigned char palette[4][3] = {{0, 0, 0}, {255, 0, 0}, {0, 255, 0}, {0, 0, 255}};
+
+  std::vector<SimpleCV::Mat> frames;
+  std::vector<int> delays;
+  SC_ASSERT(SimpleCV::imdecodeMulti(gif, frames, SimpleCV::ColorSpace::BGR, &delays));
+  SC_ASSERT(frames.size() == 3 && delays == std::vector<int>({100, 250, 40}));
+  {
+    const auto snap = SimpleCV::getMemorySnapshot();
+    const auto* site = find_site(snap, "imdecodeMulti");
+    SC_ASSERT(site && site->live_bytes >= static_cast<size_t>(3 * w * h * 3));
+  }
+  for (int f = 0; f < 3; ++f)
+  {
+    const SimpleCV::Mat& m = frames[f];
+    SC_ASSERT(m.width == w && m.height == h && m.channels == 3);
+    // 所有帧是同一块分配上的视图
+    SC_ASSERT(m.data == frames[0].data + static_cast<size_t>(f) * w * h * 3);
+    for (int i = 0; i < w * h; ++i)
+    {
+      const unsigned char* px = m.data + (i / w) * m.step + (i % w) * 3;
+      const unsigned char* rgb = palette[idx[f][i]];
+      SC_ASSERT(px[0] == rgb[2] && px[1] == rgb[1] && px[2] == rgb[0]);
+    }
+  }
+
+  // 释放前面的帧不影响后面的帧
+  SimpleCV::Mat last = frames[2];
+  frames.clear();
+  SC_ASSERT(last.data[0] == palette[idx[2][0]][2]);
+
+  // 从文件读
+  fs::path out = fs::current_path() / "simplecv_test_anim.gif";
+  {
+    std::FILE* fp = std::fopen(out.string().c_str(), "wb");
+    SC_ASSERT(fp);
+    std::fwrite(gif.data(), 1, gif.size(), fp);
+    std::fclose(fp);
+  }
+  SC_ASSERT(SimpleCV::imreadAnimation(out.string(), frames, delays));
+  SC_ASSERT(frames.size() == 3 && frames[1].channels == 4 && delays[1] == 250);
+  {
+    const auto snap = SimpleCV::getMemorySnapshot();
+    const auto* site = find_site(snap, "imreadAnimation");
+    SC_ASSERT(site && site->live_bytes >= static_cast<size_t>(3 * w * h * 4));
+  }
+  std::error_code ec;
+  fs::remove(out, ec);
+
+  // 非 GIF 输入按单帧返回
+  SimpleCV::Mat rgb(4, 4, 3);
+  fill_pattern_rgb(rgb);
+  std::vector<unsigned char> png;
+  SC_ASSERT(SimpleCV::imencode(rgb, png));
+  SC_ASSERT(SimpleCV::imdecodeMulti(png, frames, SimpleCV::ColorSpace::RGB, &delays));
+  SC_ASSERT(frames.size() == 1 && delays == std::vector<int>({0}) && frames[0].width == 4);
+  SC_ASSERT(!SimpleCV::imdecodeMulti(SimpleCV::ByteSpan(), frames));
+  return true;
+}
+
+static bool test_imread_resized()
+{
+  SimpleCV::Mat rgb(48, 64, 3);
+  for (int y = 0; y < rgb.height; ++y)
+    for (int x = 0; x < rgb.width; ++x)
+    {
+      unsigned char* px = rgb.data + y * rgb.step + x * 3;
+      px[0] = static_cast<unsigned char>(x * 4);
+      px[1] = static_cast<unsigned char>(y * 5);
+      px[2] = static_cast<unsigned char>(255 - x * 2);
+    }
+  std::vector<unsigned char> png, jpg;
+  SC_ASSERT(SimpleCV::imencode(rgb, png));
+  SC_ASSERT(SimpleCV::imencode(".jpg", rgb, jpg));
+
+  auto same = [](const SimpleCV::Mat& a, const SimpleCV::Mat& b)
+  {
+    if (a.width != b.width || a.height != b.height || a.channels != b.channels)
+      return false;
+    for (int y = 0; y < a.height; ++y)
+      if (std::memcmp(a.data + y * a.step, b.data + y * b.step, static_cast<size_t>(a.width) * a.channels) != 0)
+        return false;
+    return true;
+  };
+
+  // 与 imdecode -> resize -> cvtColor 的结果一致
+  SimpleCV::Mat fused = SimpleCV::imdecodeResized(png, 20, 15, SimpleCV::ColorSpace::BGR);
+  SimpleCV::Mat ref;
+  SimpleCV::resize(SimpleCV::imdecode(png, SimpleCV::ColorSpace::RGB), ref, 20, 15);
+  SC_ASSERT(same(fused, SimpleCV::cvtColor(ref, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB)));
+
+  // JPEG：目标正好是 1/4 时直接缩小解码；10x10 先 1/4 解码（16x12）再缩放
+  SC_ASSERT(same(SimpleCV::imdecodeResized(jpg, 16, 12, SimpleCV::ColorSpace::BGRA),
+                 SimpleCV::imdecodeReduced(jpg, 4, SimpleCV::ColorSpace::BGRA)));
+  SimpleCV::Mat small;
+  SimpleCV::resize(SimpleCV::imdecodeReduced(jpg, 4, SimpleCV::ColorSpace::RGB), small, 10, 10);
+  SC_ASSERT(same(SimpleCV::imdecodeResized(jpg, 10, 10, SimpleCV::ColorSpace::BGR),
+                 SimpleCV::cvtColor(small, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB)));
+
+  // 最近邻放大：每个源像素变成 2x2
+  SimpleCV::Mat gray = SimpleCV::imdecodeResized(png, 128, 96, SimpleCV::ColorSpace::GRAY, SimpleCV::Interp::NEAREST);
+  SimpleCV::Mat gray_src = SimpleCV::imdecode(png, SimpleCV::ColorSpace::GRAY);
+  SC_ASSERT(gray.channels == 1 && gray.width == 128 && gray.height == 96);
+  for (int y = 0; y < gray.height; ++y)
+    for (int x = 0; x < gray.width; ++x)
+      SC_ASSERT(gray.data[y * gray.step + x] == gray_src.data[(y / 2) * gray_src.step + x / 2]);
+
+  fs::path out = fs::current_path() / "simplecv_test_resized.jpg";
+  SC_ASSERT(SimpleCV::imwrite(out.string(), rgb));
+  SimpleCV::Mat from_file = SimpleCV::imreadResized(out.string(), 10, 10, SimpleCV::ColorSpace::BGR);
+  SC_ASSERT(same(from_file, SimpleCV::imdecodeResized(jpg, 10, 10, SimpleCV::ColorSpace::BGR)));
+  std::error_code ec;
+  fs::remove(out, ec);
+
+  // stb 探测不到尺寸的来源同样能缩放：原生解码的 PFM、Reader
+  SimpleCV::Mat f32(12, 16, 3, SimpleCV::Depth::F32);
+  for (int y = 0; y < f32.height; ++y)
+    for (int i = 0; i < f32.width * 3; ++i)
+      f32.ptr<float>(y)[i] = static_cast<float>((i * 7 + y * 13) % 256) / 255.0f;
+  fs::path pfm = fs::current_path() / "simplecv_test_resized.pfm";
+  SC_ASSERT(SimpleCV::imwrite(pfm.string(), f32));
+  SimpleCV::Mat pfm_ref;
+  SimpleCV::resize(SimpleCV::imread(pfm.string(), SimpleCV::ColorSpace::RGB), pfm_ref, 8, 6);
+  SimpleCV::Mat pfm_small = SimpleCV::imreadResized(pfm.string(), 8, 6, SimpleCV::ColorSpace::BGR);
+  SC_ASSERT(pfm_small.width == 8 && pfm_small.height == 6);
+  SC_ASSERT(same(pfm_small, SimpleCV::cvtColor(pfm_ref, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB)));
+  fs::remove(pfm, ec);
+
+  ChunkReader reader(png);
+  SC_ASSERT(same(SimpleCV::imdecodeResized(reader, 20, 15, SimpleCV::ColorSpace::BGR), fused));
+
+  SC_ASSERT(SimpleCV::imdecodeResized(png, 0, 10).empty());
+  SC_ASSERT(SimpleCV::imreadResized("simplecv_no_such_file.png", 10, 10).empty());
+  return true;
+}
+
+// 测试用后端："SCV1" + 宽高 + 通道 + 紧密像素的裸格式；另外认 JPEG 文件头但只在不缩小时接手
+struct RawTestCodec : SimpleCV::ImageCodec
+{
+  int decodes = 0, encodes = 0;
+  const char* name() const override { return "raw-test"; }
+  SimpleCV::CodecCaps caps() const override
+  {
+    SimpleCV::CodecCaps c;
+    c.decode = c.encode = true;
+    return c;
+  }
+  bool matchesMagic(const unsigned char* head, std::size_t n) const override
+  {
+    return (n >= 4 && std::memcmp(head, "SCV1", 4) == 0) || (n >= 3 && head[0] == 0xFF && head[1] == 0xD8);
+  }
+  bool matchesExtension(const std::string& ext) const override { return ext == "scv" || ext == "jpg"; }
+  bool decode(SimpleCV::ByteSpan buf, SimpleCV::Mat& dst, const SimpleCV::CodecDecodeOptions& opts) override
+  {
+    ++decodes;
+    if (buf.data[0] == 0xFF) // JPEG：返回一张 2x2 的标记图
+    {
+      dst = SimpleCV::Mat(2, 2, 3);
+      std::memset(dst.data, 42, static_cast<size_t>(dst.step) * 2);
+      return opts.flag == SimpleCV::ColorSpace::UNCHANGED;
+    }
+    const int w = buf.data[4], h = buf.data[5], c = buf.data[6];
+    if (buf.size != static_cast<size_t>(7 + w * h * c))
+      return false;
+    dst = SimpleCV::Mat(h, w, c);
+    for (int y = 0; y < h; ++y)
+      std::memcpy(dst.data + y * dst.step, buf.data + 7 + y * w * c, static_cast<size_t>(w) * c);
+    return true;
+  }
+  bool encode(const std::string& ext, const SimpleCV::Mat& mat, SimpleCV::EncodeWriteFn write, void* ctx,
+              const SimpleCV::ImwriteParams&) override
+  {
+    if (ext != "scv") // jpg 不处理，交给 stb
+      return false;
+    ++encodes;
+    const unsigned char head[7] = {'S', 'C', 'V', '1', static_cast<unsigned char>(mat.width),
+                                   static_cast<unsigned char>(mat.height), static_cast<unsigned char>(mat.channels)};
+    write(ctx, head, 7);
+    for (int y = 0; y < mat.height; ++y) // 没有 stride 能力：收到的一定是紧密的
+      write(ctx, mat.data + y * mat.step, static_cast<size_t>(mat.width) * mat.channels);
+    return mat.isContinuous();
+  }
+};
+
+// 测试用 16 位后端：".s16" 写成 "S16" + 紧密的本机字节序样本
+struct Raw16TestCodec : SimpleCV::ImageCodec
+{
+  const char* name() const override { return "raw16-test"; }
+  SimpleCV::CodecCaps caps() const override
+  {
+    SimpleCV::CodecCaps c;
+    c.encode = c.bit16 = true;
+    return c;
+  }
+  bool matchesMagic(const unsigned char*, std::size_t) const override { return false; }
+  bool matchesExtension(const std::string& ext) const override { return ext == "s16"; }
+  bool encode(const std::string&, const SimpleCV::Mat& mat, SimpleCV::EncodeWriteFn write, void* ctx,
+              const SimpleCV::ImwriteParams&) override
+  {
+    write(ctx, "S16", 3);
+    for (int y = 0; y < mat.height; ++y)
+      write(ctx, mat.data + y * mat.step, static_cast<size_t>(mat.width) * mat.elemSize());
+    return true;
+  }
+};
+
+static bool test_codec_registry()
+{
+  const std::vector<std::shared_ptr<SimpleCV::ImageCodec>> builtin = SimpleCV::getCodecs();
+  SC_ASSERT(!builtin.empty() && std::string(builtin.back()->name()) == "stb");
+
+  auto codec = std::make_shared<RawTestCodec>();
+  SimpleCV::registerCodec(codec, 100);
+  SC_ASSERT(SimpleCV::getCodecs().front() == codec && SimpleCV::getCodecs().size() == builtin.size() + 1);
+
+  SimpleCV::Mat big(10, 12, 3);
+  fill_pattern_rgb(big);
+  SimpleCV::Mat roi = big(SimpleCV::Rect(1, 2, 7, 5));
+
+  // 编码：按扩展名交给后端，ROI 先整理成紧密拷贝
+  std::vector<unsigned char> raw;
+  SC_ASSERT(SimpleCV::imencode(".scv", roi, raw));
+  SC_ASSERT(codec->encodes == 1 && raw.size() == 7 + 7 * 5 * 3 && std::memcmp(raw.data(), "SCV1", 4) == 0);
+
+  // ALIGNED 的 Mat 及其 ROI 行间有 padding：交给后端前同样整理成紧密的，内容与上面一致
+  SimpleCV::Mat aligned(10, 12, 3, SimpleCV::StepMode::ALIGNED);
+  fill_pattern_rgb(aligned);
+  SimpleCV::Mat aligned_roi = aligned(SimpleCV::Rect(1, 2, 7, 5));
+  SC_ASSERT(aligned.step == 64 && !aligned_roi.isContinuous());
+  std::vector<unsigned char> raw_aligned;
+  SC_ASSERT(SimpleCV::imencode(".scv", aligned_roi, raw_aligned) && raw_aligned == raw);
+  SC_ASSERT(SimpleCV::imencode(".scv", aligned, raw_aligned) && raw_aligned.size() == 7 + 12 * 10 * 3);
+  SC_ASSERT(codec->encodes == 3);
+
+  // 解码：按文件头交给后端；dst 尺寸一致时拷进调用方的缓冲区
+  SimpleCV::Mat dst(5, 7, 3);
+  unsigned char* keep = dst.data;
+  SC_ASSERT(SimpleCV::imdecode(raw, dst));
+  SC_ASSERT(dst.data == keep && codec->decodes == 1);
+  for (int y = 0; y < 5; ++y)
+    SC_ASSERT(std::memcmp(dst.data + y * dst.step, roi.data + y * roi.step, 7 * 3) == 0);
+
+  fs::path out = fs::current_path() / "simplecv_test_codec.scv";
+  SC_ASSERT(SimpleCV::imwrite(out.string(), roi));
+  SimpleCV::Mat from_file = SimpleCV::imread(out.string());
+  SC_ASSERT(from_file.width == 7 && from_file.height == 5 && codec->decodes == 2);
+  std::error_code ec;
+  fs::remove(out, ec);
+
+  // 后端不处理 jpg 编码 -> stb；不缩小的 JPEG 解码由后端接手，缩小解码它不支持 -> stb
+  std::vector<unsigned char> jpg;
+  SC_ASSERT(SimpleCV::imencode(".jpg", big, jpg) && jpg[0] == 0xFF && codec->encodes == 4);
+  SimpleCV::Mat marker = SimpleCV::imdecode(jpg);
+  SC_ASSERT(marker.width == 2 && marker.data[0] == 42 && codec->decodes == 3);
+  SimpleCV::Mat half = SimpleCV::imdecodeReduced(jpg, 2);
+  SC_ASSERT(half.width == 6 && half.height == 5 && codec->decodes == 3);
+  // 后端返回 false -> 下一个后端
+  SimpleCV::Mat gray = SimpleCV::imdecode(jpg, SimpleCV::ColorSpace::GRAY);
+  SC_ASSERT(gray.width == 12 && gray.channels == 1 && codec->decodes == 4);
+  // imdecodeResized 同样先问后端：JPEG 交给不支持缩小解码的后端全尺寸解码，只有后端认得的格式解码后缩放
+  SimpleCV::Mat resized_marker = SimpleCV::imdecodeResized(jpg, 2, 2);
+  SC_ASSERT(resized_marker.width == 2 && resized_marker.data[0] == 42 && codec->decodes == 5);
+  SimpleCV::Mat resized_raw = SimpleCV::imdecodeResized(raw, 14, 10, SimpleCV::ColorSpace::RGB, SimpleCV::Interp::NEAREST);
+  SC_ASSERT(resized_raw.width == 14 && resized_raw.height == 10 && codec->decodes == 6);
+  SC_ASSERT(std::memcmp(resized_raw.data + 2 * resized_raw.step + 2 * 3, roi.data + roi.step + 3, 3) == 0);
+
+  // U16：imwrite 与 imencode 一样交给声明 bit16 的后端；没有这样的后端时不碰文件
+  SimpleCV::Mat g16(3, 4, 1, SimpleCV::Depth::U16);
+  for (int i = 0; i < 12; ++i)
+    g16.ptr<uint16_t>(i / 4)[i % 4] = static_cast<uint16_t>(i * 4000);
+  fs::path out16 = fs::current_path() / "simplecv_test_codec.s16";
+  SC_ASSERT(!SimpleCV::imwrite(out16.string(), g16) && !fs::exists(out16));
+  SimpleCV::registerCodec(std::make_shared<Raw16TestCodec>());
+  std::vector<unsigned char> enc16;
+  SC_ASSERT(SimpleCV::imencode(".s16", g16, enc16) && enc16.size() == 3 + 12 * 2);
+  SC_ASSERT(SimpleCV::imwrite(out16.string(), g16) && fs::file_size(out16) == enc16.size());
+  SC_ASSERT(!SimpleCV::imwrite(out.string(), g16)); // raw-test 没有 bit16
+  SC_ASSERT(SimpleCV::unregisterCodec("raw16-test"));
+  fs::remove(out16, ec);
+
+  // 同名替换、不能替换 stb、注销
+  SimpleCV::registerCodec(std::make_shared<RawTestCodec>(), -5);
+  SC_ASSERT(SimpleCV::getCodecs().size() == builtin.size() + 1);
+  SC_ASSERT(SimpleCV::unregisterCodec("raw-test") && !SimpleCV::unregisterCodec("raw-test"));
+  SC_ASSERT(SimpleCV::getCodecs().size() == builtin.size());
+  SC_ASSERT(SimpleCV::imdecode(raw).empty()); // stb 不认得这个格式
+  return true;
+}
+
+static bool test_pnm_pfm_native()
+{
+  auto same = [](const SimpleCV::Mat& a, const SimpleCV::Mat& b)
+  {
+    if (a.width != b.width || a.height != b.height || a.channels != b.channels || a.depth != b.depth)
+      return false;
+    const size_t row = static_cast<size_t>(a.width) * a.elemSize();
+    for (int y = 0; y < a.height; ++y)
+      if (std::memcmp(a.data + y * a.step, b.data + y * b.step, row) != 0)
+        return false;
+    return true;
+  };
+
+  // 8 位 P6：ROI 按 step 取行，文件就是头 + 紧密像素
+  SimpleCV::Mat big(10, 12, 3);
+  fill_pattern_rgb(big);
+  SimpleCV::Mat roi = big(SimpleCV::Rect(1, 2, 7, 5));
+  std::vector<unsigned char> ppm;
+  SC_ASSERT(SimpleCV::imencode(".ppm", roi, ppm));
+  const std::string head = "P6\n7 5\n255\n";
+  SC_ASSERT(ppm.size() == head.size() + 7 * 5 * 3 && std::memcmp(ppm.data(), head.data(), head.size()) == 0);
+  for (int y = 0; y < 5; ++y)
+    SC_ASSERT(bytes_equal(ppm.data() + head.size() + y * 21, roi.data + y * roi.step, 21));
+  SC_ASSERT(same(SimpleCV::imdecode(ppm), roi));
+  SC_ASSERT(same(SimpleCV::imdecode(ppm, SimpleCV::ColorSpace::BGR),
+                 SimpleCV::cvtColor(roi, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB)));
+
+  // BGR 源与先 cvtColor 再写一致；要改通道数时仍由 stb 转换
+  SimpleCV::ImwriteParams bgr;
+  bgr.src_space = SimpleCV::ColorSpace::BGR;
+  SimpleCV::Mat roi_bgr = SimpleCV::cvtColor(roi, SimpleCV::ColorSpace::BGR, SimpleCV::ColorSpace::RGB);
+  std::vector<unsigned char> ppm_bgr;
+  SC_ASSERT(SimpleCV::imencode("ppm", roi_bgr, ppm_bgr, bgr) && ppm_bgr == ppm);
+  SC_ASSERT(SimpleCV::imdecode(ppm, SimpleCV::ColorSpace::GRAY).channels == 1);
+
+  // 解码进带 stride 的视图
+  SimpleCV::Mat canvas(8, 9, 3);
+  SimpleCV::Mat view = canvas(SimpleCV::Rect(2, 1, 7, 5));
+  unsigned char* keep = view.data;
+  SC_ASSERT(SimpleCV::imdecode(ppm, view) && view.data == keep && same(view, roi));
+
+  // 16 位 P5：maxval 65535，大端样本
+  SimpleCV::Mat g16(3, 4, 1, SimpleCV::Depth::U16);
+  for (int y = 0; y < 3; ++y)
+    for (int x = 0; x < 4; ++x)
+      g16.ptr<uint16_t>(y)[x] = static_cast<uint16_t>(0x0102 * (y * 4 + x) + 7);
+  std::vector<unsigned char> pgm;
+  SC_ASSERT(SimpleCV::imencode(".pgm", g16, pgm));
+  const std::string head16 = "P5\n4 3\n65535\n";
+  SC_ASSERT(std::memcmp(pgm.data(), head16.data(), head16.size()) == 0);
+  SC_ASSERT(pgm[head16.size()] == 0x00 && pgm[head16.size() + 1] == 7);
+  SC_ASSERT(same(SimpleCV::imdecode(pgm, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U16), g16));
+  SimpleCV::Mat g8 = SimpleCV::imdecode(pgm, SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::U8);
+  SC_ASSERT(g8.depth == SimpleCV::Depth::U8 && g8.data[5] == (g16.ptr<uint16_t>(1)[1] >> 8));
+
+  // PFM：行序自下而上，本机字节序；写文件再读回
+  SimpleCV::Mat f32(4, 5, 3, SimpleCV::Depth::F32);
+  for (int y = 0; y < 4; ++y)
+    for (int i = 0; i < 15; ++i)
+      f32.ptr<float>(y)[i] = y * 100.0f + i * 0.25f - 3.0f;
+  fs::path out = fs::current_path() / "simplecv_test_native.pfm";
+  SC_ASSERT(SimpleCV::imwrite(out.string(), f32));
+  SimpleCV::Mat back = SimpleCV::imread(out.string(), SimpleCV::ColorSpace::UNCHANGED, SimpleCV::Depth::F32);
+  SC_ASSERT(same(back, f32));
+  SimpleCV::ImageInfo info = SimpleCV::imreadInfo(out.string());
+  SC_ASSERT(info.width == 5 && info.height == 4 && info.channels == 3 && info.bits == 32);
+  SimpleCV::Mat gray = SimpleCV::imread(out.string(), SimpleCV::ColorSpace::GRAY, SimpleCV::Depth::F32);
+  SC_ASSERT(gray.channels == 1 && gray.depth == SimpleCV::Depth::F32 && gray.width == 5);
+  SimpleCV::Mat half = SimpleCV::imread(out.string(), SimpleCV::ColorSpace::BGR, SimpleCV::Depth::F16);
+  SC_ASSERT(half.depth == SimpleCV::Depth::F16 && static_cast<float>(half.ptr<SimpleCV::float16>(3)[2]) == 297.0f);
+  std::error_code ec;
+  fs::remove(out, ec);
+
+  std::vector<unsigned char> pfm;
+  SC_ASSERT(SimpleCV::imencode(".pfm", f32, pfm));
+  float last_row_first = 0.0f;
+  const size_t pfm_head = pfm.size() - 4 * 5 * 3 * sizeof(float);
+  std::memcpy(&last_row_first, pfm.data() + pfm_head, sizeof(float));
+  SC_ASSERT(last_row_first == f32.ptr<float>(3)[0]);
+
+  // 大端 PFM（比例为正）
+  const unsigned char be[] = {'P', 'f', '\n', '2', ' ', '1', '\n', '1', '.', '0', '\n',
+                              0x3f, 0x80, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00};
+  SimpleCV::Mat bem = SimpleCV::imdecode(SimpleCV::ByteSpan(be, sizeof(be)), SimpleCV::ColorSpace::UNCHANGED,
+                                         SimpleCV::Depth::F32);
+  SC_ASSERT(bem.channels == 1 && bem.ptr<float>(0)[0] == 1.0f && bem.ptr<float>(0)[1] == -2.0f);
+  SimpleCV::Mat be8 = SimpleCV::imdecode(SimpleCV::ByteSpan(be, sizeof(be)), SimpleCV::ColorSpace::UNCHANGED);
+  SC_ASSERT(be8.depth == SimpleCV::Depth::U8 && be8.data[0] == 255 && be8.data[1] == 0);
+  SC_ASSERT(SimpleCV::imdecode(SimpleCV::ByteSpan(be, sizeof(be) - 1)).empty());
+
+  // 文件头给出的尺寸远超实际数据或超过 1<<24：不按头分配，返回空 Mat；批量解码里逐项报错
+  const std::string huge = "P5\n100000 100000\n255\n";
+  const std::string wide = "P6\n20000000 1\n255\n";
+  const std::string huge_pfm = "PF\n100000 100000\n-1.0\n";
+  SC_ASSERT(SimpleCV::imdecode(SimpleCV::ByteSpan(huge)).empty());
+  SC_ASSERT(SimpleCV::imdecode(SimpleCV::ByteSpan(wide)).empty());
+  SC_ASSERT(SimpleCV::imdecode(SimpleCV::ByteSpan(huge_pfm), SimpleCV::ColorSpace::UNCHANGED,
+                               SimpleCV::Depth::F32).empty());
+  fs::path huge_file = fs::current_path() / "simplecv_test_huge.pgm";
+  {
+    FILE* f = std::fopen(huge_file.string().c_str(), "wb");
+    SC_ASSERT(f != nullptr);
+    std::fwrite(huge.data(), 1, huge.size(), f);
+    std::fwrite(pgm.data(), 1, pgm.size(), f);
+    std::fclose(f);
+  }
+  SC_ASSERT(SimpleCV::imread(huge_file.string()).empty());
+  std::vector<SimpleCV::Mat> huge_out;
+  std::vector<std::string> huge_errors;
+  SC_ASSERT(SimpleCV::imreadBatch({huge_file.string(), huge_file.string()}, huge_out, SimpleCV::ColorSpace::UNCHANGED,
+                                  SimpleCV::Depth::U8, 2, &huge_errors) == 0);
+  SC_ASSERT(!huge_errors[0].empty() && !huge_errors[1].empty());
+  fs::remove(huge_file, ec);
+
+  // 超过一个写出块（约 1MB）的带 stride 视图
+  SimpleCV::Mat large(520, 720, 3);
+  fill_pattern_rgb(large);
+  SimpleCV::Mat large_roi = large(SimpleCV::Rect(3, 2, 700, 510));
+  std::vector<unsigned char> large_ppm;
+  SC_ASSERT(SimpleCV::imencode(".ppm", large_roi, large_ppm, bgr));
+  SC_ASSERT(same(SimpleCV::imdecode(large_ppm, SimpleCV::ColorSpace::BGR), large_roi));
+
+  // 不支持的组合
+  std::vector<unsigned char> none;
+  SC_ASSERT(!SimpleCV::imencode(".pfm", roi, none));
+  SC_ASSERT(!SimpleCV::imencode(".ppm", f32, none));
+  SC_ASSERT(!SimpleCV::imencode(".ppm", SimpleCV::Mat(2, 2, 4), none));
+  SC_ASSERT(!SimpleCV::imwrite((fs::current_path() / "simplecv_test_float.png").string(), f32));
+
+  // 编码失败的覆盖写：原文件保持不变，也不留下临时文件
+  fs::path keep_file = fs::current_path() / "simplecv_test_keep.ppm";
+  SC_ASSERT(SimpleCV::imwrite(keep_file.string(), roi));
+  SC_ASSERT(!SimpleCV::imwrite(keep_file.string(), SimpleCV::Mat(2, 2, 4)));
+  SC_ASSERT(same(SimpleCV::imread(keep_file.string()), roi));
+  for (const auto& entry : fs::directory_iterator(fs::current_path()))
+    SC_ASSERT(entry.path().extension() != ".tmp");
+
+  // 覆盖写进原文件本身：经符号链接写到链接指向的文件，链接仍是链接；原文件的权限不变
+  const fs::perms keep_perms = fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read;
+  fs::permissions(keep_file, keep_perms, ec);
+  fs::path link_file = fs::current_path() / "simplecv_test_link.ppm";
+  fs::remove(link_file, ec);
+  fs::create_symlink(keep_file, link_file, ec);
+  if (!ec) // 没有权限建符号链接的平台跳过
+  {
+    SimpleCV::Mat small_roi = roi(SimpleCV::Rect(0, 0, 2, 2));
+    SC_ASSERT(SimpleCV::imwrite(link_file.string(), small_roi));
+    SC_ASSERT(fs::is_symlink(link_file));
+    SC_ASSERT(same(SimpleCV::imread(keep_file.string()), small_roi));
+#ifndef _WIN32
+    SC_ASSERT(fs::status(keep_file).permissions() == keep_perms);
+#endif
+    fs::remove(link_file, ec);
+  }
+  fs::remove(keep_file, ec);
+  return true;
+}
+
 int main()
 {
   struct Case { const char* name; bool (*fn)(); };
@@ -171,6 +2011,31 @@ int main()
     {"cvt_gray_to_rgba", test_cvt_gray_to_rgba},
     {"imencode_imdecode_png_roundtrip", test_imencode_imdecode_png_roundtrip},
     {"imwrite_imread_flags", test_imwrite_imread_flags},
+    {"pool_allocator_reuse", test_pool_allocator_reuse},
+    {"aligned_step_kept_by_kernels", test_aligned_step_kept_by_kernels},
+    {"roi_view_zero_copy", test_roi_view_zero_copy},
+    {"multi_depth_decode_and_proc", test_multi_depth_decode_and_proc},
+    {"blob_from_image_nchw", test_blob_from_image_nchw},
+    {"external_buffer_lifetime", test_external_buffer_lifetime},
+    {"mapped_pnm_npy_raw", test_mapped_pnm_npy_raw},
+    {"split_merge_planar", test_split_merge_planar},
+    {"memory_accounting", test_memory_accounting},
+    {"imdecode_span_and_encode_targets", test_imdecode_span_and_encode_targets},
+    {"decode_into_dst", test_decode_into_dst},
+    {"image_info_probe", test_image_info_probe},
+    {"reduced_jpeg_decode", test_reduced_jpeg_decode},
+    {"batch_decode", test_batch_decode},
+    {"decode_from_reader", test_decode_from_reader},
+    {"imencode_formats_and_params", test_imencode_formats_and_params},
+    {"png_fast_modes", test_png_fast_modes},
+    {"png_parallel_bands", test_png_parallel_bands},
+    {"imencode_strided_views", test_imencode_strided_views},
+    {"imencode_bgr_source", test_imencode_bgr_source},
+    {"async_image_writer", test_async_image_writer},
+    {"gif_animation_frames", test_gif_animation_frames},
+    {"imread_resized", test_imread_resized},
+    {"codec_registry", test_codec_registry},
+    {"pnm_pfm_native", test_pnm_pfm_native},
   };
 
   int passed = 0;